@@ -0,0 +1,60 @@
+/*
+ * Copyright © 2001-2011 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#ifndef MODBUS_ASCII_PRIVATE_H
+#define MODBUS_ASCII_PRIVATE_H
+
+#ifndef _MSC_VER
+#include <stdint.h>
+#else
+#include "stdint.h"
+#endif
+
+#include "modbus-rtu-private.h"
+
+/* The lengths seen by the core are the ones of the binary frame, the ASCII
+   encoding is done by the send and recv functions of the backend */
+#define _MODBUS_ASCII_HEADER_LENGTH      1
+
+#define _MODBUS_ASCII_CHECKSUM_LENGTH    1
+
+/* Slave, PDU and LRC */
+#define _MODBUS_ASCII_MAX_BINARY_LENGTH  255
+
+typedef enum {
+    /* Characters are ignored until the ':' starting a frame */
+    _ASCII_IDLE,
+    /* Pairs of hex digits are decoded */
+    _ASCII_DATA,
+    /* The CR ending the frame has been read, not its LF yet */
+    _ASCII_CR,
+    /* The frame has been ended by CR LF, no more bytes are decoded until
+       its integrity is checked */
+    _ASCII_END,
+    /* The frame has been cut by an invalid character or by a new ':' */
+    _ASCII_ERROR
+} _ascii_state_t;
+
+typedef struct _modbus_ascii {
+    /* The serial line is set up and used as in RTU, first member so the
+       RTU functions can be given the context */
+    modbus_rtu_t rtu;
+    _ascii_state_t state;
+    /* High nibble of the byte being decoded or -1 */
+    int nibble;
+    /* Characters read from the line but not decoded yet */
+    uint8_t raw[MODBUS_ASCII_MAX_ADU_LENGTH];
+    int raw_start;
+    int raw_length;
+    /* The context waits for a request, not for a confirmation */
+    int indication;
+    /* Timeout of the last wait of the core (response or byte timeout of the
+       slave, bounded by the transaction deadline) unless it waits forever */
+    struct timeval wait_tv;
+    int wait_forever;
+} modbus_ascii_t;
+
+#endif /* MODBUS_ASCII_PRIVATE_H */
@@ -0,0 +1,546 @@
+/*
+ * Copyright © 2001-2011 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+
+#include "modbus-private.h"
+
+#include "modbus-rtu.h"
+#include "modbus-rtu-private.h"
+#include "modbus-ascii.h"
+#include "modbus-ascii-private.h"
+
+/* The ASCII backend frames the binary ADU of the RTU backend (with a LRC
+   instead of the CRC) as ':', two hex digits per byte and CR LF. The core
+   only sees the binary frame, the characters are encoded by send and
+   decoded by recv. The serial line is set up and used by the RTU
+   functions. */
+
+/* Value of each character as a hex digit, -1 if it isn't one */
+static const int8_t hex_values[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+/* The two hex digits of each byte value, at 2 * value */
+static const char hex_pairs[] =
+    "0001020304050607"
+    "08090A0B0C0D0E0F"
+    "1011121314151617"
+    "18191A1B1C1D1E1F"
+    "2021222324252627"
+    "28292A2B2C2D2E2F"
+    "3031323334353637"
+    "38393A3B3C3D3E3F"
+    "4041424344454647"
+    "48494A4B4C4D4E4F"
+    "5051525354555657"
+    "58595A5B5C5D5E5F"
+    "6061626364656667"
+    "68696A6B6C6D6E6F"
+    "7071727374757677"
+    "78797A7B7C7D7E7F"
+    "8081828384858687"
+    "88898A8B8C8D8E8F"
+    "9091929394959697"
+    "98999A9B9C9D9E9F"
+    "A0A1A2A3A4A5A6A7"
+    "A8A9AAABACADAEAF"
+    "B0B1B2B3B4B5B6B7"
+    "B8B9BABBBCBDBEBF"
+    "C0C1C2C3C4C5C6C7"
+    "C8C9CACBCCCDCECF"
+    "D0D1D2D3D4D5D6D7"
+    "D8D9DADBDCDDDEDF"
+    "E0E1E2E3E4E5E6E7"
+    "E8E9EAEBECEDEEEF"
+    "F0F1F2F3F4F5F6F7"
+    "F8F9FAFBFCFDFEFF";
+
+/* The LRC is the two's complement of the sum of the bytes. A table wouldn't
+   save anything over an addition per byte. */
+static uint8_t _modbus_ascii_lrc(const uint8_t *msg, int length)
+{
+    uint8_t sum = 0;
+
+    while (length--) {
+        sum += *msg++;
+    }
+
+    return (uint8_t)-sum;
+}
+
+/* The next character read starts a new frame, the characters already read
+   are kept */
+static void _modbus_ascii_reset(modbus_ascii_t *ctx_ascii)
+{
+    ctx_ascii->state = _ASCII_IDLE;
+    ctx_ascii->nibble = -1;
+}
+
+/* Decodes the characters read into at most dest_length bytes. Stops before a
+   hex digit when dest is full, at the end of the frame or once all the
+   characters are used. Returns the number of bytes decoded. */
+static int _modbus_ascii_decode(modbus_ascii_t *ctx_ascii, uint8_t *dest,
+                                int dest_length)
+{
+    int length = 0;
+
+    while (ctx_ascii->raw_length > 0) {
+        uint8_t c = ctx_ascii->raw[ctx_ascii->raw_start];
+        int value = hex_values[c];
+
+        if (ctx_ascii->state == _ASCII_END || ctx_ascii->state == _ASCII_ERROR) {
+            /* The characters after the frame are left for the next one */
+            break;
+        } else if (ctx_ascii->state == _ASCII_CR) {
+            /* A lone CR is tolerated */
+            ctx_ascii->state = _ASCII_END;
+            if (c == '\n') {
+                ctx_ascii->raw_start++;
+                ctx_ascii->raw_length--;
+            }
+            break;
+        } else if (c == ':') {
+            if (ctx_ascii->state == _ASCII_DATA) {
+                /* Frame cut by the next one, the ':' is left to start it */
+                ctx_ascii->state = _ASCII_ERROR;
+                break;
+            }
+            ctx_ascii->state = _ASCII_DATA;
+            ctx_ascii->nibble = -1;
+        } else if (ctx_ascii->state == _ASCII_DATA) {
+            if (value >= 0) {
+                if (ctx_ascii->nibble < 0) {
+                    if (length == dest_length)
+                        break;
+                    ctx_ascii->nibble = value;
+                } else {
+                    dest[length++] = (ctx_ascii->nibble << 4) | value;
+                    ctx_ascii->nibble = -1;
+                }
+            } else if (c == '\r' && ctx_ascii->nibble < 0) {
+                ctx_ascii->state = _ASCII_CR;
+            } else {
+                /* A LF alone ends the frame too, anything else (or an odd
+                   number of digits) makes it invalid */
+                ctx_ascii->state = (c == '\n' && ctx_ascii->nibble < 0) ?
+                    _ASCII_END : _ASCII_ERROR;
+                ctx_ascii->raw_start++;
+                ctx_ascii->raw_length--;
+                break;
+            }
+        }
+        /* else noise between two frames */
+
+        ctx_ascii->raw_start++;
+        ctx_ascii->raw_length--;
+    }
+
+    return length;
+}
+
+/* Reads at most length characters from the line, none are pending */
+static ssize_t _modbus_ascii_read(modbus_t *ctx, int length)
+{
+    modbus_ascii_t *ctx_ascii = ctx->backend_data;
+    ssize_t rc;
+
+    if (length > (int)sizeof(ctx_ascii->raw))
+        length = sizeof(ctx_ascii->raw);
+
+    rc = _modbus_rtu_backend.recv(ctx, ctx_ascii->raw, length);
+    if (rc > 0) {
+        ctx_ascii->raw_start = 0;
+        ctx_ascii->raw_length = rc;
+    }
+
+    return rc;
+}
+
+/* Waits for the next characters of the frame as long as the last wait of the
+   core in _modbus_ascii_select(), no longer than the transaction deadline */
+static int _modbus_ascii_wait(modbus_t *ctx)
+{
+    modbus_ascii_t *ctx_ascii = ctx->backend_data;
+    struct timeval tv;
+
+    if (ctx_ascii->wait_forever) {
+        return _modbus_rtu_backend.select(ctx, NULL, 1);
+    }
+
+    tv = ctx_ascii->wait_tv;
+    if (!ctx_ascii->indication && ctx->transaction_deadline != 0) {
+        uint64_t now = _modbus_time_us();
+        uint64_t remaining = (now < ctx->transaction_deadline) ?
+            ctx->transaction_deadline - now : 0;
+
+        if (remaining < (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec) {
+            tv.tv_sec = remaining / 1000000;
+            tv.tv_usec = remaining % 1000000;
+        }
+    }
+
+    return _modbus_rtu_backend.select(ctx, &tv, 1);
+}
+
+/* Reads the CR LF ending the frame after its last byte. Returns 0 if the
+   frame is ended or -1 if other characters or a silence were found. */
+static int _modbus_ascii_read_end(modbus_t *ctx)
+{
+    modbus_ascii_t *ctx_ascii = ctx->backend_data;
+
+    for (;;) {
+        _modbus_ascii_decode(ctx_ascii, NULL, 0);
+        if (ctx_ascii->state == _ASCII_END) {
+            return 0;
+        } else if (ctx_ascii->state == _ASCII_ERROR ||
+                   ctx_ascii->raw_length > 0) {
+            /* A hex digit more than the length of the frame */
+            return -1;
+        }
+
+        /* Read one by one, the next frame is left to the line */
+        if (_modbus_ascii_wait(ctx) == -1 || _modbus_ascii_read(ctx, 1) <= 0) {
+            return -1;
+        }
+    }
+}
+
+static int _modbus_ascii_set_slave(modbus_t *ctx, int slave)
+{
+    return _modbus_rtu_backend.set_slave(ctx, slave);
+}
+
+static int _modbus_ascii_build_request_basis(modbus_t *ctx, int function,
+                                             int addr, int nb,
+                                             uint8_t *req)
+{
+    return _modbus_rtu_backend.build_request_basis(ctx, function, addr, nb,
+                                                   req);
+}
+
+static int _modbus_ascii_build_file_request_basis(modbus_t *ctx, int function,
+                                                  int file_num, int record_num,
+                                                  int record_len, uint8_t *req)
+{
+    return _modbus_rtu_backend.build_file_request_basis(ctx, function, file_num,
+                                                        record_num, record_len,
+                                                        req);
+}
+
+static int _modbus_ascii_build_response_basis(sft_t *sft, uint8_t *rsp)
+{
+    return _modbus_rtu_backend.build_response_basis(sft, rsp);
+}
+
+static int _modbus_ascii_prepare_response_tid(const uint8_t *req, int *req_length)
+{
+    (*req_length) -= _MODBUS_ASCII_CHECKSUM_LENGTH;
+    /* No TID */
+    return 0;
+}
+
+static int _modbus_ascii_send_msg_pre(uint8_t *req, int req_length)
+{
+    req[req_length] = _modbus_ascii_lrc(req, req_length);
+
+    return req_length + 1;
+}
+
+/* Sends the binary frame of req_length bytes encoded in ASCII and returns
+   req_length once all the characters are written */
+static ssize_t _modbus_ascii_send(modbus_t *ctx, const uint8_t *req, int req_length)
+{
+    modbus_ascii_t *ctx_ascii = ctx->backend_data;
+    char frame[MODBUS_ASCII_MAX_ADU_LENGTH];
+    char *p = frame;
+    ssize_t rc;
+    int i;
+
+    if (req_length > _MODBUS_ASCII_MAX_BINARY_LENGTH) {
+        errno = EMBBADDATA;
+        return -1;
+    }
+
+    *p++ = ':';
+    for (i = 0; i < req_length; i++) {
+        memcpy(p, hex_pairs + 2 * req[i], 2);
+        p += 2;
+    }
+    *p++ = '\r';
+    *p++ = '\n';
+
+    /* The confirmation starts with the next ':' */
+    _modbus_ascii_reset(ctx_ascii);
+
+    rc = _modbus_rtu_backend.send(ctx, (uint8_t *)frame, p - frame);
+    if (rc == p - frame) {
+        return req_length;
+    } else if (rc >= 0) {
+        if (ctx->debug) {
+            fprintf(stderr, "ERROR Only %d characters of %d written\n",
+                    (int)rc, (int)(p - frame));
+        }
+        errno = EMBBADDATA;
+        return -1;
+    }
+
+    return rc;
+}
+
+static int _modbus_ascii_receive(modbus_t *ctx, uint8_t *req)
+{
+    modbus_ascii_t *ctx_ascii = ctx->backend_data;
+    int rc;
+
+    /* The RTU function handles the confirmations to ignore */
+    ctx_ascii->indication = TRUE;
+    rc = _modbus_rtu_backend.receive(ctx, req);
+    ctx_ascii->indication = FALSE;
+
+    return rc;
+}
+
+/* Reads characters until at least one byte of the frame is decoded (at most
+   rsp_length). The characters read after the frame are kept for the next
+   call. */
+static ssize_t _modbus_ascii_recv(modbus_t *ctx, uint8_t *rsp, int rsp_length)
+{
+    modbus_ascii_t *ctx_ascii = ctx->backend_data;
+    int length;
+
+    for (;;) {
+        if (ctx_ascii->state == _ASCII_END || ctx_ascii->state == _ASCII_ERROR) {
+            /* More bytes are expected than the frame holds */
+            if (ctx->debug) {
+                fprintf(stderr, "ERROR Frame ended %s\n",
+                        (ctx_ascii->state == _ASCII_END) ?
+                        "before its expected length" : "by an invalid character");
+            }
+            _modbus_ascii_reset(ctx_ascii);
+            errno = EMBBADDATA;
+            return -1;
+        }
+
+        if (ctx_ascii->raw_length == 0) {
+            /* Two digits a byte and the ':' when the frame isn't started, so
+               nothing is read past the expected frame */
+            int chars = 2 * rsp_length;
+            ssize_t rc;
+
+            if (ctx_ascii->state == _ASCII_IDLE) {
+                chars++;
+            } else if (ctx_ascii->nibble >= 0) {
+                chars--;
+            }
+
+            rc = _modbus_ascii_read(ctx, chars);
+            if (rc <= 0) {
+                return rc;
+            }
+        }
+
+        length = _modbus_ascii_decode(ctx_ascii, rsp, rsp_length);
+        if (length > 0) {
+            return length;
+        }
+
+        if (ctx_ascii->raw_length == 0 &&
+            ctx_ascii->state != _ASCII_END && ctx_ascii->state != _ASCII_ERROR &&
+            _modbus_ascii_wait(ctx) == -1) {
+            return -1;
+        }
+    }
+}
+
+static int _modbus_ascii_pre_check_confirmation(modbus_t *ctx, const uint8_t *req,
+                                                const uint8_t *rsp, int rsp_length)
+{
+    return _modbus_rtu_backend.pre_check_confirmation(ctx, req, rsp, rsp_length);
+}
+
+/* The check_integrity function shall return 0 is the message is ignored and
+   the message length if the frame is ended by CR LF and its LRC is valid.
+   Otherwise it shall return -1 and set errno to EMBBADDATA or EMBBADCRC. */
+static int _modbus_ascii_check_integrity(modbus_t *ctx, uint8_t *msg,
+                                         const int msg_length)
+{
+    modbus_ascii_t *ctx_ascii = ctx->backend_data;
+    uint8_t lrc_calculated;
+    uint8_t lrc_received;
+    int slave = msg[0];
+    int rc;
+
+    rc = _modbus_ascii_read_end(ctx);
+    /* The next character read starts a new frame */
+    _modbus_ascii_reset(ctx_ascii);
+
+    if (rc == -1) {
+        if (ctx->debug) {
+            fprintf(stderr, "ERROR Frame not ended by CR LF\n");
+        }
+        if (ctx->error_recovery & MODBUS_ERROR_RECOVERY_PROTOCOL) {
+            modbus_flush(ctx);
+        }
+        errno = EMBBADDATA;
+        return -1;
+    }
+
+    /* Filter on the Modbus unit identifier (slave) as in RTU mode */
+    if (slave != ctx->slave && slave != MODBUS_BROADCAST_ADDRESS) {
+        if (ctx->debug) {
+            printf("Request for slave %d ignored (not %d)\n", slave, ctx->slave);
+        }
+        /* Following call to check_confirmation handles this error */
+        return 0;
+    }
+
+    lrc_calculated = _modbus_ascii_lrc(msg, msg_length - 1);
+    lrc_received = msg[msg_length - 1];
+
+    /* BEGIN QMODBUS MODIFICATION */
+    ctx->last_crc_expected = lrc_calculated;
+    ctx->last_crc_received = lrc_received;
+    /* END QMODBUS MODIFICATION */
+
+    if (lrc_calculated == lrc_received) {
+        return msg_length;
+    } else {
+        if (ctx->debug) {
+            fprintf(stderr, "ERROR LRC received 0x%0X != LRC calculated 0x%0X\n",
+                    lrc_received, lrc_calculated);
+        }
+
+        if (ctx->error_recovery & MODBUS_ERROR_RECOVERY_PROTOCOL) {
+            modbus_flush(ctx);
+        }
+        errno = EMBBADCRC;
+        return -1;
+    }
+}
+
+static int _modbus_ascii_connect(modbus_t *ctx)
+{
+    modbus_ascii_t *ctx_ascii = ctx->backend_data;
+
+    _modbus_ascii_reset(ctx_ascii);
+    ctx_ascii->raw_length = 0;
+
+    return _modbus_rtu_backend.connect(ctx);
+}
+
+static void _modbus_ascii_close(modbus_t *ctx)
+{
+    _modbus_rtu_backend.close(ctx);
+}
+
+static int _modbus_ascii_flush(modbus_t *ctx)
+{
+    modbus_ascii_t *ctx_ascii = ctx->backend_data;
+
+    _modbus_ascii_reset(ctx_ascii);
+    ctx_ascii->raw_length = 0;
+
+    return _modbus_rtu_backend.flush(ctx);
+}
+
+static int _modbus_ascii_select(modbus_t *ctx, struct timeval *tv,
+                                int length_to_read)
+{
+    modbus_ascii_t *ctx_ascii = ctx->backend_data;
+
+    /* Kept for the waits of the characters not decoded into a byte */
+    ctx_ascii->wait_forever = (tv == NULL);
+    if (tv != NULL) {
+        ctx_ascii->wait_tv = *tv;
+    }
+
+    /* The characters already read are decoded first */
+    if (ctx_ascii->raw_length > 0) {
+        return 1;
+    }
+
+    return _modbus_rtu_backend.select(ctx, tv, 2 * length_to_read);
+}
+
+static void _modbus_ascii_free(modbus_t *ctx)
+{
+    _modbus_rtu_backend.free(ctx);
+}
+
+const modbus_backend_t _modbus_ascii_backend = {
+    _MODBUS_BACKEND_TYPE_ASCII,
+    _MODBUS_ASCII_HEADER_LENGTH,
+    _MODBUS_ASCII_CHECKSUM_LENGTH,
+    _MODBUS_ASCII_MAX_BINARY_LENGTH,
+    _modbus_ascii_set_slave,
+    _modbus_ascii_build_request_basis,
+    _modbus_ascii_build_file_request_basis,
+    _modbus_ascii_build_response_basis,
+    _modbus_ascii_prepare_response_tid,
+    _modbus_ascii_send_msg_pre,
+    _modbus_ascii_send,
+    _modbus_ascii_receive,
+    _modbus_ascii_recv,
+    _modbus_ascii_check_integrity,
+    _modbus_ascii_pre_check_confirmation,
+    _modbus_ascii_connect,
+    _modbus_ascii_close,
+    _modbus_ascii_flush,
+    _modbus_ascii_select,
+    _modbus_ascii_free
+};
+
+modbus_t* modbus_new_ascii(const char *device,
+                           int baud, char parity, int data_bit,
+                           int stop_bit)
+{
+    modbus_t *ctx;
+    modbus_ascii_t *ctx_ascii;
+
+    /* The arguments are checked by the RTU constructor */
+    ctx = modbus_new_rtu(device, baud, parity, data_bit, stop_bit);
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    ctx_ascii = (modbus_ascii_t *)realloc(ctx->backend_data,
+                                          sizeof(modbus_ascii_t));
+    if (ctx_ascii == NULL) {
+        modbus_free(ctx);
+        errno = ENOMEM;
+        return NULL;
+    }
+    ctx->backend_data = ctx_ascii;
+    ctx->backend = &_modbus_ascii_backend;
+
+    _modbus_ascii_reset(ctx_ascii);
+    ctx_ascii->raw_start = 0;
+    ctx_ascii->raw_length = 0;
+    ctx_ascii->indication = FALSE;
+    ctx_ascii->wait_tv = ctx->response_timeout;
+    ctx_ascii->wait_forever = FALSE;
+
+    return ctx;
+}
@@ -0,0 +1,25 @@
+/*
+ * Copyright © 2001-2011 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#ifndef MODBUS_ASCII_H
+#define MODBUS_ASCII_H
+
+#include "modbus.h"
+
+MODBUS_BEGIN_DECLS
+
+/* Modbus_over_serial_line_V1_02.pdf Chapter 2 Section 5 Page 17
+ * ASCII frame = ':' + 2 characters for each of the slave (1 byte), the PDU
+ * (253 bytes) and the LRC (1 byte) + CR LF = 513 characters
+ */
+#define MODBUS_ASCII_MAX_ADU_LENGTH  513
+
+MODBUS_API modbus_t* modbus_new_ascii(const char *device, int baud, char parity,
+                                      int data_bit, int stop_bit);
+
+MODBUS_END_DECLS
+
+#endif /* MODBUS_ASCII_H */
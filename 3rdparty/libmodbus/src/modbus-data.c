@@ -15,6 +15,14 @@
 #include <string.h>
 #include <assert.h>
 
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__ORDER_LITTLE_ENDIAN__) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#  include <arm_neon.h>
+#  define MODBUS_NEON_LE
+#endif
+
 #if defined(_WIN32)
 #  include <winsock2.h>
 #else
@@ -66,30 +74,39 @@ static inline uint32_t bswap_32(uint32_t x)
 }
 #endif
 
+/* Table of the 8 bits of each byte value, one byte per bit (LSB first) */
+#define UNPACK(n) { (n) & 1, ((n) >> 1) & 1, ((n) >> 2) & 1, ((n) >> 3) & 1, \
+                    ((n) >> 4) & 1, ((n) >> 5) & 1, ((n) >> 6) & 1, ((n) >> 7) & 1 }
+#define UNPACK4(n) UNPACK(n), UNPACK(n + 1), UNPACK(n + 2), UNPACK(n + 3)
+#define UNPACK16(n) UNPACK4(n), UNPACK4(n + 4), UNPACK4(n + 8), UNPACK4(n + 12)
+#define UNPACK64(n) UNPACK16(n), UNPACK16(n + 16), UNPACK16(n + 32), UNPACK16(n + 48)
+
+static const uint8_t table_unpack[256][8] = {
+    UNPACK64(0), UNPACK64(64), UNPACK64(128), UNPACK64(192)
+};
+
 /* Sets many bits from a single byte value (all 8 bits of the byte value are
    set) */
 void modbus_set_bits_from_byte(uint8_t *dest, int idx, const uint8_t value)
 {
-    int i;
-
-    for (i=0; i < 8; i++) {
-        dest[idx+i] = (value & (1 << i)) ? 1 : 0;
-    }
+    memcpy(dest + idx, table_unpack[value], 8);
 }
 
 /* Sets many bits from a table of bytes (only the bits between idx and
-   idx + nb_bits are set) */
+   idx + nb_bits are set). Each byte is unpacked with one copy from
+   table_unpack. */
 void modbus_set_bits_from_bytes(uint8_t *dest, int idx, unsigned int nb_bits,
                                 const uint8_t *tab_byte)
 {
     unsigned int i;
-    int shift = 0;
 
-    for (i = idx; i < idx + nb_bits; i++) {
-        dest[i] = tab_byte[(i - idx) / 8] & (1 << shift) ? 1 : 0;
-        /* gcc doesn't like: shift = (++shift) % 8; */
-        shift++;
-        shift %= 8;
+    dest += idx;
+    for (i = 0; i + 8 <= nb_bits; i += 8) {
+        memcpy(dest + i, table_unpack[tab_byte[i / 8]], 8);
+    }
+
+    if (i < nb_bits) {
+        memcpy(dest + i, table_unpack[tab_byte[i / 8]], nb_bits - i);
     }
 }
 
@@ -114,6 +131,32 @@ uint8_t modbus_get_byte_from_bits(const uint8_t *src, int idx,
     return value;
 }
 
+/* Sets many registers from a table of big-endian bytes (2 bytes per
+   register), dest and src can be the same buffer. The swap is done by blocks
+   of 8 registers with SSE2 or NEON. */
+void modbus_set_registers_from_bytes(uint16_t *dest, const uint8_t *src,
+                                     unsigned int nb_registers)
+{
+    unsigned int i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 8 <= nb_registers; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+
+        x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+        _mm_storeu_si128((__m128i *)(dest + i), x);
+    }
+#elif defined(MODBUS_NEON_LE)
+    for (; i + 8 <= nb_registers; i += 8) {
+        vst1q_u8((uint8_t *)(dest + i), vrev16q_u8(vld1q_u8(src + 2 * i)));
+    }
+#endif
+
+    for (; i < nb_registers; i++) {
+        dest[i] = (src[2 * i] << 8) | src[2 * i + 1];
+    }
+}
+
 /* Get a float from 4 bytes (Modbus) without any conversion (ABCD) */
 float modbus_get_float_abcd(const uint16_t *src)
 {
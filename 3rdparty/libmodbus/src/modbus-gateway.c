@@ -0,0 +1,445 @@
+/*
+ * Copyright © 2001-2011 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <config.h>
+
+#include "modbus-private.h"
+#include "modbus-tcp.h"
+#include "modbus-rtu-private.h"
+#include "modbus-gateway.h"
+
+#if !defined(_WIN32)
+
+/* A gateway bridges many Modbus TCP masters to one serial line: the requests
+ * received from the masters are queued and sent on the line one at a time,
+ * the responses are sent back with the MBAP header of each request.
+ *
+ * A read identical to a read still waiting in the queue (same unit, function,
+ * address and number) isn't sent again, the response of the first one answers
+ * both, so the load of the line grows with the number of distinct requests
+ * and not with the number of masters. A read is never merged across a write
+ * queued before it, each master sees its own requests in order. */
+
+#define _MODBUS_GATEWAY_QUEUE_LENGTH 64
+/* Masters waiting for the response of one transaction */
+#define _MODBUS_GATEWAY_MAX_WAITERS 32
+/* Length of the MBAP header, unit identifier included */
+#define _MODBUS_GATEWAY_MBAP_LENGTH 7
+
+struct _modbus_gateway_waiter {
+    /* -1 once the master is disconnected */
+    int s;
+    uint16_t t_id;
+};
+
+struct _modbus_gateway_request {
+    int unit;
+    int pdu_length;
+    uint8_t pdu[MODBUS_MAX_PDU_LENGTH];
+    int nb_waiters;
+    struct _modbus_gateway_waiter waiters[_MODBUS_GATEWAY_MAX_WAITERS];
+};
+
+struct _modbus_gateway {
+    modbus_t *ctx_tcp;
+    modbus_t *ctx_serial;
+    int server_socket;
+    /* The listening socket then the masters */
+    struct pollfd *fds;
+    int nb_fds;
+    int max_fds;
+    /* Ring of the requests to send on the line */
+    struct _modbus_gateway_request queue[_MODBUS_GATEWAY_QUEUE_LENGTH];
+    int head;
+    int nb_queued;
+    modbus_gateway_stats_t stats;
+};
+
+/* The gateway takes over the sockets accepted on server_socket (from
+   modbus_tcp_listen) and reads them with ctx_tcp, whose receive buffering is
+   disabled as the context moves from one socket to another. ctx_serial is a
+   connected RTU or ASCII context. */
+modbus_gateway_t* modbus_gateway_new(modbus_t *ctx_tcp, int server_socket,
+                                     modbus_t *ctx_serial)
+{
+    modbus_gateway_t *gateway;
+
+    if (ctx_tcp == NULL || ctx_serial == NULL || server_socket < 0 ||
+        ctx_tcp->backend->backend_type != _MODBUS_BACKEND_TYPE_TCP ||
+        ctx_serial->backend->backend_type == _MODBUS_BACKEND_TYPE_TCP) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    gateway = (modbus_gateway_t *)malloc(sizeof(modbus_gateway_t));
+    if (gateway == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    gateway->max_fds = 16;
+    gateway->fds = (struct pollfd *)malloc(gateway->max_fds *
+                                           sizeof(struct pollfd));
+    if (gateway->fds == NULL) {
+        free(gateway);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    gateway->ctx_tcp = ctx_tcp;
+    gateway->ctx_serial = ctx_serial;
+    gateway->server_socket = server_socket;
+    gateway->fds[0].fd = server_socket;
+    gateway->fds[0].events = POLLIN;
+    gateway->nb_fds = 1;
+    gateway->head = 0;
+    gateway->nb_queued = 0;
+    memset(&gateway->stats, 0, sizeof(modbus_gateway_stats_t));
+
+    modbus_set_rx_buffering(ctx_tcp, FALSE);
+
+    return gateway;
+}
+
+/* The connections of the masters are closed, the contexts and the listening
+   socket are left to the caller */
+void modbus_gateway_free(modbus_gateway_t *gateway)
+{
+    int i;
+
+    if (gateway == NULL)
+        return;
+
+    for (i = 1; i < gateway->nb_fds; i++) {
+        close(gateway->fds[i].fd);
+    }
+    free(gateway->fds);
+    free(gateway);
+}
+
+static int add_client(modbus_gateway_t *gateway, int s)
+{
+    if (gateway->nb_fds == gateway->max_fds) {
+        struct pollfd *fds = (struct pollfd *)realloc(
+            gateway->fds, 2 * gateway->max_fds * sizeof(struct pollfd));
+
+        if (fds == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        gateway->fds = fds;
+        gateway->max_fds *= 2;
+    }
+
+    gateway->fds[gateway->nb_fds].fd = s;
+    gateway->fds[gateway->nb_fds].events = POLLIN;
+    gateway->fds[gateway->nb_fds].revents = 0;
+    gateway->nb_fds++;
+    gateway->stats.clients++;
+
+    return 0;
+}
+
+static void remove_client(modbus_gateway_t *gateway, int i)
+{
+    int s = gateway->fds[i].fd;
+    int j, k;
+
+    if (gateway->ctx_tcp->debug) {
+        printf("Connection of socket %d closed\n", s);
+    }
+
+    /* Its queued requests are still sent, the responses are dropped */
+    for (j = 0; j < gateway->nb_queued; j++) {
+        struct _modbus_gateway_request *request =
+            &gateway->queue[(gateway->head + j) % _MODBUS_GATEWAY_QUEUE_LENGTH];
+
+        for (k = 0; k < request->nb_waiters; k++) {
+            if (request->waiters[k].s == s)
+                request->waiters[k].s = -1;
+        }
+    }
+
+    close(s);
+    gateway->fds[i] = gateway->fds[gateway->nb_fds - 1];
+    gateway->nb_fds--;
+    gateway->stats.clients--;
+}
+
+/* Sends the PDU to the master with the MBAP header of its request */
+static void send_response(modbus_gateway_t *gateway,
+                          const struct _modbus_gateway_waiter *waiter,
+                          int unit, const uint8_t *pdu, int pdu_length)
+{
+    modbus_t *ctx = gateway->ctx_tcp;
+    uint8_t rsp[MODBUS_TCP_MAX_ADU_LENGTH];
+    sft_t sft;
+    int rsp_length;
+
+    if (waiter->s == -1)
+        return;
+
+    sft.slave = unit;
+    sft.function = pdu[0];
+    sft.t_id = waiter->t_id;
+    rsp_length = ctx->backend->build_response_basis(&sft, rsp);
+    memcpy(rsp + rsp_length, pdu + 1, pdu_length - 1);
+    rsp_length = ctx->backend->send_msg_pre(rsp, rsp_length + pdu_length - 1);
+
+    /* A master gone since is found by the next read of its socket */
+    modbus_set_socket(ctx, waiter->s);
+    if (ctx->backend->send(ctx, rsp, rsp_length) != rsp_length &&
+        ctx->debug) {
+        fprintf(stderr, "ERROR Response not sent to socket %d\n", waiter->s);
+    }
+}
+
+static void send_exception(modbus_gateway_t *gateway,
+                           const struct _modbus_gateway_waiter *waiter,
+                           int unit, int function, int exception_code)
+{
+    uint8_t pdu[2];
+
+    pdu[0] = function | 0x80;
+    pdu[1] = exception_code;
+    send_response(gateway, waiter, unit, pdu, 2);
+    gateway->stats.exceptions++;
+}
+
+static int is_read(int function)
+{
+    return function == MODBUS_FC_READ_COILS ||
+        function == MODBUS_FC_READ_DISCRETE_INPUTS ||
+        function == MODBUS_FC_READ_HOLDING_REGISTERS ||
+        function == MODBUS_FC_READ_INPUT_REGISTERS;
+}
+
+/* Queues the request received from the master of socket s */
+static void queue_request(modbus_gateway_t *gateway, int s,
+                          const uint8_t *req, int req_length)
+{
+    struct _modbus_gateway_request *request;
+    struct _modbus_gateway_waiter waiter;
+    const uint8_t *pdu = req + _MODBUS_GATEWAY_MBAP_LENGTH;
+    int pdu_length = req_length - _MODBUS_GATEWAY_MBAP_LENGTH;
+    int unit = req[_MODBUS_GATEWAY_MBAP_LENGTH - 1];
+    int i;
+
+    gateway->stats.requests++;
+    waiter.s = s;
+    waiter.t_id = (req[0] << 8) | req[1];
+
+    if (is_read(pdu[0])) {
+        /* From the newest request back to the last write */
+        for (i = gateway->nb_queued - 1; i >= 0; i--) {
+            request = &gateway->queue[(gateway->head + i) %
+                                      _MODBUS_GATEWAY_QUEUE_LENGTH];
+            if (!is_read(request->pdu[0]))
+                break;
+            if (request->unit == unit && request->pdu_length == pdu_length &&
+                request->nb_waiters < _MODBUS_GATEWAY_MAX_WAITERS &&
+                memcmp(request->pdu, pdu, pdu_length) == 0) {
+                request->waiters[request->nb_waiters++] = waiter;
+                gateway->stats.coalesced++;
+                return;
+            }
+        }
+    }
+
+    if (gateway->nb_queued == _MODBUS_GATEWAY_QUEUE_LENGTH) {
+        send_exception(gateway, &waiter, unit, pdu[0],
+                       MODBUS_EXCEPTION_SLAVE_OR_SERVER_BUSY);
+        return;
+    }
+
+    request = &gateway->queue[(gateway->head + gateway->nb_queued) %
+                              _MODBUS_GATEWAY_QUEUE_LENGTH];
+    request->unit = unit;
+    request->pdu_length = pdu_length;
+    memcpy(request->pdu, pdu, pdu_length);
+    request->nb_waiters = 1;
+    request->waiters[0] = waiter;
+    gateway->nb_queued++;
+}
+
+/* Accepts the new masters and queues the requests received, waiting at most
+   timeout_ms for them (-1 without limit). Returns -1 if poll() fails. */
+static int read_clients(modbus_gateway_t *gateway, int timeout_ms)
+{
+    uint8_t req[MODBUS_TCP_MAX_ADU_LENGTH];
+    int rc;
+    int i;
+
+    rc = poll(gateway->fds, gateway->nb_fds, timeout_ms);
+    if (rc <= 0) {
+        return (rc == -1 && errno != EINTR) ? -1 : 0;
+    }
+
+    /* In the order of the connections so the requests received together are
+       queued in the order the masters connected */
+    for (i = 1; i < gateway->nb_fds; i++) {
+        if (gateway->fds[i].revents == 0)
+            continue;
+
+        /* The whole frame is read, the byte timeout of ctx_tcp bounds the
+           wait for a master sending it in pieces */
+        modbus_set_socket(gateway->ctx_tcp, gateway->fds[i].fd);
+        rc = modbus_receive(gateway->ctx_tcp, req);
+        if (rc == -1) {
+            /* Replaced by the last connection, checked next */
+            remove_client(gateway, i);
+            i--;
+        } else if (rc > _MODBUS_GATEWAY_MBAP_LENGTH) {
+            queue_request(gateway, gateway->fds[i].fd, req, rc);
+        }
+    }
+
+    if (gateway->fds[0].revents & POLLIN) {
+        int s = modbus_tcp_accept(gateway->ctx_tcp, &gateway->server_socket);
+
+        if (s != -1 && add_client(gateway, s) == -1) {
+            close(s);
+        }
+    }
+
+    return 0;
+}
+
+/* Waits out the response of a timed out or mismatched transaction on the line
+   and discards it, otherwise it would be taken for the response to the next
+   request. The wait ends with the response timeout of the slave, or earlier
+   once the line is silent for 3.5 characters after bytes were received. */
+static void flush_late_response(modbus_t *ctx)
+{
+    uint64_t end = _modbus_time_us() + _modbus_response_timeout(ctx, ctx->slave);
+    uint64_t silence = _modbus_rtu_silence_time(ctx);
+    int received = FALSE;
+
+    for (;;) {
+        struct timeval tv;
+        uint64_t now = _modbus_time_us();
+        uint64_t wait;
+
+        if (now >= end)
+            break;
+
+        wait = end - now;
+        if (received && wait > silence)
+            wait = silence;
+        tv.tv_sec = wait / 1000000;
+        tv.tv_usec = wait % 1000000;
+
+        if (_modbus_wait_readable(ctx, &tv) == -1) {
+            /* Silence, end of the response timeout or error */
+            break;
+        }
+        modbus_flush(ctx);
+        received = TRUE;
+    }
+
+    modbus_flush(ctx);
+}
+
+/* Sends the request at the head of the queue on the line and its response,
+   or the exception of the gateway, to each master waiting for it */
+static void serve_request(modbus_gateway_t *gateway)
+{
+    struct _modbus_gateway_request *request = &gateway->queue[gateway->head];
+    modbus_t *ctx = gateway->ctx_serial;
+    uint8_t raw_req[MODBUS_MAX_PDU_LENGTH + 1];
+    uint8_t rsp[MAX_MESSAGE_LENGTH];
+    int exception_code = 0;
+    int rc;
+    int i;
+
+    raw_req[0] = request->unit;
+    memcpy(raw_req + 1, request->pdu, request->pdu_length);
+
+    /* No serial slave behind the units above 247 */
+    if (modbus_set_slave(ctx, request->unit) == -1 ||
+        modbus_send_raw_request(ctx, raw_req, request->pdu_length + 1) == -1) {
+        exception_code = MODBUS_EXCEPTION_GATEWAY_PATH;
+    } else if (request->unit == MODBUS_BROADCAST_ADDRESS) {
+        /* No response to a broadcast, neither on the line nor to the
+           masters */
+        gateway->stats.transactions++;
+        goto dequeue;
+    } else {
+        gateway->stats.transactions++;
+        rc = modbus_receive_confirmation(ctx, rsp);
+        if (rc <= 0 || rsp[0] != request->unit ||
+            (rsp[1] & 0x7F) != request->pdu[0]) {
+            flush_late_response(ctx);
+            exception_code = MODBUS_EXCEPTION_GATEWAY_TARGET;
+        }
+    }
+
+    for (i = 0; i < request->nb_waiters; i++) {
+        if (exception_code != 0) {
+            send_exception(gateway, &request->waiters[i], request->unit,
+                           request->pdu[0], exception_code);
+        } else {
+            /* The exceptions of the slave are sent as they are */
+            send_response(gateway, &request->waiters[i], request->unit,
+                          rsp + ctx->backend->header_length,
+                          rc - ctx->backend->header_length -
+                          ctx->backend->checksum_length);
+        }
+    }
+
+dequeue:
+    gateway->head = (gateway->head + 1) % _MODBUS_GATEWAY_QUEUE_LENGTH;
+    gateway->nb_queued--;
+}
+
+/* Waits at most timeout_ms (-1 without limit) for the masters, then serves
+   the queue until it is empty. The requests received during a transaction
+   are queued before the next one, so the identical reads of the masters
+   waiting for the line are merged. Returns the number of transactions on the
+   line or -1 if poll() fails. */
+int modbus_gateway_run(modbus_gateway_t *gateway, int timeout_ms)
+{
+    int nb_transactions = 0;
+
+    if (gateway == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (read_clients(gateway, timeout_ms) == -1) {
+        return -1;
+    }
+
+    while (gateway->nb_queued > 0) {
+        serve_request(gateway);
+        nb_transactions++;
+        if (read_clients(gateway, 0) == -1) {
+            return -1;
+        }
+    }
+
+    return nb_transactions;
+}
+
+int modbus_gateway_get_stats(modbus_gateway_t *gateway,
+                             modbus_gateway_stats_t *stats)
+{
+    if (gateway == NULL || stats == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memcpy(stats, &gateway->stats, sizeof(modbus_gateway_stats_t));
+    return 0;
+}
+
+#endif
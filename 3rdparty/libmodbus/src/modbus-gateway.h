@@ -0,0 +1,44 @@
+/*
+ * Copyright © 2001-2010 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#ifndef MODBUS_GATEWAY_H
+#define MODBUS_GATEWAY_H
+
+#include "modbus.h"
+
+MODBUS_BEGIN_DECLS
+
+#if !defined(_WIN32)
+
+typedef struct _modbus_gateway modbus_gateway_t;
+
+typedef struct {
+    /* Requests received from the TCP masters */
+    uint64_t requests;
+    /* Transactions on the serial line */
+    uint64_t transactions;
+    /* Reads answered by the transaction of an identical read */
+    uint64_t coalesced;
+    /* Exceptions sent by the gateway itself (busy, path or target) */
+    uint64_t exceptions;
+    /* Masters connected */
+    uint32_t clients;
+} modbus_gateway_stats_t;
+
+MODBUS_API modbus_gateway_t* modbus_gateway_new(modbus_t *ctx_tcp, int server_socket,
+                                                modbus_t *ctx_serial);
+MODBUS_API void modbus_gateway_free(modbus_gateway_t *gateway);
+
+MODBUS_API int modbus_gateway_run(modbus_gateway_t *gateway, int timeout_ms);
+
+MODBUS_API int modbus_gateway_get_stats(modbus_gateway_t *gateway,
+                                        modbus_gateway_stats_t *stats);
+
+#endif
+
+MODBUS_END_DECLS
+
+#endif /* MODBUS_GATEWAY_H */
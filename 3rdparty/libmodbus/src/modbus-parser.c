@@ -0,0 +1,261 @@
+/*
+ * Copyright © 2001-2011 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <config.h>
+
+#include "modbus-private.h"
+#include "modbus-parser.h"
+
+/* The parser is fed with chunks of any size and emits the ADUs found in them.
+ * A frame lying entirely in a chunk is passed to the callback in place, only
+ * the head of a frame cut by the end of a chunk is copied, and no more than
+ * needed to complete it. The lengths are computed by the same steps as the
+ * blocking receive (see _modbus_frame_length).
+ *
+ * A TCP ADU is delimited by the length of its MBAP header, an RTU ADU by its
+ * function code and checked with its CRC. On an invalid frame, one byte is
+ * dropped and the search starts again at the next one. */
+
+struct _modbus_parser {
+    const modbus_backend_t *backend;
+    modbus_parser_mode mode;
+    modbus_parser_callback_t callback;
+    void *user_data;
+    uint64_t dropped;
+    /* Head of a frame started in a previous chunk */
+    int length;
+    uint8_t buf[MAX_MESSAGE_LENGTH];
+};
+
+modbus_parser_t* modbus_parser_new(modbus_t *ctx, modbus_parser_mode mode,
+                                   modbus_parser_callback_t callback,
+                                   void *user_data)
+{
+    modbus_parser_t *parser;
+
+    /* The ASCII frames are decoded by the recv function of the backend, a
+       parser would be given the binary frames */
+    if (ctx == NULL || callback == NULL ||
+        ctx->backend->backend_type == _MODBUS_BACKEND_TYPE_ASCII ||
+        (mode != MODBUS_PARSER_INDICATION && mode != MODBUS_PARSER_CONFIRMATION &&
+         mode != MODBUS_PARSER_ANY)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    parser = (modbus_parser_t *)malloc(sizeof(modbus_parser_t));
+    if (parser == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    /* Only the backend of the context is used, the context can be freed */
+    parser->backend = ctx->backend;
+    parser->mode = mode;
+    parser->callback = callback;
+    parser->user_data = user_data;
+    parser->dropped = 0;
+    parser->length = 0;
+
+    return parser;
+}
+
+void modbus_parser_free(modbus_parser_t *parser)
+{
+    free(parser);
+}
+
+/* Drops the bytes of an incomplete frame, for example after a silence on the
+   line or a reconnection */
+void modbus_parser_reset(modbus_parser_t *parser)
+{
+    if (parser == NULL)
+        return;
+
+    parser->dropped += parser->length;
+    parser->length = 0;
+}
+
+/* Number of bytes dropped while searching for valid frames */
+uint64_t modbus_parser_get_dropped(modbus_parser_t *parser)
+{
+    if (parser == NULL)
+        return 0;
+
+    return parser->dropped;
+}
+
+static int scan_tcp(const uint8_t *msg, int available, int *needed)
+{
+    int length;
+
+    /* Transaction ID (2), protocol ID (2), length (2) */
+    if (available < 6) {
+        *needed = 6;
+        return 0;
+    }
+
+    length = (msg[4] << 8) + msg[5];
+    if (msg[2] != 0 || msg[3] != 0 ||
+        length < 2 || 6 + length > MODBUS_TCP_MAX_ADU_LENGTH) {
+        return -1;
+    }
+
+    if (available < 6 + length) {
+        *needed = 6 + length;
+        return 0;
+    }
+
+    return 6 + length;
+}
+
+static int scan_rtu_type(const modbus_backend_t *backend, const uint8_t *msg,
+                         int available, msg_type_t msg_type, int *needed)
+{
+    int length = _modbus_frame_length(backend, msg, available, msg_type);
+
+    if (length == -1)
+        return -1;
+
+    if (length > available) {
+        *needed = length;
+        return 0;
+    }
+
+    if (modbus_rtu_crc16(msg, length - 2) !=
+        ((msg[length - 2] << 8) | msg[length - 1])) {
+        return -1;
+    }
+
+    return length;
+}
+
+/* Returns the length of the valid ADU starting at msg, 0 if more bytes are
+   needed (needed is then set to the length to reach) or -1 if no valid ADU
+   starts there. */
+static int scan(modbus_parser_t *parser, const uint8_t *msg, int available,
+                int *needed)
+{
+    int rc_indication;
+    int rc_confirmation;
+    int needed_indication = 0;
+    int needed_confirmation = 0;
+
+    if (parser->backend->backend_type == _MODBUS_BACKEND_TYPE_TCP)
+        return scan_tcp(msg, available, needed);
+
+    if (parser->mode == MODBUS_PARSER_INDICATION) {
+        return scan_rtu_type(parser->backend, msg, available, MSG_INDICATION,
+                             needed);
+    } else if (parser->mode == MODBUS_PARSER_CONFIRMATION) {
+        return scan_rtu_type(parser->backend, msg, available, MSG_CONFIRMATION,
+                             needed);
+    }
+
+    /* The direction is unknown, the frame is valid if one of the two
+       lengths gives a valid CRC. A length still unknown is longer than the
+       bytes available so the shortest valid frame can't hide a shorter
+       one. */
+    rc_confirmation = scan_rtu_type(parser->backend, msg, available,
+                                    MSG_CONFIRMATION, &needed_confirmation);
+    rc_indication = scan_rtu_type(parser->backend, msg, available,
+                                  MSG_INDICATION, &needed_indication);
+
+    if (rc_confirmation > 0 && rc_indication > 0) {
+        return (rc_confirmation < rc_indication) ? rc_confirmation : rc_indication;
+    } else if (rc_confirmation > 0) {
+        return rc_confirmation;
+    } else if (rc_indication > 0) {
+        return rc_indication;
+    } else if (rc_confirmation == 0 && rc_indication == 0) {
+        *needed = (needed_confirmation < needed_indication) ?
+            needed_confirmation : needed_indication;
+        return 0;
+    } else if (rc_confirmation == 0) {
+        *needed = needed_confirmation;
+        return 0;
+    } else if (rc_indication == 0) {
+        *needed = needed_indication;
+        return 0;
+    }
+
+    return -1;
+}
+
+/* Removes the first length bytes of the buffer */
+static void buffer_shift(modbus_parser_t *parser, int length)
+{
+    parser->length -= length;
+    memmove(parser->buf, parser->buf + length, parser->length);
+}
+
+/* Parses the length bytes of data and calls the callback for each ADU
+   completed. Returns the number of ADUs found or -1 if an argument is
+   invalid. */
+int modbus_parser_feed(modbus_parser_t *parser, const uint8_t *data, int length)
+{
+    int nb_adus = 0;
+
+    if (parser == NULL || length < 0 || (data == NULL && length > 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (;;) {
+        int needed = 0;
+        int rc;
+
+        if (parser->length > 0) {
+            /* Continues the frame started in a previous chunk */
+            rc = scan(parser, parser->buf, parser->length, &needed);
+            if (rc > 0) {
+                parser->callback(parser, parser->buf, rc, parser->user_data);
+                nb_adus++;
+                buffer_shift(parser, rc);
+            } else if (rc == -1) {
+                parser->dropped++;
+                buffer_shift(parser, 1);
+            } else if (length > 0) {
+                int n = needed - parser->length;
+
+                if (n > length)
+                    n = length;
+                memcpy(parser->buf + parser->length, data, n);
+                parser->length += n;
+                data += n;
+                length -= n;
+            } else {
+                break;
+            }
+        } else if (length > 0) {
+            rc = scan(parser, data, length, &needed);
+            if (rc > 0) {
+                /* In place */
+                parser->callback(parser, data, rc, parser->user_data);
+                nb_adus++;
+                data += rc;
+                length -= rc;
+            } else if (rc == -1) {
+                parser->dropped++;
+                data++;
+                length--;
+            } else {
+                /* Shorter than an ADU so it fits in the buffer */
+                memcpy(parser->buf, data, length);
+                parser->length = length;
+                length = 0;
+            }
+        } else {
+            break;
+        }
+    }
+
+    return nb_adus;
+}
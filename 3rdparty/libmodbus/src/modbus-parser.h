@@ -0,0 +1,42 @@
+/*
+ * Copyright © 2001-2010 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#ifndef MODBUS_PARSER_H
+#define MODBUS_PARSER_H
+
+#include "modbus.h"
+
+MODBUS_BEGIN_DECLS
+
+typedef struct _modbus_parser modbus_parser_t;
+
+typedef enum
+{
+    /* Requests (server side) */
+    MODBUS_PARSER_INDICATION,
+    /* Responses (client side) */
+    MODBUS_PARSER_CONFIRMATION,
+    /* Both directions of a captured line */
+    MODBUS_PARSER_ANY
+} modbus_parser_mode;
+
+/* Called for each complete and valid ADU, adu is only valid during the call */
+typedef void (*modbus_parser_callback_t)(modbus_parser_t *parser,
+                                         const uint8_t *adu, int adu_length,
+                                         void *user_data);
+
+MODBUS_API modbus_parser_t* modbus_parser_new(modbus_t *ctx, modbus_parser_mode mode,
+                                              modbus_parser_callback_t callback,
+                                              void *user_data);
+MODBUS_API void modbus_parser_free(modbus_parser_t *parser);
+MODBUS_API int modbus_parser_feed(modbus_parser_t *parser, const uint8_t *data,
+                                  int length);
+MODBUS_API void modbus_parser_reset(modbus_parser_t *parser);
+MODBUS_API uint64_t modbus_parser_get_dropped(modbus_parser_t *parser);
+
+MODBUS_END_DECLS
+
+#endif /* MODBUS_PARSER_H */
@@ -16,6 +16,9 @@
 typedef int ssize_t;
 #endif
 #include <sys/types.h>
+#if !defined(_WIN32)
+# include <poll.h>
+#endif
 #include <config.h>
 
 #include "modbus.h"
@@ -31,6 +34,9 @@ MODBUS_BEGIN_DECLS
  */
 #define _MIN_REQ_LENGTH 12
 
+/* Max between RTU and TCP max adu length (so TCP) */
+#define MAX_MESSAGE_LENGTH 260
+
 #define _REPORT_SLAVE_ID 180
 
 #define _MODBUS_EXCEPTION_RSP_LENGTH 5
@@ -39,9 +45,14 @@ MODBUS_BEGIN_DECLS
 #define _RESPONSE_TIMEOUT    500000
 #define _BYTE_TIMEOUT        500000
 
+/* Size of the per-context receive buffer (power of 2), large enough to hold
+ * a few TCP ADUs read in one system call */
+#define _MODBUS_RX_BUFFER_LENGTH 1024
+
 typedef enum {
     _MODBUS_BACKEND_TYPE_RTU=0,
-    _MODBUS_BACKEND_TYPE_TCP
+    _MODBUS_BACKEND_TYPE_TCP,
+    _MODBUS_BACKEND_TYPE_ASCII
 } modbus_backend_type_t;
 
 /*
@@ -87,10 +98,20 @@ typedef struct _modbus_backend {
     int (*connect) (modbus_t *ctx);
     void (*close) (modbus_t *ctx);
     int (*flush) (modbus_t *ctx);
-    int (*select) (modbus_t *ctx, fd_set *rset, struct timeval *tv, int msg_length);
+    int (*select) (modbus_t *ctx, struct timeval *tv, int msg_length);
     void (*free) (modbus_t *ctx);
 } modbus_backend_t;
 
+/* Round trip estimators of a slave (RFC 6298) in microseconds, valid once
+   a confirmation has been received, and the number of times the timeout has
+   been doubled by the timeouts since the last confirmation */
+struct _modbus_rtt {
+    int valid;
+    int backoff;
+    uint32_t srtt;
+    uint32_t rttvar;
+};
+
 struct _modbus {
     /* Slave address */
     int slave;
@@ -100,17 +121,63 @@ struct _modbus {
     int error_recovery;
     struct timeval response_timeout;
     struct timeval byte_timeout;
+    /* Bound of a whole transaction (disabled if 0) and its absolute end (see
+       _modbus_time_us) set when the request is sent */
+    struct timeval transaction_timeout;
+    uint64_t transaction_deadline;
+    /* Bounds of the response timeout learned per slave (disabled if the
+       ceiling is 0), in microseconds, and the estimators of every unit
+       identifier */
+    uint32_t rto_floor;
+    uint32_t rto_ceiling;
+    struct _modbus_rtt rtt[256];
+    /* Counters and latencies (see modbus_get_stats), the end of the sending
+       of the last request and the arrival of the first byte of the last
+       confirmation */
+    modbus_stats_t stats;
+    uint64_t stats_sent;
+    uint64_t stats_first_byte;
     uint16_t last_crc_expected;
     uint16_t last_crc_received;
     const modbus_backend_t *backend;
     void *backend_data;
     modbus_monitor_add_item_fnc_t monitor_add_item;
     modbus_monitor_raw_data_fnc_t monitor_raw_data;
+    /* Receive ring buffer: bytes already read from the kernel but not yet
+       consumed by the message parser */
+    int rx_buffering;
+    int rx_start;
+    int rx_length;
+    uint8_t rx_buf[_MODBUS_RX_BUFFER_LENGTH];
+    /* Response of the last read returned as a view (see
+       modbus_read_registers_view) */
+    uint8_t rsp[MAX_MESSAGE_LENGTH];
+    /* Window of pipelined requests (see modbus_submit_*) */
+    struct _modbus_in_flight *in_flight;
+    int max_in_flight;
+    int nb_in_flight;
 };
 
 void _modbus_init_common(modbus_t *ctx);
+uint64_t _modbus_time_us(void);
+#if !defined(_WIN32)
+int _modbus_wait_readable(modbus_t *ctx, const struct timeval *tv);
+#endif
+void _modbus_stats_latency(modbus_latency_t *latency, uint64_t us);
+void _modbus_stats_confirmation(modbus_t *ctx, uint64_t sent);
+void _modbus_rtt_sample(modbus_t *ctx, int slave, uint64_t us);
+void _modbus_rtt_timeout(modbus_t *ctx, int slave);
+uint64_t _modbus_response_timeout(modbus_t *ctx, int slave);
 void _error_print(modbus_t *ctx, const char *context);
+int _modbus_send_msg(modbus_t *ctx, uint8_t *msg, int msg_length);
 int _modbus_receive_msg(modbus_t *ctx, uint8_t *msg, msg_type_t msg_type);
+int _modbus_frame_length(const modbus_backend_t *backend, const uint8_t *msg,
+                         int msg_length, msg_type_t msg_type);
+int _modbus_frame_missing(modbus_t *ctx, uint8_t *msg, int msg_length,
+                          msg_type_t msg_type);
+int _modbus_receive_available(modbus_t *ctx, uint8_t *msg, int *msg_length);
+int _modbus_check_confirmation(modbus_t *ctx, uint8_t *req,
+                               uint8_t *rsp, int rsp_length);
 
 #ifndef HAVE_STRLCPY
 size_t strlcpy(char *dest, const char *src, size_t dest_size);
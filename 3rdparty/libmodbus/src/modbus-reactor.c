@@ -0,0 +1,736 @@
+/*
+ * Copyright © 2001-2011 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <config.h>
+
+#include "modbus-private.h"
+#include "modbus-reactor.h"
+#include "modbus-uring-private.h"
+
+#if !defined(_WIN32)
+
+/* A reactor drives the transactions of many contexts from one thread: the
+ * requests are queued per context, the next one is sent as soon as the
+ * previous one completes and the confirmations are read with poll() as their
+ * bytes arrive, so a slow device never delays the others.
+ *
+ * One request per context is in flight at a time, as the RTU line and most
+ * TCP devices expect.
+ *
+ * The contexts of modbus_new_tcp_uring() are waited through their ring: the
+ * requests sent by a run are submitted together and their confirmations
+ * reaped by the same io_uring_enter() call. */
+
+struct _modbus_reactor_request {
+    struct _modbus_reactor_request *next;
+    int function;
+    int nb;
+    void *dest;
+    modbus_reactor_callback_t callback;
+    void *user_data;
+    int req_length;
+    uint8_t req[MAX_MESSAGE_LENGTH];
+};
+
+struct _modbus_reactor_connection {
+    /* NULL once removed, until the array is compacted */
+    modbus_t *ctx;
+    /* Queue of requests, the head one is in flight when sent is TRUE */
+    struct _modbus_reactor_request *head;
+    struct _modbus_reactor_request *tail;
+    int sent;
+    /* Absolute times (see _modbus_time_us) of the sending and of the
+       expiration of the current wait */
+    uint64_t sent_time;
+    uint64_t deadline;
+    int rsp_length;
+    uint8_t rsp[MAX_MESSAGE_LENGTH];
+};
+
+struct _modbus_reactor {
+    struct _modbus_reactor_connection *connections;
+    int nb_connections;
+    int max_connections;
+    /* Descriptors waited by poll() and their connection, one more for the
+       ring */
+    struct pollfd *fds;
+    int *fd_connection;
+    /* Ring of the io_uring contexts, one per reactor */
+    modbus_uring_t *ring;
+    struct _modbus_reactor_request *free_requests;
+    int nb_pending;
+};
+
+modbus_reactor_t* modbus_reactor_new(void)
+{
+    modbus_reactor_t *reactor;
+
+    reactor = (modbus_reactor_t *)malloc(sizeof(modbus_reactor_t));
+    if (reactor == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    reactor->connections = NULL;
+    reactor->nb_connections = 0;
+    reactor->max_connections = 0;
+    reactor->fds = NULL;
+    reactor->fd_connection = NULL;
+    reactor->ring = NULL;
+    reactor->free_requests = NULL;
+    reactor->nb_pending = 0;
+
+    return reactor;
+}
+
+static void free_request_list(struct _modbus_reactor_request *request)
+{
+    while (request != NULL) {
+        struct _modbus_reactor_request *next = request->next;
+        free(request);
+        request = next;
+    }
+}
+
+/* The contexts are neither closed nor freed and the callbacks of the pending
+   requests aren't called */
+void modbus_reactor_free(modbus_reactor_t *reactor)
+{
+    int i;
+
+    if (reactor == NULL)
+        return;
+
+    for (i = 0; i < reactor->nb_connections; i++) {
+        free_request_list(reactor->connections[i].head);
+    }
+    free_request_list(reactor->free_requests);
+    free(reactor->connections);
+    free(reactor->fds);
+    free(reactor->fd_connection);
+    free(reactor);
+}
+
+static struct _modbus_reactor_connection *find_connection(
+    modbus_reactor_t *reactor, modbus_t *ctx)
+{
+    int i;
+
+    for (i = 0; i < reactor->nb_connections; i++) {
+        if (reactor->connections[i].ctx == ctx)
+            return &reactor->connections[i];
+    }
+
+    return NULL;
+}
+
+/* Drops the removed connections, never called while the indexes of
+   fd_connection are in use */
+static void compact_connections(modbus_reactor_t *reactor)
+{
+    int i;
+    int j = 0;
+
+    for (i = 0; i < reactor->nb_connections; i++) {
+        if (reactor->connections[i].ctx != NULL) {
+            if (i != j) {
+                reactor->connections[j] = reactor->connections[i];
+            }
+            j++;
+        }
+    }
+    reactor->nb_connections = j;
+}
+
+int modbus_reactor_add(modbus_reactor_t *reactor, modbus_t *ctx)
+{
+    struct _modbus_reactor_connection *connection;
+    modbus_uring_t *ring;
+
+    if (reactor == NULL || ctx == NULL || find_connection(reactor, ctx) != NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ring = _modbus_uring_ring(ctx);
+    if (ring != NULL && reactor->ring != NULL && ring != reactor->ring) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (reactor->nb_connections == reactor->max_connections) {
+        int max_connections = (reactor->max_connections == 0) ?
+            16 : 2 * reactor->max_connections;
+        struct _modbus_reactor_connection *connections;
+        struct pollfd *fds;
+        int *fd_connection;
+
+        connections = (struct _modbus_reactor_connection *)realloc(
+            reactor->connections,
+            max_connections * sizeof(struct _modbus_reactor_connection));
+        if (connections == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        reactor->connections = connections;
+
+        fds = (struct pollfd *)realloc(reactor->fds,
+                                       (max_connections + 1) * sizeof(struct pollfd));
+        if (fds == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        reactor->fds = fds;
+
+        fd_connection = (int *)realloc(reactor->fd_connection,
+                                       (max_connections + 1) * sizeof(int));
+        if (fd_connection == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        reactor->fd_connection = fd_connection;
+
+        reactor->max_connections = max_connections;
+    }
+
+    if (ring != NULL) {
+        reactor->ring = ring;
+    }
+
+    connection = &reactor->connections[reactor->nb_connections++];
+    connection->ctx = ctx;
+    connection->head = NULL;
+    connection->tail = NULL;
+    connection->sent = FALSE;
+    connection->sent_time = 0;
+    connection->deadline = 0;
+    connection->rsp_length = 0;
+
+    return 0;
+}
+
+/* The context must have no request pending */
+int modbus_reactor_remove(modbus_reactor_t *reactor, modbus_t *ctx)
+{
+    struct _modbus_reactor_connection *connection;
+
+    if (reactor == NULL || ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    connection = find_connection(reactor, ctx);
+    if (connection == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (connection->head != NULL) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    /* The array is compacted by the next run */
+    connection->ctx = NULL;
+    return 0;
+}
+
+int modbus_reactor_get_pending(modbus_reactor_t *reactor)
+{
+    if (reactor == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return reactor->nb_pending;
+}
+
+/* Queues the request built in req */
+static int submit_request(modbus_reactor_t *reactor, modbus_t *ctx,
+                          uint8_t *req, int req_length, int nb, void *dest,
+                          modbus_reactor_callback_t callback, void *user_data)
+{
+    struct _modbus_reactor_connection *connection;
+    struct _modbus_reactor_request *request;
+
+    connection = find_connection(reactor, ctx);
+    if (connection == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    request = reactor->free_requests;
+    if (request != NULL) {
+        reactor->free_requests = request->next;
+    } else {
+        request = (struct _modbus_reactor_request *)malloc(
+            sizeof(struct _modbus_reactor_request));
+        if (request == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    request->next = NULL;
+    request->function = req[ctx->backend->header_length];
+    request->nb = nb;
+    request->dest = dest;
+    request->callback = callback;
+    request->user_data = user_data;
+    request->req_length = req_length;
+    memcpy(request->req, req, req_length);
+
+    if (connection->tail != NULL) {
+        connection->tail->next = request;
+    } else {
+        connection->head = request;
+    }
+    connection->tail = request;
+    reactor->nb_pending++;
+
+    return 0;
+}
+
+static int submit_read(modbus_reactor_t *reactor, modbus_t *ctx, int function,
+                       int addr, int nb, int nb_max, void *dest,
+                       modbus_reactor_callback_t callback, void *user_data)
+{
+    uint8_t req[_MIN_REQ_LENGTH];
+    int req_length;
+
+    if (reactor == NULL || ctx == NULL || dest == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (nb > nb_max) {
+        if (ctx->debug) {
+            fprintf(stderr, "ERROR Too many values requested (%d > %d)\n",
+                    nb, nb_max);
+        }
+        errno = EMBMDATA;
+        return -1;
+    }
+
+    req_length = ctx->backend->build_request_basis(ctx, function, addr, nb, req);
+    return submit_request(reactor, ctx, req, req_length, nb, dest,
+                          callback, user_data);
+}
+
+int modbus_reactor_read_bits(modbus_reactor_t *reactor, modbus_t *ctx,
+                             int addr, int nb, uint8_t *dest,
+                             modbus_reactor_callback_t callback, void *user_data)
+{
+    return submit_read(reactor, ctx, MODBUS_FC_READ_COILS, addr, nb,
+                       MODBUS_MAX_READ_BITS, dest, callback, user_data);
+}
+
+int modbus_reactor_read_input_bits(modbus_reactor_t *reactor, modbus_t *ctx,
+                                   int addr, int nb, uint8_t *dest,
+                                   modbus_reactor_callback_t callback,
+                                   void *user_data)
+{
+    return submit_read(reactor, ctx, MODBUS_FC_READ_DISCRETE_INPUTS, addr, nb,
+                       MODBUS_MAX_READ_BITS, dest, callback, user_data);
+}
+
+int modbus_reactor_read_registers(modbus_reactor_t *reactor, modbus_t *ctx,
+                                  int addr, int nb, uint16_t *dest,
+                                  modbus_reactor_callback_t callback,
+                                  void *user_data)
+{
+    return submit_read(reactor, ctx, MODBUS_FC_READ_HOLDING_REGISTERS, addr, nb,
+                       MODBUS_MAX_READ_REGISTERS, dest, callback, user_data);
+}
+
+int modbus_reactor_read_input_registers(modbus_reactor_t *reactor, modbus_t *ctx,
+                                        int addr, int nb, uint16_t *dest,
+                                        modbus_reactor_callback_t callback,
+                                        void *user_data)
+{
+    return submit_read(reactor, ctx, MODBUS_FC_READ_INPUT_REGISTERS, addr, nb,
+                       MODBUS_MAX_READ_REGISTERS, dest, callback, user_data);
+}
+
+static int submit_write_single(modbus_reactor_t *reactor, modbus_t *ctx,
+                               int function, int addr, int value,
+                               modbus_reactor_callback_t callback,
+                               void *user_data)
+{
+    uint8_t req[_MIN_REQ_LENGTH];
+    int req_length;
+
+    if (reactor == NULL || ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    req_length = ctx->backend->build_request_basis(ctx, function, addr, value,
+                                                   req);
+    return submit_request(reactor, ctx, req, req_length, 1, NULL,
+                          callback, user_data);
+}
+
+int modbus_reactor_write_bit(modbus_reactor_t *reactor, modbus_t *ctx,
+                             int addr, int status,
+                             modbus_reactor_callback_t callback, void *user_data)
+{
+    return submit_write_single(reactor, ctx, MODBUS_FC_WRITE_SINGLE_COIL, addr,
+                               status ? 0xFF00 : 0, callback, user_data);
+}
+
+int modbus_reactor_write_register(modbus_reactor_t *reactor, modbus_t *ctx,
+                                  int addr, int value,
+                                  modbus_reactor_callback_t callback,
+                                  void *user_data)
+{
+    return submit_write_single(reactor, ctx, MODBUS_FC_WRITE_SINGLE_REGISTER,
+                               addr, value, callback, user_data);
+}
+
+int modbus_reactor_write_registers(modbus_reactor_t *reactor, modbus_t *ctx,
+                                   int addr, int nb, const uint16_t *src,
+                                   modbus_reactor_callback_t callback,
+                                   void *user_data)
+{
+    uint8_t req[MAX_MESSAGE_LENGTH];
+    int req_length;
+    int i;
+
+    if (reactor == NULL || ctx == NULL || src == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (nb > MODBUS_MAX_WRITE_REGISTERS) {
+        if (ctx->debug) {
+            fprintf(stderr,
+                    "ERROR Trying to write to too many registers (%d > %d)\n",
+                    nb, MODBUS_MAX_WRITE_REGISTERS);
+        }
+        errno = EMBMDATA;
+        return -1;
+    }
+
+    req_length = ctx->backend->build_request_basis(
+        ctx, MODBUS_FC_WRITE_MULTIPLE_REGISTERS, addr, nb, req);
+    req[req_length++] = nb * 2;
+
+    for (i = 0; i < nb; i++) {
+        req[req_length++] = src[i] >> 8;
+        req[req_length++] = src[i] & 0x00FF;
+    }
+
+    return submit_request(reactor, ctx, req, req_length, nb, NULL,
+                          callback, user_data);
+}
+
+/* Dequeues the request in flight of the connection and calls its callback
+   with rc (and errno unchanged). The callback may queue new requests. */
+static void complete_request(modbus_reactor_t *reactor, int index, int rc)
+{
+    struct _modbus_reactor_connection *connection = &reactor->connections[index];
+    struct _modbus_reactor_request *request = connection->head;
+    modbus_reactor_callback_t callback = request->callback;
+    void *user_data = request->user_data;
+    modbus_t *ctx = connection->ctx;
+
+    connection->head = request->next;
+    if (connection->head == NULL) {
+        connection->tail = NULL;
+    }
+    connection->sent = FALSE;
+    connection->rsp_length = 0;
+    reactor->nb_pending--;
+
+    request->next = reactor->free_requests;
+    reactor->free_requests = request;
+
+    if (callback != NULL) {
+        callback(reactor, ctx, rc, user_data);
+    }
+}
+
+/* Checks the confirmation received by the connection and stores its values */
+static int decode_confirmation(struct _modbus_reactor_connection *connection,
+                               int rsp_length)
+{
+    modbus_t *ctx = connection->ctx;
+    struct _modbus_reactor_request *request = connection->head;
+    const int offset = ctx->backend->header_length;
+    int rc;
+
+    _modbus_stats_confirmation(ctx, connection->sent_time);
+
+    rc = _modbus_check_confirmation(ctx, request->req, connection->rsp,
+                                    rsp_length);
+    if (rc == -1)
+        return -1;
+
+    switch (request->function) {
+    case MODBUS_FC_READ_COILS:
+    case MODBUS_FC_READ_DISCRETE_INPUTS:
+        modbus_set_bits_from_bytes(request->dest, 0, request->nb,
+                                   connection->rsp + offset + 2);
+        rc = request->nb;
+        break;
+    case MODBUS_FC_READ_HOLDING_REGISTERS:
+    case MODBUS_FC_READ_INPUT_REGISTERS:
+        modbus_set_registers_from_bytes(request->dest,
+                                        connection->rsp + offset + 2, rc);
+        break;
+    default:
+        break;
+    }
+
+    return rc;
+}
+
+static uint64_t timeval_us(const struct timeval *tv)
+{
+    return (uint64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+/* Sends the next request of an idle connection, the requests which can't be
+   sent are completed with an error. Returns the number of them. */
+static int send_next(modbus_reactor_t *reactor, int index)
+{
+    int completed = 0;
+
+    for (;;) {
+        struct _modbus_reactor_connection *connection =
+            &reactor->connections[index];
+        struct _modbus_reactor_request *request = connection->head;
+        modbus_t *ctx = connection->ctx;
+        int rc;
+
+        if (ctx == NULL || request == NULL || connection->sent)
+            return completed;
+
+        rc = _modbus_send_msg(ctx, request->req, request->req_length);
+        if (rc == -1) {
+            complete_request(reactor, index, -1);
+            completed++;
+            continue;
+        }
+
+        /* send_msg has completed the request (length or CRC) */
+        request->req_length = rc;
+        connection->sent = TRUE;
+        connection->rsp_length = 0;
+        connection->sent_time = ctx->stats_sent;
+        connection->deadline = connection->sent_time +
+            _modbus_response_timeout(ctx, ctx->slave);
+        if (ctx->transaction_deadline != 0 &&
+            ctx->transaction_deadline < connection->deadline) {
+            connection->deadline = ctx->transaction_deadline;
+        }
+        return completed;
+    }
+}
+
+/* Reads the bytes available for the request in flight of the connection.
+   Returns 1 if the request has been completed, 0 otherwise. */
+static int receive_available(modbus_reactor_t *reactor, int index, uint64_t now)
+{
+    struct _modbus_reactor_connection *connection = &reactor->connections[index];
+    modbus_t *ctx = connection->ctx;
+    int rc;
+
+    rc = _modbus_receive_available(ctx, connection->rsp,
+                                   &connection->rsp_length);
+    if (rc == 0) {
+        /* Incomplete, the next bytes are awaited for the byte timeout */
+        if (ctx->byte_timeout.tv_sec > 0 || ctx->byte_timeout.tv_usec > 0) {
+            connection->deadline = now + timeval_us(&ctx->byte_timeout);
+            if (ctx->transaction_deadline != 0 &&
+                ctx->transaction_deadline < connection->deadline) {
+                connection->deadline = ctx->transaction_deadline;
+            }
+        }
+        return 0;
+    }
+
+    if (rc > 0) {
+        rc = decode_confirmation(connection, rc);
+    }
+    complete_request(reactor, index, rc);
+
+    return 1;
+}
+
+static void expire_request(modbus_reactor_t *reactor, int index)
+{
+    struct _modbus_reactor_connection *connection = &reactor->connections[index];
+    modbus_t *ctx = connection->ctx;
+
+    ctx->stats.timeouts++;
+    if (connection->rsp_length == 0) {
+        _modbus_rtt_timeout(ctx, ctx->slave);
+    }
+    errno = ETIMEDOUT;
+    _error_print(ctx, "poll");
+    /* A late confirmation would be taken for the next one */
+    modbus_flush(ctx);
+    errno = ETIMEDOUT;
+    complete_request(reactor, index, -1);
+}
+
+/* Sends the queued requests and waits up to timeout_ms milliseconds (-1 for
+   no limit) for the completion of at least one of them. Returns the number of
+   requests completed (their callbacks have been called), 0 if none is pending
+   or the time is elapsed, or -1 if poll() fails. */
+int modbus_reactor_run(modbus_reactor_t *reactor, int timeout_ms)
+{
+    uint64_t end = 0;
+    int completed = 0;
+
+    if (reactor == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    compact_connections(reactor);
+
+    if (timeout_ms >= 0) {
+        end = _modbus_time_us() + (uint64_t)timeout_ms * 1000;
+    }
+
+    for (;;) {
+        uint64_t now;
+        uint64_t next_deadline = 0;
+        int nb_fds = 0;
+        int nb_uring = 0;
+        int buffered = FALSE;
+        int wait_ms;
+        int rc;
+        int i;
+
+        for (i = 0; i < reactor->nb_connections; i++) {
+            completed += send_next(reactor, i);
+        }
+
+        for (i = 0; i < reactor->nb_connections; i++) {
+            struct _modbus_reactor_connection *connection =
+                &reactor->connections[i];
+
+            if (connection->ctx == NULL || !connection->sent)
+                continue;
+
+            if (connection->ctx->rx_length > 0) {
+                /* Bytes read with a previous confirmation */
+                buffered = TRUE;
+            }
+            if (connection->ctx->backend == &_modbus_tcp_uring_backend) {
+                /* Reaped from the ring, the read is queued otherwise */
+                if (_modbus_uring_readable(connection->ctx))
+                    buffered = TRUE;
+                nb_uring++;
+            } else {
+                reactor->fds[nb_fds].fd = connection->ctx->s;
+                reactor->fds[nb_fds].events = POLLIN;
+                reactor->fds[nb_fds].revents = 0;
+                reactor->fd_connection[nb_fds] = i;
+                nb_fds++;
+            }
+
+            if (next_deadline == 0 || connection->deadline < next_deadline) {
+                next_deadline = connection->deadline;
+            }
+        }
+
+        if (nb_fds == 0 && nb_uring == 0)
+            return completed;
+
+        now = _modbus_time_us();
+        if (completed > 0 || buffered) {
+            wait_ms = 0;
+        } else {
+            uint64_t wait_end = next_deadline;
+
+            if (end != 0 && end < wait_end) {
+                wait_end = end;
+            }
+            /* Rounded up to not wake up just before the deadline */
+            wait_ms = (wait_end > now) ? (int)((wait_end - now + 999) / 1000) : 0;
+        }
+
+        if (nb_fds == 0) {
+            /* A single call submits the requests and reaps the confirmations */
+            rc = _modbus_uring_wait(reactor->ring, wait_ms);
+        } else {
+            if (nb_uring > 0) {
+                modbus_uring_submit(reactor->ring);
+                reactor->fds[nb_fds].fd = _modbus_uring_fd(reactor->ring);
+                reactor->fds[nb_fds].events = POLLIN;
+                reactor->fds[nb_fds].revents = 0;
+                reactor->fd_connection[nb_fds] = -1;
+            }
+            rc = poll(reactor->fds, nb_fds + (nb_uring > 0), wait_ms);
+            if (nb_uring > 0) {
+                _modbus_uring_reap(reactor->ring);
+            }
+        }
+        if (rc == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        now = _modbus_time_us();
+        for (i = 0; i < nb_fds; i++) {
+            const int index = reactor->fd_connection[i];
+            struct _modbus_reactor_connection *connection =
+                &reactor->connections[index];
+            modbus_t *ctx = connection->ctx;
+
+            if (ctx == NULL || !connection->sent)
+                continue;
+
+            if (reactor->fds[i].revents & POLLNVAL) {
+                errno = EBADF;
+                _error_print(ctx, "poll");
+                complete_request(reactor, index, -1);
+                completed++;
+            } else if (reactor->fds[i].revents != 0 || ctx->rx_length > 0) {
+                completed += receive_available(reactor, index, now);
+            } else if (connection->deadline <= now) {
+                expire_request(reactor, index);
+                completed++;
+            }
+        }
+
+        for (i = 0; nb_uring > 0 && i < reactor->nb_connections; i++) {
+            struct _modbus_reactor_connection *connection =
+                &reactor->connections[i];
+            modbus_t *ctx = connection->ctx;
+
+            if (ctx == NULL || !connection->sent ||
+                ctx->backend != &_modbus_tcp_uring_backend)
+                continue;
+
+            if (ctx->rx_length > 0 || _modbus_uring_readable(ctx)) {
+                completed += receive_available(reactor, i, now);
+            } else if (connection->deadline <= now) {
+                expire_request(reactor, i);
+                completed++;
+            }
+        }
+
+        if (completed > 0)
+            return completed;
+
+        if (end != 0 && now >= end)
+            return 0;
+    }
+}
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ * Copyright © 2001-2010 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#ifndef MODBUS_REACTOR_H
+#define MODBUS_REACTOR_H
+
+#include "modbus.h"
+
+MODBUS_BEGIN_DECLS
+
+#if !defined(_WIN32)
+
+typedef struct _modbus_reactor modbus_reactor_t;
+
+/* Called when a transaction completes with the number of values (as returned
+   by the blocking functions) or -1 with errno set */
+typedef void (*modbus_reactor_callback_t)(modbus_reactor_t *reactor,
+                                          modbus_t *ctx, int rc,
+                                          void *user_data);
+
+MODBUS_API modbus_reactor_t* modbus_reactor_new(void);
+MODBUS_API void modbus_reactor_free(modbus_reactor_t *reactor);
+
+MODBUS_API int modbus_reactor_add(modbus_reactor_t *reactor, modbus_t *ctx);
+MODBUS_API int modbus_reactor_remove(modbus_reactor_t *reactor, modbus_t *ctx);
+
+MODBUS_API int modbus_reactor_read_bits(modbus_reactor_t *reactor, modbus_t *ctx,
+                                        int addr, int nb, uint8_t *dest,
+                                        modbus_reactor_callback_t callback,
+                                        void *user_data);
+MODBUS_API int modbus_reactor_read_input_bits(modbus_reactor_t *reactor, modbus_t *ctx,
+                                              int addr, int nb, uint8_t *dest,
+                                              modbus_reactor_callback_t callback,
+                                              void *user_data);
+MODBUS_API int modbus_reactor_read_registers(modbus_reactor_t *reactor, modbus_t *ctx,
+                                             int addr, int nb, uint16_t *dest,
+                                             modbus_reactor_callback_t callback,
+                                             void *user_data);
+MODBUS_API int modbus_reactor_read_input_registers(modbus_reactor_t *reactor,
+                                                   modbus_t *ctx,
+                                                   int addr, int nb, uint16_t *dest,
+                                                   modbus_reactor_callback_t callback,
+                                                   void *user_data);
+MODBUS_API int modbus_reactor_write_bit(modbus_reactor_t *reactor, modbus_t *ctx,
+                                        int addr, int status,
+                                        modbus_reactor_callback_t callback,
+                                        void *user_data);
+MODBUS_API int modbus_reactor_write_register(modbus_reactor_t *reactor, modbus_t *ctx,
+                                             int addr, int value,
+                                             modbus_reactor_callback_t callback,
+                                             void *user_data);
+MODBUS_API int modbus_reactor_write_registers(modbus_reactor_t *reactor, modbus_t *ctx,
+                                              int addr, int nb, const uint16_t *src,
+                                              modbus_reactor_callback_t callback,
+                                              void *user_data);
+
+MODBUS_API int modbus_reactor_run(modbus_reactor_t *reactor, int timeout_ms);
+MODBUS_API int modbus_reactor_get_pending(modbus_reactor_t *reactor);
+
+#endif
+
+MODBUS_END_DECLS
+
+#endif /* MODBUS_REACTOR_H */
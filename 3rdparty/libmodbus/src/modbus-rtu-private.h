@@ -66,11 +66,33 @@ typedef struct _modbus_rtu {
 #if HAVE_DECL_TIOCM_RTS
     int rts;
     int rts_delay;
+    /* The delay has been set by modbus_rtu_set_rts_delay() */
+    int rts_delay_set;
+    /* How RTS is released at the end of a transmission */
+    int rts_release;
     int onebyte_time;
     void (*set_rts) (modbus_t *ctx, int on);
 #endif
+    /* Low latency profile asked (modbus_rtu_set_low_latency) */
+    int low_latency;
+#if HAVE_DECL_TIOCSSERIAL
+    /* Settings replaced by the profile, restored on close (-1 if left
+       untouched) */
+    int old_async_low_latency;
+    int old_latency_timer;
+#endif
+    /* Silence in microseconds ending a frame (0 to wait for the expected
+       length until the byte timeout) */
+    int frame_gap;
+    /* Bytes of a frame have been read since the last send or frame end */
+    int in_frame;
     /* To handle many slaves on the same link */
     int confirmation_to_ignore;
 } modbus_rtu_t;
 
+/* Reused by the ASCII backend for the serial line */
+extern const modbus_backend_t _modbus_rtu_backend;
+
+int _modbus_rtu_silence_time(modbus_t *ctx);
+
 #endif /* MODBUS_RTU_PRIVATE_H */
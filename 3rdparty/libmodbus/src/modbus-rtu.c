@@ -19,73 +19,25 @@
 #include "modbus-rtu.h"
 #include "modbus-rtu-private.h"
 
-#if HAVE_DECL_TIOCSRS485 || HAVE_DECL_TIOCM_RTS
+#if HAVE_DECL_TIOCSRS485 || HAVE_DECL_TIOCM_RTS || HAVE_DECL_TIOCSSERIAL
 #include <sys/ioctl.h>
 #endif
 
-#if HAVE_DECL_TIOCSRS485
+#if HAVE_DECL_TIOCSRS485 || HAVE_DECL_TIOCSSERIAL
 #include <linux/serial.h>
 #endif
 
-/* Table of CRC values for high-order byte */
-static const uint8_t table_crc_hi[] = {
-    0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0,
-    0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-    0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0,
-    0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-    0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1,
-    0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41,
-    0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1,
-    0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-    0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0,
-    0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40,
-    0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1,
-    0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-    0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0,
-    0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40,
-    0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0,
-    0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-    0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0,
-    0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-    0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0,
-    0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-    0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0,
-    0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40,
-    0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1,
-    0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-    0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0,
-    0x80, 0x41, 0x00, 0xC1, 0x81, 0x40
-};
+#if HAVE_DECL_TIOCSSERIAL
+#include <limits.h>
+#endif
 
-/* Table of CRC values for low-order byte */
-static const uint8_t table_crc_lo[] = {
-    0x00, 0xC0, 0xC1, 0x01, 0xC3, 0x03, 0x02, 0xC2, 0xC6, 0x06,
-    0x07, 0xC7, 0x05, 0xC5, 0xC4, 0x04, 0xCC, 0x0C, 0x0D, 0xCD,
-    0x0F, 0xCF, 0xCE, 0x0E, 0x0A, 0xCA, 0xCB, 0x0B, 0xC9, 0x09,
-    0x08, 0xC8, 0xD8, 0x18, 0x19, 0xD9, 0x1B, 0xDB, 0xDA, 0x1A,
-    0x1E, 0xDE, 0xDF, 0x1F, 0xDD, 0x1D, 0x1C, 0xDC, 0x14, 0xD4,
-    0xD5, 0x15, 0xD7, 0x17, 0x16, 0xD6, 0xD2, 0x12, 0x13, 0xD3,
-    0x11, 0xD1, 0xD0, 0x10, 0xF0, 0x30, 0x31, 0xF1, 0x33, 0xF3,
-    0xF2, 0x32, 0x36, 0xF6, 0xF7, 0x37, 0xF5, 0x35, 0x34, 0xF4,
-    0x3C, 0xFC, 0xFD, 0x3D, 0xFF, 0x3F, 0x3E, 0xFE, 0xFA, 0x3A,
-    0x3B, 0xFB, 0x39, 0xF9, 0xF8, 0x38, 0x28, 0xE8, 0xE9, 0x29,
-    0xEB, 0x2B, 0x2A, 0xEA, 0xEE, 0x2E, 0x2F, 0xEF, 0x2D, 0xED,
-    0xEC, 0x2C, 0xE4, 0x24, 0x25, 0xE5, 0x27, 0xE7, 0xE6, 0x26,
-    0x22, 0xE2, 0xE3, 0x23, 0xE1, 0x21, 0x20, 0xE0, 0xA0, 0x60,
-    0x61, 0xA1, 0x63, 0xA3, 0xA2, 0x62, 0x66, 0xA6, 0xA7, 0x67,
-    0xA5, 0x65, 0x64, 0xA4, 0x6C, 0xAC, 0xAD, 0x6D, 0xAF, 0x6F,
-    0x6E, 0xAE, 0xAA, 0x6A, 0x6B, 0xAB, 0x69, 0xA9, 0xA8, 0x68,
-    0x78, 0xB8, 0xB9, 0x79, 0xBB, 0x7B, 0x7A, 0xBA, 0xBE, 0x7E,
-    0x7F, 0xBF, 0x7D, 0xBD, 0xBC, 0x7C, 0xB4, 0x74, 0x75, 0xB5,
-    0x77, 0xB7, 0xB6, 0x76, 0x72, 0xB2, 0xB3, 0x73, 0xB1, 0x71,
-    0x70, 0xB0, 0x50, 0x90, 0x91, 0x51, 0x93, 0x53, 0x52, 0x92,
-    0x96, 0x56, 0x57, 0x97, 0x55, 0x95, 0x94, 0x54, 0x9C, 0x5C,
-    0x5D, 0x9D, 0x5F, 0x9F, 0x9E, 0x5E, 0x5A, 0x9A, 0x9B, 0x5B,
-    0x99, 0x59, 0x58, 0x98, 0x88, 0x48, 0x49, 0x89, 0x4B, 0x8B,
-    0x8A, 0x4A, 0x4E, 0x8E, 0x8F, 0x4F, 0x8D, 0x4D, 0x4C, 0x8C,
-    0x44, 0x84, 0x85, 0x45, 0x87, 0x47, 0x46, 0x86, 0x82, 0x42,
-    0x43, 0x83, 0x41, 0x81, 0x80, 0x40
-};
+/* The ASCII backend uses the serial line set up in RTU so its settings are
+   accepted too */
+static int _modbus_rtu_is_serial(modbus_t *ctx)
+{
+    return ctx->backend->backend_type == _MODBUS_BACKEND_TYPE_RTU ||
+        ctx->backend->backend_type == _MODBUS_BACKEND_TYPE_ASCII;
+}
 
 /* Define the slave ID of the remote device to talk in master mode or set the
  * internal slave ID in slave mode */
@@ -152,22 +104,6 @@ static int _modbus_rtu_build_response_basis(sft_t *sft, uint8_t *rsp)
     return _MODBUS_RTU_PRESET_RSP_LENGTH;
 }
 
-static uint16_t crc16(uint8_t *buffer, uint16_t buffer_length)
-{
-    uint8_t crc_hi = 0xFF; /* high CRC byte initialized */
-    uint8_t crc_lo = 0xFF; /* low CRC byte initialized */
-    unsigned int i; /* will index into CRC lookup */
-
-    /* pass through message buffer */
-    while (buffer_length--) {
-        i = crc_hi ^ *buffer++; /* calculate the CRC  */
-        crc_hi = crc_lo ^ table_crc_hi[i];
-        crc_lo = table_crc_lo[i];
-    }
-
-    return (crc_hi << 8 | crc_lo);
-}
-
 static int _modbus_rtu_prepare_response_tid(const uint8_t *req, int *req_length)
 {
     (*req_length) -= _MODBUS_RTU_CHECKSUM_LENGTH;
@@ -177,7 +113,7 @@ static int _modbus_rtu_prepare_response_tid(const uint8_t *req, int *req_length)
 
 static int _modbus_rtu_send_msg_pre(uint8_t *req, int req_length)
 {
-    uint16_t crc = crc16(req, req_length);
+    uint16_t crc = modbus_rtu_crc16(req, req_length);
     req[req_length++] = crc >> 8;
     req[req_length++] = crc & 0x00FF;
 
@@ -288,6 +224,28 @@ static void _modbus_rtu_ioctl_rts(modbus_t *ctx, int on)
     }
     ioctl(fd, TIOCMSET, &flags);
 }
+
+/* Waits until the last stop bit has left the line. tcdrain() returns once
+   the driver has handed every byte to the UART, which can still be shifting
+   out the last one, so the line status register is polled every tenth of a
+   character for at most two characters when the driver provides it (not USB
+   adapters nor pseudo terminals). */
+static void _modbus_rtu_drain(modbus_t *ctx)
+{
+    tcdrain(ctx->s);
+#ifdef TIOCSERGETLSR
+    {
+        modbus_rtu_t *ctx_rtu = ctx->backend_data;
+        uint64_t deadline = _modbus_time_us() + 2 * ctx_rtu->onebyte_time;
+        unsigned int lsr;
+
+        while (ioctl(ctx->s, TIOCSERGETLSR, &lsr) == 0 &&
+               !(lsr & TIOCSER_TEMT) && _modbus_time_us() < deadline) {
+            usleep(ctx_rtu->onebyte_time / 10 + 1);
+        }
+    }
+#endif
+}
 #endif
 
 static ssize_t _modbus_rtu_send(modbus_t *ctx, const uint8_t *req, int req_length)
@@ -295,11 +253,16 @@ static ssize_t _modbus_rtu_send(modbus_t *ctx, const uint8_t *req, int req_lengt
 #if defined(_WIN32)
     modbus_rtu_t *ctx_rtu = ctx->backend_data;
     DWORD n_bytes = 0;
+    ctx_rtu->in_frame = FALSE;
     return (WriteFile(ctx_rtu->w_ser.fd, req, req_length, &n_bytes, NULL)) ? (ssize_t)n_bytes : -1;
 #else
-#if HAVE_DECL_TIOCM_RTS
     modbus_rtu_t *ctx_rtu = ctx->backend_data;
-    if (ctx_rtu->rts != MODBUS_RTU_RTS_NONE) {
+
+    ctx_rtu->in_frame = FALSE;
+#if HAVE_DECL_TIOCM_RTS
+    /* In kernel mode, the driver toggles RTS around the write */
+    if (ctx_rtu->rts != MODBUS_RTU_RTS_NONE &&
+        ctx_rtu->rts_release != MODBUS_RTU_RTS_RELEASE_KERNEL) {
         ssize_t size;
 
         if (ctx->debug) {
@@ -311,7 +274,15 @@ static ssize_t _modbus_rtu_send(modbus_t *ctx, const uint8_t *req, int req_lengt
 
         size = write(ctx->s, req, req_length);
 
-        usleep(ctx_rtu->onebyte_time * req_length + ctx_rtu->rts_delay);
+        if (ctx_rtu->rts_release == MODBUS_RTU_RTS_RELEASE_DRAIN) {
+            _modbus_rtu_drain(ctx);
+            /* The default delay of one character would release RTS late */
+            if (ctx_rtu->rts_delay_set) {
+                usleep(ctx_rtu->rts_delay);
+            }
+        } else {
+            usleep(ctx_rtu->onebyte_time * req_length + ctx_rtu->rts_delay);
+        }
         ctx_rtu->set_rts(ctx, ctx_rtu->rts != MODBUS_RTU_RTS_UP);
 
         return size;
@@ -349,14 +320,20 @@ static int _modbus_rtu_receive(modbus_t *ctx, uint8_t *req)
 
 static ssize_t _modbus_rtu_recv(modbus_t *ctx, uint8_t *rsp, int rsp_length)
 {
+    modbus_rtu_t *ctx_rtu = ctx->backend_data;
+    ssize_t rc;
+
 #if defined(_WIN32)
-    return win32_ser_read(&((modbus_rtu_t *)ctx->backend_data)->w_ser, rsp, rsp_length);
+    rc = win32_ser_read(&ctx_rtu->w_ser, rsp, rsp_length);
 #else
-    return read(ctx->s, rsp, rsp_length);
+    rc = read(ctx->s, rsp, rsp_length);
 #endif
-}
+    if (rc > 0) {
+        ctx_rtu->in_frame = TRUE;
+    }
 
-static int _modbus_rtu_flush(modbus_t *);
+    return rc;
+}
 
 static int _modbus_rtu_pre_check_confirmation(modbus_t *ctx, const uint8_t *req,
                                               const uint8_t *rsp, int rsp_length)
@@ -386,6 +363,9 @@ static int _modbus_rtu_check_integrity(modbus_t *ctx, uint8_t *msg,
     uint16_t crc_received;
     int slave = msg[0];
 
+    /* The next byte read starts a new frame */
+    ((modbus_rtu_t *)ctx->backend_data)->in_frame = FALSE;
+
     /* Filter on the Modbus unit identifier (slave) in RTU mode to avoid useless
      * CRC computing. */
     if (slave != ctx->slave && slave != MODBUS_BROADCAST_ADDRESS) {
@@ -396,7 +376,7 @@ static int _modbus_rtu_check_integrity(modbus_t *ctx, uint8_t *msg,
         return 0;
     }
 
-    crc_calculated = crc16(msg, msg_length - 2);
+    crc_calculated = modbus_rtu_crc16(msg, msg_length - 2);
     crc_received = (msg[msg_length - 2] << 8) | msg[msg_length - 1];
 
     /* BEGIN QMODBUS MODIFICATION */
@@ -413,14 +393,129 @@ static int _modbus_rtu_check_integrity(modbus_t *ctx, uint8_t *msg,
                     crc_received, crc_calculated);
         }
 
-        if (ctx->error_recovery & MODBUS_ERROR_RECOVERY_PROTOCOL) {
-            _modbus_rtu_flush(ctx);
+        /* A resync looks for the next frame in the bytes received */
+        if ((ctx->error_recovery & MODBUS_ERROR_RECOVERY_PROTOCOL) &&
+            !(ctx->error_recovery & MODBUS_ERROR_RECOVERY_RESYNC)) {
+            modbus_flush(ctx);
         }
         errno = EMBBADCRC;
         return -1;
     }
 }
 
+#if HAVE_DECL_TIOCSSERIAL
+/* Finds the latency timer of the USB adapter (FTDI and alike) behind the
+   device in sysfs. Returns -1 if the device doesn't resolve. */
+static int _modbus_rtu_latency_timer_path(modbus_rtu_t *ctx_rtu, char *path,
+                                          size_t size)
+{
+    char real_path[PATH_MAX];
+    const char *name;
+
+    if (realpath(ctx_rtu->device, real_path) == NULL)
+        return -1;
+
+    name = strrchr(real_path, '/');
+    name = (name != NULL) ? name + 1 : real_path;
+    if (snprintf(path, size, "/sys/class/tty/%s/device/latency_timer",
+                 name) >= (int)size)
+        return -1;
+
+    return 0;
+}
+
+/* Reads the latency timer in ms, -1 if the adapter hasn't one */
+static int _modbus_rtu_get_latency_timer(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    int ms = -1;
+
+    if (file != NULL) {
+        if (fscanf(file, "%d", &ms) != 1)
+            ms = -1;
+        fclose(file);
+    }
+
+    return ms;
+}
+
+static int _modbus_rtu_set_latency_timer(const char *path, int ms)
+{
+    FILE *file = fopen(path, "w");
+    int rc;
+
+    if (file == NULL)
+        return -1;
+
+    rc = fprintf(file, "%d", ms);
+    if (fclose(file) != 0)
+        rc = -1;
+
+    return (rc < 0) ? -1 : 0;
+}
+
+/* Asks the driver to hand over each byte received at once and the USB
+   adapter to send its buffer after 1 ms instead of 16. Both are best effort,
+   a serial port without them is still used. */
+static void _modbus_rtu_apply_low_latency(modbus_t *ctx)
+{
+    modbus_rtu_t *ctx_rtu = ctx->backend_data;
+    struct serial_struct serial;
+    char path[PATH_MAX];
+
+    if (ctx_rtu->old_async_low_latency == -1 &&
+        ioctl(ctx->s, TIOCGSERIAL, &serial) == 0) {
+        int old = (serial.flags & ASYNC_LOW_LATENCY) ? TRUE : FALSE;
+
+        serial.flags |= ASYNC_LOW_LATENCY;
+        if (ioctl(ctx->s, TIOCSSERIAL, &serial) == 0) {
+            ctx_rtu->old_async_low_latency = old;
+        } else if (ctx->debug) {
+            fprintf(stderr, "WARNING Can't set ASYNC_LOW_LATENCY on %s (%s)\n",
+                    ctx_rtu->device, strerror(errno));
+        }
+    } else if (ctx->debug && ctx_rtu->old_async_low_latency == -1) {
+        fprintf(stderr, "WARNING No serial driver settings for %s (%s)\n",
+                ctx_rtu->device, strerror(errno));
+    }
+
+    if (ctx_rtu->old_latency_timer == -1 &&
+        _modbus_rtu_latency_timer_path(ctx_rtu, path, sizeof(path)) == 0) {
+        int old = _modbus_rtu_get_latency_timer(path);
+
+        if (old > 1) {
+            if (_modbus_rtu_set_latency_timer(path, 1) == 0) {
+                ctx_rtu->old_latency_timer = old;
+            } else if (ctx->debug) {
+                fprintf(stderr, "WARNING Can't write %s (%s)\n", path,
+                        strerror(errno));
+            }
+        }
+    }
+}
+
+/* Puts back the settings changed by the low latency profile */
+static void _modbus_rtu_restore_low_latency(modbus_t *ctx)
+{
+    modbus_rtu_t *ctx_rtu = ctx->backend_data;
+    struct serial_struct serial;
+    char path[PATH_MAX];
+
+    if (ctx_rtu->old_async_low_latency == FALSE &&
+        ioctl(ctx->s, TIOCGSERIAL, &serial) == 0) {
+        serial.flags &= ~ASYNC_LOW_LATENCY;
+        ioctl(ctx->s, TIOCSSERIAL, &serial);
+    }
+    ctx_rtu->old_async_low_latency = -1;
+
+    if (ctx_rtu->old_latency_timer != -1 &&
+        _modbus_rtu_latency_timer_path(ctx_rtu, path, sizeof(path)) == 0) {
+        _modbus_rtu_set_latency_timer(path, ctx_rtu->old_latency_timer);
+    }
+    ctx_rtu->old_latency_timer = -1;
+}
+#endif
+
 /* Sets up a serial port for RTU communications */
 static int _modbus_rtu_connect(modbus_t *ctx)
 {
@@ -433,6 +528,8 @@ static int _modbus_rtu_connect(modbus_t *ctx)
 #endif
     modbus_rtu_t *ctx_rtu = ctx->backend_data;
 
+    ctx_rtu->in_frame = FALSE;
+
     if (ctx->debug) {
         printf("Opening %s at %d bauds (%c, %d, %d)\n",
                ctx_rtu->device, ctx_rtu->baud, ctx_rtu->parity,
@@ -921,6 +1018,12 @@ static int _modbus_rtu_connect(modbus_t *ctx)
         ctx->s = -1;
         return -1;
     }
+
+#if HAVE_DECL_TIOCSSERIAL
+    if (ctx_rtu->low_latency) {
+        _modbus_rtu_apply_low_latency(ctx);
+    }
+#endif
 #endif
 
     return 0;
@@ -933,7 +1036,7 @@ int modbus_rtu_set_serial_mode(modbus_t *ctx, int mode)
         return -1;
     }
 
-    if (ctx->backend->backend_type == _MODBUS_BACKEND_TYPE_RTU) {
+    if (_modbus_rtu_is_serial(ctx)) {
 #if HAVE_DECL_TIOCSRS485
         modbus_rtu_t *ctx_rtu = ctx->backend_data;
         struct serial_rs485 rs485conf;
@@ -946,6 +1049,12 @@ int modbus_rtu_set_serial_mode(modbus_t *ctx, int mode)
             }
 
             ctx_rtu->serial_mode = MODBUS_RTU_RS485;
+#if HAVE_DECL_TIOCM_RTS
+            /* The RTS settings of the driver are cleared */
+            if (ctx_rtu->rts_release == MODBUS_RTU_RTS_RELEASE_KERNEL) {
+                ctx_rtu->rts_release = MODBUS_RTU_RTS_RELEASE_DELAY;
+            }
+#endif
             return 0;
         } else if (mode == MODBUS_RTU_RS232) {
             /* Turn off RS485 mode only if required */
@@ -956,6 +1065,11 @@ int modbus_rtu_set_serial_mode(modbus_t *ctx, int mode)
                 }
             }
             ctx_rtu->serial_mode = MODBUS_RTU_RS232;
+#if HAVE_DECL_TIOCM_RTS
+            if (ctx_rtu->rts_release == MODBUS_RTU_RTS_RELEASE_KERNEL) {
+                ctx_rtu->rts_release = MODBUS_RTU_RTS_RELEASE_DELAY;
+            }
+#endif
             return 0;
         }
 #else
@@ -979,7 +1093,7 @@ int modbus_rtu_get_serial_mode(modbus_t *ctx)
         return -1;
     }
 
-    if (ctx->backend->backend_type == _MODBUS_BACKEND_TYPE_RTU) {
+    if (_modbus_rtu_is_serial(ctx)) {
 #if HAVE_DECL_TIOCSRS485
         modbus_rtu_t *ctx_rtu = ctx->backend_data;
         return ctx_rtu->serial_mode;
@@ -1003,7 +1117,7 @@ int modbus_rtu_get_rts(modbus_t *ctx)
         return -1;
     }
 
-    if (ctx->backend->backend_type == _MODBUS_BACKEND_TYPE_RTU) {
+    if (_modbus_rtu_is_serial(ctx)) {
 #if HAVE_DECL_TIOCM_RTS
         modbus_rtu_t *ctx_rtu = ctx->backend_data;
         return ctx_rtu->rts;
@@ -1027,7 +1141,7 @@ int modbus_rtu_set_rts(modbus_t *ctx, int mode)
         return -1;
     }
 
-    if (ctx->backend->backend_type == _MODBUS_BACKEND_TYPE_RTU) {
+    if (_modbus_rtu_is_serial(ctx)) {
 #if HAVE_DECL_TIOCM_RTS
         modbus_rtu_t *ctx_rtu = ctx->backend_data;
 
@@ -1063,7 +1177,7 @@ int modbus_rtu_set_custom_rts(modbus_t *ctx, void (*set_rts) (modbus_t *ctx, int
         return -1;
     }
 
-    if (ctx->backend->backend_type == _MODBUS_BACKEND_TYPE_RTU) {
+    if (_modbus_rtu_is_serial(ctx)) {
 #if HAVE_DECL_TIOCM_RTS
         modbus_rtu_t *ctx_rtu = ctx->backend_data;
         ctx_rtu->set_rts = set_rts;
@@ -1088,7 +1202,7 @@ int modbus_rtu_get_rts_delay(modbus_t *ctx)
         return -1;
     }
 
-    if (ctx->backend->backend_type == _MODBUS_BACKEND_TYPE_RTU) {
+    if (_modbus_rtu_is_serial(ctx)) {
 #if HAVE_DECL_TIOCM_RTS
         modbus_rtu_t *ctx_rtu;
         ctx_rtu = (modbus_rtu_t *)ctx->backend_data;
@@ -1113,11 +1227,12 @@ int modbus_rtu_set_rts_delay(modbus_t *ctx, int us)
         return -1;
     }
 
-    if (ctx->backend->backend_type == _MODBUS_BACKEND_TYPE_RTU) {
+    if (_modbus_rtu_is_serial(ctx)) {
 #if HAVE_DECL_TIOCM_RTS
         modbus_rtu_t *ctx_rtu;
         ctx_rtu = (modbus_rtu_t *)ctx->backend_data;
         ctx_rtu->rts_delay = us;
+        ctx_rtu->rts_delay_set = TRUE;
         return 0;
 #else
         if (ctx->debug) {
@@ -1132,6 +1247,200 @@ int modbus_rtu_set_rts_delay(modbus_t *ctx, int us)
     }
 }
 
+int modbus_rtu_get_rts_release(modbus_t *ctx)
+{
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (_modbus_rtu_is_serial(ctx)) {
+#if HAVE_DECL_TIOCM_RTS
+        modbus_rtu_t *ctx_rtu = ctx->backend_data;
+        return ctx_rtu->rts_release;
+#else
+        if (ctx->debug) {
+            fprintf(stderr, "This function isn't supported on your platform\n");
+        }
+        errno = ENOTSUP;
+        return -1;
+#endif
+    } else {
+        errno = EINVAL;
+        return -1;
+    }
+}
+
+/* Sets how RTS is released after a transmission: after a delay estimated from
+   the baud rate, once the transmitter is empty or by the driver itself
+   (Linux RS485 mode, the connection must be established) */
+int modbus_rtu_set_rts_release(modbus_t *ctx, int mode)
+{
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (_modbus_rtu_is_serial(ctx)) {
+#if HAVE_DECL_TIOCM_RTS
+        modbus_rtu_t *ctx_rtu = ctx->backend_data;
+
+        if (mode == MODBUS_RTU_RTS_RELEASE_DELAY ||
+            mode == MODBUS_RTU_RTS_RELEASE_DRAIN) {
+#if HAVE_DECL_TIOCSRS485
+            if (ctx_rtu->rts_release == MODBUS_RTU_RTS_RELEASE_KERNEL) {
+                /* Gives the control of RTS back */
+                if (modbus_rtu_set_serial_mode(ctx, MODBUS_RTU_RS232) == -1) {
+                    return -1;
+                }
+            }
+#endif
+            ctx_rtu->rts_release = mode;
+            return 0;
+        } else if (mode == MODBUS_RTU_RTS_RELEASE_KERNEL) {
+#if HAVE_DECL_TIOCSRS485
+            struct serial_rs485 rs485conf;
+
+            memset(&rs485conf, 0x0, sizeof(struct serial_rs485));
+            rs485conf.flags = SER_RS485_ENABLED;
+            if (ctx_rtu->rts == MODBUS_RTU_RTS_DOWN) {
+                rs485conf.flags |= SER_RS485_RTS_AFTER_SEND;
+            } else {
+                rs485conf.flags |= SER_RS485_RTS_ON_SEND;
+            }
+            /* The driver counts the delays in milliseconds */
+            rs485conf.delay_rts_before_send = ctx_rtu->rts_delay / 1000;
+            rs485conf.delay_rts_after_send = ctx_rtu->rts_delay / 1000;
+            if (ioctl(ctx->s, TIOCSRS485, &rs485conf) < 0) {
+                return -1;
+            }
+
+            ctx_rtu->serial_mode = MODBUS_RTU_RS485;
+            ctx_rtu->rts_release = mode;
+            return 0;
+#else
+            if (ctx->debug) {
+                fprintf(stderr, "This function isn't supported on your platform\n");
+            }
+            errno = ENOTSUP;
+            return -1;
+#endif
+        }
+#else
+        if (ctx->debug) {
+            fprintf(stderr, "This function isn't supported on your platform\n");
+        }
+        errno = ENOTSUP;
+        return -1;
+#endif
+    }
+
+    /* Wrong backend or invalid mode specified */
+    errno = EINVAL;
+    return -1;
+}
+
+/* Enables the low latency profile of the serial port, applied on connect (or
+   at once if the port is open) and undone on close */
+int modbus_rtu_set_low_latency(modbus_t *ctx, int flag)
+{
+    if (ctx == NULL || !_modbus_rtu_is_serial(ctx)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+#if HAVE_DECL_TIOCSSERIAL
+    {
+        modbus_rtu_t *ctx_rtu = ctx->backend_data;
+
+        ctx_rtu->low_latency = flag ? TRUE : FALSE;
+        if (ctx->s != -1) {
+            if (ctx_rtu->low_latency) {
+                _modbus_rtu_apply_low_latency(ctx);
+            } else {
+                _modbus_rtu_restore_low_latency(ctx);
+            }
+        }
+        return 0;
+    }
+#else
+    if (ctx->debug) {
+        fprintf(stderr, "This function isn't supported on your platform\n");
+    }
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
+int modbus_rtu_get_low_latency(modbus_t *ctx)
+{
+    if (ctx == NULL || !_modbus_rtu_is_serial(ctx)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return ((modbus_rtu_t *)ctx->backend_data)->low_latency;
+}
+
+/* The 3.5 character times of the specification (1750 us above 19200 bauds) */
+static int frame_gap_auto(modbus_rtu_t *ctx_rtu)
+{
+    int bits;
+
+    if (ctx_rtu->baud > 19200)
+        return 1750;
+
+    bits = 1 + ctx_rtu->data_bit + (ctx_rtu->parity == 'N' ? 0 : 1) +
+        ctx_rtu->stop_bit;
+
+    /* 3.5 characters, rounded up */
+    return (int)((7000000LL * bits + 2 * ctx_rtu->baud - 1) /
+                 (2 * ctx_rtu->baud));
+}
+
+/* Sets the silence in microseconds ending a frame being received, 0 to
+   disable it or MODBUS_RTU_FRAME_GAP_AUTO for the 3.5 character times of the
+   specification (1750 us above 19200 bauds) */
+int modbus_rtu_set_frame_gap(modbus_t *ctx, int us)
+{
+    modbus_rtu_t *ctx_rtu;
+
+    if (ctx == NULL || us < MODBUS_RTU_FRAME_GAP_AUTO ||
+        ctx->backend->backend_type != _MODBUS_BACKEND_TYPE_RTU) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ctx_rtu = (modbus_rtu_t *)ctx->backend_data;
+    if (us == MODBUS_RTU_FRAME_GAP_AUTO) {
+        us = frame_gap_auto(ctx_rtu);
+    }
+    ctx_rtu->frame_gap = us;
+
+    return 0;
+}
+
+/* Silence in microseconds after which the line is idle, the frame gap set
+   or else 3.5 character times. Also given the ASCII contexts, their line is
+   set up as in RTU. */
+int _modbus_rtu_silence_time(modbus_t *ctx)
+{
+    modbus_rtu_t *ctx_rtu = (modbus_rtu_t *)ctx->backend_data;
+
+    return ctx_rtu->frame_gap > 0 ? ctx_rtu->frame_gap :
+        frame_gap_auto(ctx_rtu);
+}
+
+int modbus_rtu_get_frame_gap(modbus_t *ctx)
+{
+    if (ctx == NULL || ctx->backend->backend_type != _MODBUS_BACKEND_TYPE_RTU) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return ((modbus_rtu_t *)ctx->backend_data)->frame_gap;
+}
+
 static void _modbus_rtu_close(modbus_t *ctx)
 {
     /* Restore line settings and close file descriptor in RTU mode */
@@ -1150,6 +1459,9 @@ static void _modbus_rtu_close(modbus_t *ctx)
     }
 #else
     if (ctx->s != -1) {
+#if HAVE_DECL_TIOCSSERIAL
+        _modbus_rtu_restore_low_latency(ctx);
+#endif
         tcsetattr(ctx->s, TCSANOW, &ctx_rtu->old_tios);
         close(ctx->s);
         ctx->s = -1;
@@ -1159,8 +1471,10 @@ static void _modbus_rtu_close(modbus_t *ctx)
 
 static int _modbus_rtu_flush(modbus_t *ctx)
 {
-#if defined(_WIN32)
     modbus_rtu_t *ctx_rtu = ctx->backend_data;
+
+    ctx_rtu->in_frame = FALSE;
+#if defined(_WIN32)
     ctx_rtu->w_ser.n_bytes = 0;
     return (PurgeComm(ctx_rtu->w_ser.fd, PURGE_RXCLEAR) == FALSE);
 #else
@@ -1168,42 +1482,46 @@ static int _modbus_rtu_flush(modbus_t *ctx)
 #endif
 }
 
-static int _modbus_rtu_select(modbus_t *ctx, fd_set *rset,
-                              struct timeval *tv, int length_to_read)
+static int _modbus_rtu_select(modbus_t *ctx, struct timeval *tv,
+                              int length_to_read)
 {
+    modbus_rtu_t *ctx_rtu = ctx->backend_data;
+    struct timeval gap_tv;
+    int gap_wait = FALSE;
     int s_rc;
-#if defined(_WIN32)
-    s_rc = win32_ser_select(&((modbus_rtu_t *)ctx->backend_data)->w_ser,
-                            length_to_read, tv);
-    if (s_rc == 0) {
-        errno = ETIMEDOUT;
-        return -1;
-    }
 
-    if (s_rc < 0) {
-        return -1;
-    }
-#else
-    while ((s_rc = select(ctx->s+1, rset, NULL, NULL, tv)) == -1) {
-        if (errno == EINTR) {
-            if (ctx->debug) {
-                fprintf(stderr, "A non blocked signal was caught\n");
-            }
-            /* Necessary after an error */
-            FD_ZERO(rset);
-            FD_SET(ctx->s, rset);
-        } else {
-            return -1;
-        }
+    /* Once a frame has started, a silence of the frame gap ends it even if
+       the length expected from its function code isn't reached so a
+       malformed frame is given up after a few characters instead of the
+       byte timeout */
+    if (ctx_rtu->frame_gap > 0 && ctx_rtu->in_frame && tv != NULL &&
+        (tv->tv_sec > 0 || tv->tv_usec > ctx_rtu->frame_gap)) {
+        gap_tv.tv_sec = 0;
+        gap_tv.tv_usec = ctx_rtu->frame_gap;
+        tv = &gap_tv;
+        gap_wait = TRUE;
     }
 
+#if defined(_WIN32)
+    s_rc = win32_ser_select(&ctx_rtu->w_ser, length_to_read, tv);
     if (s_rc == 0) {
-        /* Timeout */
         errno = ETIMEDOUT;
-        return -1;
+        s_rc = -1;
     }
+#else
+    s_rc = _modbus_wait_readable(ctx, tv);
 #endif
 
+    if (s_rc == -1 && errno == ETIMEDOUT && gap_wait) {
+        if (ctx->debug) {
+            fprintf(stderr, "Frame ended by a silence of %d us, %d bytes missing\n",
+                    ctx_rtu->frame_gap, length_to_read);
+        }
+        /* The line is silent, nothing is left to flush */
+        ctx_rtu->in_frame = FALSE;
+        errno = EMBBADDATA;
+    }
+
     return s_rc;
 }
 
@@ -1296,8 +1614,22 @@ modbus_t* modbus_new_rtu(const char *device,
 
     /* The delay before and after transmission when toggling the RTS pin */
     ctx_rtu->rts_delay = ctx_rtu->onebyte_time;
+    ctx_rtu->rts_delay_set = FALSE;
+
+    /* The end of the transmission is estimated from the baud rate */
+    ctx_rtu->rts_release = MODBUS_RTU_RTS_RELEASE_DELAY;
 #endif
 
+    ctx_rtu->low_latency = FALSE;
+#if HAVE_DECL_TIOCSSERIAL
+    ctx_rtu->old_async_low_latency = -1;
+    ctx_rtu->old_latency_timer = -1;
+#endif
+
+    /* The end of a frame is found from its length by default */
+    ctx_rtu->frame_gap = 0;
+    ctx_rtu->in_frame = FALSE;
+
     ctx_rtu->confirmation_to_ignore = FALSE;
 
     return ctx;
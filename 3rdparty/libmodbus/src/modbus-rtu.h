@@ -37,6 +37,23 @@ MODBUS_API int modbus_rtu_set_custom_rts(modbus_t *ctx, void (*set_rts) (modbus_
 MODBUS_API int modbus_rtu_set_rts_delay(modbus_t *ctx, int us);
 MODBUS_API int modbus_rtu_get_rts_delay(modbus_t *ctx);
 
+#define MODBUS_RTU_RTS_RELEASE_DELAY  0
+#define MODBUS_RTU_RTS_RELEASE_DRAIN  1
+#define MODBUS_RTU_RTS_RELEASE_KERNEL 2
+
+MODBUS_API int modbus_rtu_set_rts_release(modbus_t *ctx, int mode);
+MODBUS_API int modbus_rtu_get_rts_release(modbus_t *ctx);
+
+MODBUS_API int modbus_rtu_set_low_latency(modbus_t *ctx, int flag);
+MODBUS_API int modbus_rtu_get_low_latency(modbus_t *ctx);
+
+#define MODBUS_RTU_FRAME_GAP_AUTO -1
+
+MODBUS_API int modbus_rtu_set_frame_gap(modbus_t *ctx, int us);
+MODBUS_API int modbus_rtu_get_frame_gap(modbus_t *ctx);
+
+MODBUS_API uint16_t modbus_rtu_crc16(const uint8_t *buffer, size_t length);
+
 MODBUS_END_DECLS
 
 #endif /* MODBUS_RTU_H */
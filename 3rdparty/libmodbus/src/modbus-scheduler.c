@@ -0,0 +1,471 @@
+/*
+ * Copyright © 2001-2011 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <config.h>
+
+#include "modbus-private.h"
+#include "modbus-scheduler.h"
+
+/* A scheduler polls the slaves of a multidrop line through one context. The
+ * jobs are kept in a binary heap ordered by their next deadline and the one
+ * due first is always polled first, whatever the order of their addition.
+ *
+ * A slave which doesn't answer (ETIMEDOUT) costs a full response timeout per
+ * poll. Its jobs are then skipped for a backoff period, doubled after each
+ * timeout in a row, so only one poll per period probes it and the line time
+ * goes to the slaves which answer. */
+
+/* Default backoff of a slave after its first timeout and its limit */
+#define _BACKOFF_MIN_MS 1000
+#define _BACKOFF_MAX_MS 60000
+
+struct _modbus_scheduler_job {
+    int active;
+    int slave;
+    int function;
+    int addr;
+    int nb;
+    void *dest;
+    uint64_t period;
+    modbus_scheduler_callback_t callback;
+    void *user_data;
+    /* Absolute time of the next poll (see _modbus_time_us) */
+    uint64_t due;
+    /* Position in the heap, -1 while the job is polled or removed */
+    int heap_index;
+    uint64_t stats_start;
+    uint64_t polls;
+    uint64_t failures;
+    uint64_t skipped;
+};
+
+struct _modbus_scheduler_slave {
+    int timeouts;
+    uint32_t backoff_ms;
+    uint64_t backoff_end;
+};
+
+struct _modbus_scheduler {
+    modbus_t *ctx;
+    struct _modbus_scheduler_job *jobs;
+    int nb_jobs;
+    int max_jobs;
+    /* Indexes of the active jobs, the root is due first */
+    int *heap;
+    int heap_length;
+    uint32_t backoff_min_ms;
+    uint32_t backoff_max_ms;
+    /* Every unit identifier, from the broadcast address to 255 */
+    struct _modbus_scheduler_slave slaves[256];
+};
+
+modbus_scheduler_t* modbus_scheduler_new(modbus_t *ctx)
+{
+    modbus_scheduler_t *scheduler;
+
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    scheduler = (modbus_scheduler_t *)malloc(sizeof(modbus_scheduler_t));
+    if (scheduler == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    scheduler->ctx = ctx;
+    scheduler->jobs = NULL;
+    scheduler->nb_jobs = 0;
+    scheduler->max_jobs = 0;
+    scheduler->heap = NULL;
+    scheduler->heap_length = 0;
+    scheduler->backoff_min_ms = _BACKOFF_MIN_MS;
+    scheduler->backoff_max_ms = _BACKOFF_MAX_MS;
+    memset(scheduler->slaves, 0, sizeof(scheduler->slaves));
+
+    return scheduler;
+}
+
+/* The context is neither closed nor freed */
+void modbus_scheduler_free(modbus_scheduler_t *scheduler)
+{
+    if (scheduler == NULL)
+        return;
+
+    free(scheduler->jobs);
+    free(scheduler->heap);
+    free(scheduler);
+}
+
+static void heap_set(modbus_scheduler_t *scheduler, int index, int job)
+{
+    scheduler->heap[index] = job;
+    scheduler->jobs[job].heap_index = index;
+}
+
+static uint64_t heap_due(modbus_scheduler_t *scheduler, int index)
+{
+    return scheduler->jobs[scheduler->heap[index]].due;
+}
+
+static void heap_sift_up(modbus_scheduler_t *scheduler, int index)
+{
+    int job = scheduler->heap[index];
+    uint64_t due = scheduler->jobs[job].due;
+
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+
+        if (heap_due(scheduler, parent) <= due)
+            break;
+        heap_set(scheduler, index, scheduler->heap[parent]);
+        index = parent;
+    }
+    heap_set(scheduler, index, job);
+}
+
+static void heap_sift_down(modbus_scheduler_t *scheduler, int index)
+{
+    int job = scheduler->heap[index];
+    uint64_t due = scheduler->jobs[job].due;
+
+    for (;;) {
+        int child = 2 * index + 1;
+
+        if (child >= scheduler->heap_length)
+            break;
+        if (child + 1 < scheduler->heap_length &&
+            heap_due(scheduler, child + 1) < heap_due(scheduler, child)) {
+            child++;
+        }
+        if (due <= heap_due(scheduler, child))
+            break;
+        heap_set(scheduler, index, scheduler->heap[child]);
+        index = child;
+    }
+    heap_set(scheduler, index, job);
+}
+
+static void heap_push(modbus_scheduler_t *scheduler, int job)
+{
+    int index = scheduler->heap_length++;
+
+    heap_set(scheduler, index, job);
+    heap_sift_up(scheduler, index);
+}
+
+static void heap_remove(modbus_scheduler_t *scheduler, int index)
+{
+    int last = scheduler->heap[--scheduler->heap_length];
+
+    scheduler->jobs[scheduler->heap[index]].heap_index = -1;
+    if (index == scheduler->heap_length)
+        return;
+
+    /* The last job takes the place of the removed one */
+    heap_set(scheduler, index, last);
+    if (index > 0 && heap_due(scheduler, (index - 1) / 2) > heap_due(scheduler, index)) {
+        heap_sift_up(scheduler, index);
+    } else {
+        heap_sift_down(scheduler, index);
+    }
+}
+
+/* Returns the identifier of the job, polled as soon as the scheduler runs
+   then every period_ms, or -1 with errno set */
+int modbus_scheduler_add(modbus_scheduler_t *scheduler, int slave,
+                         int function, int addr, int nb, void *dest,
+                         uint32_t period_ms,
+                         modbus_scheduler_callback_t callback, void *user_data)
+{
+    struct _modbus_scheduler_job *job;
+    int max_nb;
+    int i;
+
+    if (function == MODBUS_FC_READ_COILS ||
+        function == MODBUS_FC_READ_DISCRETE_INPUTS) {
+        max_nb = MODBUS_MAX_READ_BITS;
+    } else if (function == MODBUS_FC_READ_HOLDING_REGISTERS ||
+               function == MODBUS_FC_READ_INPUT_REGISTERS) {
+        max_nb = MODBUS_MAX_READ_REGISTERS;
+    } else {
+        max_nb = 0;
+    }
+
+    if (scheduler == NULL || slave < 0 || slave > 255 || nb < 1 || nb > max_nb ||
+        dest == NULL || period_ms == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* The identifiers of the removed jobs are reused */
+    for (i = 0; i < scheduler->nb_jobs; i++) {
+        if (!scheduler->jobs[i].active)
+            break;
+    }
+
+    if (i == scheduler->max_jobs) {
+        int max_jobs = (scheduler->max_jobs == 0) ? 16 : 2 * scheduler->max_jobs;
+        struct _modbus_scheduler_job *jobs;
+        int *heap;
+
+        jobs = (struct _modbus_scheduler_job *)realloc(
+            scheduler->jobs, max_jobs * sizeof(struct _modbus_scheduler_job));
+        if (jobs == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        scheduler->jobs = jobs;
+
+        heap = (int *)realloc(scheduler->heap, max_jobs * sizeof(int));
+        if (heap == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        scheduler->heap = heap;
+
+        scheduler->max_jobs = max_jobs;
+    }
+    if (i == scheduler->nb_jobs) {
+        scheduler->nb_jobs++;
+    }
+
+    job = &scheduler->jobs[i];
+    job->active = TRUE;
+    job->slave = slave;
+    job->function = function;
+    job->addr = addr;
+    job->nb = nb;
+    job->dest = dest;
+    job->period = (uint64_t)period_ms * 1000;
+    job->callback = callback;
+    job->user_data = user_data;
+    job->due = _modbus_time_us();
+    job->stats_start = job->due;
+    job->polls = 0;
+    job->failures = 0;
+    job->skipped = 0;
+    heap_push(scheduler, i);
+
+    return i;
+}
+
+/* Can be called from a callback, even for the job being polled */
+int modbus_scheduler_remove(modbus_scheduler_t *scheduler, int job)
+{
+    if (scheduler == NULL || job < 0 || job >= scheduler->nb_jobs ||
+        !scheduler->jobs[job].active) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (scheduler->jobs[job].heap_index != -1) {
+        heap_remove(scheduler, scheduler->jobs[job].heap_index);
+    }
+    scheduler->jobs[job].active = FALSE;
+
+    return 0;
+}
+
+int modbus_scheduler_set_backoff(modbus_scheduler_t *scheduler,
+                                 uint32_t min_ms, uint32_t max_ms)
+{
+    if (scheduler == NULL || min_ms == 0 || max_ms < min_ms) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    scheduler->backoff_min_ms = min_ms;
+    scheduler->backoff_max_ms = max_ms;
+    return 0;
+}
+
+static void sleep_until(uint64_t time)
+{
+    uint64_t now = _modbus_time_us();
+    uint64_t us;
+
+    if (now >= time)
+        return;
+    us = time - now;
+
+#ifdef _WIN32
+    /* Rounded up so the deadline is reached */
+    Sleep((DWORD)((us + 999) / 1000));
+#else
+    {
+        struct timespec request, remaining;
+
+        request.tv_sec = us / 1000000;
+        request.tv_nsec = (long)(us % 1000000) * 1000;
+        while (nanosleep(&request, &remaining) == -1 && errno == EINTR) {
+            request = remaining;
+        }
+    }
+#endif
+}
+
+static int poll_job(modbus_t *ctx, struct _modbus_scheduler_job *job)
+{
+    if (modbus_set_slave(ctx, job->slave) == -1)
+        return -1;
+
+    switch (job->function) {
+    case MODBUS_FC_READ_COILS:
+        return modbus_read_bits(ctx, job->addr, job->nb, (uint8_t *)job->dest);
+    case MODBUS_FC_READ_DISCRETE_INPUTS:
+        return modbus_read_input_bits(ctx, job->addr, job->nb, (uint8_t *)job->dest);
+    case MODBUS_FC_READ_HOLDING_REGISTERS:
+        return modbus_read_registers(ctx, job->addr, job->nb, (uint16_t *)job->dest);
+    default:
+        return modbus_read_input_registers(ctx, job->addr, job->nb,
+                                           (uint16_t *)job->dest);
+    }
+}
+
+/* Updates the backoff of the slave after a poll */
+static void update_slave(modbus_scheduler_t *scheduler,
+                         struct _modbus_scheduler_slave *slave, int rc,
+                         uint64_t now)
+{
+    if (rc != -1) {
+        slave->timeouts = 0;
+        slave->backoff_ms = 0;
+        slave->backoff_end = 0;
+    } else if (errno == ETIMEDOUT) {
+        /* Other errors come from a slave still answering */
+        if (slave->timeouts++ == 0) {
+            slave->backoff_ms = scheduler->backoff_min_ms;
+        } else if (slave->backoff_ms < scheduler->backoff_max_ms / 2) {
+            slave->backoff_ms *= 2;
+        } else {
+            slave->backoff_ms = scheduler->backoff_max_ms;
+        }
+        slave->backoff_end = now + (uint64_t)slave->backoff_ms * 1000;
+    }
+}
+
+/* Polls the jobs as they are due during timeout_ms milliseconds. Returns the
+   number of polls or -1 with errno set. */
+int modbus_scheduler_run(modbus_scheduler_t *scheduler, int timeout_ms)
+{
+    uint64_t end;
+    int nb_polls = 0;
+
+    if (scheduler == NULL || timeout_ms < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    end = _modbus_time_us() + (uint64_t)timeout_ms * 1000;
+    while (scheduler->heap_length > 0 && heap_due(scheduler, 0) <= end) {
+        struct _modbus_scheduler_job *job;
+        struct _modbus_scheduler_slave *slave;
+        uint64_t now;
+        int index;
+        int rc;
+
+        sleep_until(heap_due(scheduler, 0));
+
+        index = scheduler->heap[0];
+        job = &scheduler->jobs[index];
+        slave = &scheduler->slaves[job->slave];
+        now = _modbus_time_us();
+
+        if (now < slave->backoff_end) {
+            /* Waits for the end of the backoff, another job of the slave
+               could probe it before */
+            job->skipped++;
+            job->due = slave->backoff_end;
+            heap_sift_down(scheduler, 0);
+            continue;
+        }
+
+        heap_remove(scheduler, 0);
+        rc = poll_job(scheduler->ctx, job);
+        now = _modbus_time_us();
+        nb_polls++;
+        job->polls++;
+        if (rc == -1) {
+            job->failures++;
+        }
+        update_slave(scheduler, slave, rc, now);
+
+        /* Keeps the phase of the job, the periods already missed are
+           skipped rather than polled in a burst */
+        job->due += job->period;
+        if (job->due <= now) {
+            job->due += ((now - job->due) / job->period + 1) * job->period;
+        }
+
+        if (job->callback != NULL) {
+            job->callback(scheduler, index, rc, job->user_data);
+        }
+
+        /* The jobs can be moved or removed by the callback */
+        job = &scheduler->jobs[index];
+        if (job->active && job->heap_index == -1) {
+            heap_push(scheduler, index);
+        }
+    }
+
+    sleep_until(end);
+
+    return nb_polls;
+}
+
+int modbus_scheduler_get_stats(modbus_scheduler_t *scheduler, int job,
+                               modbus_scheduler_stats_t *stats)
+{
+    struct _modbus_scheduler_job *j;
+    uint64_t elapsed;
+
+    if (scheduler == NULL || stats == NULL || job < 0 ||
+        job >= scheduler->nb_jobs || !scheduler->jobs[job].active) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    j = &scheduler->jobs[job];
+    elapsed = _modbus_time_us() - j->stats_start;
+
+    stats->requested_rate = 1000000.0 / j->period;
+    stats->achieved_rate = (elapsed == 0) ? 0 :
+        (j->polls - j->failures) * 1000000.0 / elapsed;
+    stats->polls = j->polls;
+    stats->failures = j->failures;
+    stats->skipped = j->skipped;
+    stats->backoff_ms = scheduler->slaves[j->slave].backoff_ms;
+
+    return 0;
+}
+
+int modbus_scheduler_reset_stats(modbus_scheduler_t *scheduler)
+{
+    uint64_t now;
+    int i;
+
+    if (scheduler == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    now = _modbus_time_us();
+    for (i = 0; i < scheduler->nb_jobs; i++) {
+        scheduler->jobs[i].stats_start = now;
+        scheduler->jobs[i].polls = 0;
+        scheduler->jobs[i].failures = 0;
+        scheduler->jobs[i].skipped = 0;
+    }
+
+    return 0;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright © 2001-2010 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#ifndef MODBUS_SCHEDULER_H
+#define MODBUS_SCHEDULER_H
+
+#include "modbus.h"
+
+MODBUS_BEGIN_DECLS
+
+typedef struct _modbus_scheduler modbus_scheduler_t;
+
+/* Called after each poll of a job with the number of values read or -1 with
+   errno set */
+typedef void (*modbus_scheduler_callback_t)(modbus_scheduler_t *scheduler,
+                                            int job, int rc, void *user_data);
+
+typedef struct {
+    /* Polls per second asked by the period of the job and successful polls
+       per second since the job was added or the stats reset */
+    double requested_rate;
+    double achieved_rate;
+    uint64_t polls;
+    uint64_t failures;
+    /* Polls not sent because the slave was backed off */
+    uint64_t skipped;
+    /* Current backoff of the slave, 0 while it answers */
+    uint32_t backoff_ms;
+} modbus_scheduler_stats_t;
+
+MODBUS_API modbus_scheduler_t* modbus_scheduler_new(modbus_t *ctx);
+MODBUS_API void modbus_scheduler_free(modbus_scheduler_t *scheduler);
+
+MODBUS_API int modbus_scheduler_add(modbus_scheduler_t *scheduler, int slave,
+                                    int function, int addr, int nb, void *dest,
+                                    uint32_t period_ms,
+                                    modbus_scheduler_callback_t callback,
+                                    void *user_data);
+MODBUS_API int modbus_scheduler_remove(modbus_scheduler_t *scheduler, int job);
+
+MODBUS_API int modbus_scheduler_set_backoff(modbus_scheduler_t *scheduler,
+                                            uint32_t min_ms, uint32_t max_ms);
+
+MODBUS_API int modbus_scheduler_run(modbus_scheduler_t *scheduler, int timeout_ms);
+
+MODBUS_API int modbus_scheduler_get_stats(modbus_scheduler_t *scheduler, int job,
+                                          modbus_scheduler_stats_t *stats);
+MODBUS_API int modbus_scheduler_reset_stats(modbus_scheduler_t *scheduler);
+
+MODBUS_END_DECLS
+
+#endif /* MODBUS_SCHEDULER_H */
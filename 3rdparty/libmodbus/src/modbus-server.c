@@ -0,0 +1,618 @@
+/*
+ * Copyright © 2001-2011 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <config.h>
+
+#include "modbus-private.h"
+#include "modbus-tcp.h"
+#include "modbus-tcp-private.h"
+#include "modbus-server.h"
+
+#if !defined(_WIN32)
+
+#if HAVE_SYS_EPOLL_H && HAVE_SYS_EVENTFD_H
+# include <unistd.h>
+# include <pthread.h>
+# include <sys/socket.h>
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+# include <netinet/in.h>
+# include <netinet/tcp.h>
+# include <arpa/inet.h>
+#endif
+
+/* A server answers many Modbus TCP masters from a few worker threads. Each
+ * worker waits on its own edge-triggered epoll instance for its listening
+ * socket (bound to the same port with SO_REUSEPORT, so the kernel spreads the
+ * connections over the workers) and for the connections it accepted. A
+ * connection only holds its socket and the bytes of the frame being
+ * received; the complete frames are answered by modbus_reply() with the
+ * context of the worker, from the mapping shared by the workers. */
+
+#define _MODBUS_SERVER_MAX_EVENTS 256
+/* Length of the MBAP header, unit identifier included */
+#define _MODBUS_SERVER_MBAP_LENGTH 7
+
+#if HAVE_SYS_EPOLL_H && HAVE_SYS_EVENTFD_H
+
+struct _modbus_server_connection {
+    int s;
+    int length;
+    uint8_t buf[MODBUS_TCP_MAX_ADU_LENGTH];
+    /* Connections of the worker, closed when the server stops */
+    struct _modbus_server_connection *prev;
+    struct _modbus_server_connection *next;
+};
+
+struct _modbus_server_worker {
+    modbus_server_t *server;
+    pthread_t thread;
+    int started;
+    /* Replies on the socket of the connection being served */
+    modbus_t *ctx;
+    int epfd;
+    struct _modbus_server_connection *connection_list;
+    /* Own listening socket, or the one of the first worker without
+       SO_REUSEPORT */
+    int listen_socket;
+    int own_socket;
+    /* Written by the worker only */
+    uint64_t connections;
+    uint64_t requests;
+    uint32_t clients;
+};
+
+struct _modbus_server {
+    char *ip_address;
+    int port;
+    modbus_mapping_t *mb_mapping;
+    /* The reads of the mapping are served in parallel, the writes alone */
+    pthread_rwlock_t lock;
+    /* Readable once the workers have to stop */
+    int stop_fd;
+    struct _modbus_server_worker *workers;
+    int nb_workers;
+    /* Counters of the workers already stopped */
+    uint64_t connections;
+    uint64_t requests;
+};
+
+/* The mapping isn't copied, it is shared by the workers from
+   modbus_server_start() to modbus_server_stop() */
+modbus_server_t* modbus_server_new(const char *ip_address, int port,
+                                   modbus_mapping_t *mb_mapping)
+{
+    modbus_server_t *server;
+
+    if (mb_mapping == NULL || port < 0 || port > 65535) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    server = (modbus_server_t *)malloc(sizeof(modbus_server_t));
+    if (server == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    server->ip_address = NULL;
+    if (ip_address != NULL) {
+        server->ip_address = strdup(ip_address);
+        if (server->ip_address == NULL) {
+            free(server);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+    server->port = port;
+    server->mb_mapping = mb_mapping;
+    server->stop_fd = -1;
+    server->workers = NULL;
+    server->nb_workers = 0;
+    server->connections = 0;
+    server->requests = 0;
+    pthread_rwlock_init(&server->lock, NULL);
+
+    return server;
+}
+
+/* Stops the server if running, the mapping is left to the caller */
+void modbus_server_free(modbus_server_t *server)
+{
+    if (server == NULL)
+        return;
+
+    modbus_server_stop(server);
+    pthread_rwlock_destroy(&server->lock);
+    free(server->ip_address);
+    free(server);
+}
+
+static int add_event(int epfd, int s, uint32_t events, void *ptr)
+{
+    struct epoll_event event;
+
+    event.events = events;
+    event.data.ptr = ptr;
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, s, &event);
+}
+
+/* Returns a non-blocking socket listening on the address of the context,
+   sharing its port with the other workers if reuse_port is TRUE */
+static int listen_socket(modbus_t *ctx, int reuse_port)
+{
+    modbus_tcp_t *ctx_tcp = ctx->backend_data;
+    struct sockaddr_in addr;
+    int enable = 1;
+    int s;
+
+    s = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+               IPPROTO_TCP);
+    if (s == -1) {
+        return -1;
+    }
+
+    if (setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) == -1) {
+        close(s);
+        return -1;
+    }
+#if HAVE_DECL_SO_REUSEPORT
+    if (reuse_port &&
+        setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == -1) {
+        close(s);
+        return -1;
+    }
+#else
+    if (reuse_port) {
+        close(s);
+        errno = ENOTSUP;
+        return -1;
+    }
+#endif
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(ctx_tcp->port);
+    if (ctx_tcp->ip[0] == '0') {
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    } else {
+        addr.sin_addr.s_addr = inet_addr(ctx_tcp->ip);
+    }
+    if (bind(s, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        listen(s, SOMAXCONN) == -1) {
+        close(s);
+        return -1;
+    }
+
+    return s;
+}
+
+static void close_connection(struct _modbus_server_worker *worker,
+                             struct _modbus_server_connection *connection)
+{
+    if (connection->prev != NULL) {
+        connection->prev->next = connection->next;
+    } else {
+        worker->connection_list = connection->next;
+    }
+    if (connection->next != NULL)
+        connection->next->prev = connection->prev;
+
+    /* Removed from the epoll instance by the close */
+    close(connection->s);
+    free(connection);
+    worker->clients--;
+}
+
+/* Accepts the pending connections, another worker may have taken them when
+   the listening socket is shared */
+static void accept_connections(struct _modbus_server_worker *worker)
+{
+    for (;;) {
+        struct _modbus_server_connection *connection;
+        int enable = 1;
+        int s;
+
+        s = accept4(worker->listen_socket, NULL, NULL,
+                    SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (s == -1) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            /* EAGAIN once done, or out of descriptors */
+            if (errno != EAGAIN && errno != EWOULDBLOCK && worker->ctx->debug) {
+                fprintf(stderr, "ERROR accept: %s\n", strerror(errno));
+            }
+            return;
+        }
+
+        /* The responses are sent at once */
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        connection = (struct _modbus_server_connection *)malloc(
+            sizeof(struct _modbus_server_connection));
+        if (connection == NULL) {
+            close(s);
+            continue;
+        }
+        connection->s = s;
+        connection->length = 0;
+        if (add_event(worker->epfd, s, EPOLLIN | EPOLLRDHUP | EPOLLET,
+                      connection) == -1) {
+            close(s);
+            free(connection);
+            continue;
+        }
+        connection->prev = NULL;
+        connection->next = worker->connection_list;
+        if (connection->next != NULL)
+            connection->next->prev = connection;
+        worker->connection_list = connection;
+        worker->connections++;
+        worker->clients++;
+    }
+}
+
+static int is_read(int function)
+{
+    return function == MODBUS_FC_READ_COILS ||
+        function == MODBUS_FC_READ_DISCRETE_INPUTS ||
+        function == MODBUS_FC_READ_HOLDING_REGISTERS ||
+        function == MODBUS_FC_READ_INPUT_REGISTERS ||
+        function == MODBUS_FC_REPORT_SLAVE_ID;
+}
+
+/* Answers the complete frames of the buffer of the connection. Returns -1 if
+   the stream isn't Modbus TCP or the response can't be sent. */
+static int reply_frames(struct _modbus_server_worker *worker,
+                        struct _modbus_server_connection *connection)
+{
+    modbus_server_t *server = worker->server;
+    uint8_t *buf = connection->buf;
+    int offset = 0;
+
+    while (connection->length - offset >= _MODBUS_SERVER_MBAP_LENGTH + 1) {
+        const uint8_t *frame = buf + offset;
+        int frame_length = 6 + ((frame[4] << 8) | frame[5]);
+        int rc;
+
+        /* Protocol identifier and length */
+        if (frame[2] != 0 || frame[3] != 0 ||
+            frame_length <= _MODBUS_SERVER_MBAP_LENGTH ||
+            frame_length > MODBUS_TCP_MAX_ADU_LENGTH) {
+            return -1;
+        }
+        if (connection->length - offset < frame_length)
+            break;
+
+        modbus_set_socket(worker->ctx, connection->s);
+        if (is_read(frame[_MODBUS_SERVER_MBAP_LENGTH])) {
+            pthread_rwlock_rdlock(&server->lock);
+        } else {
+            pthread_rwlock_wrlock(&server->lock);
+        }
+        rc = modbus_reply(worker->ctx, frame, frame_length, server->mb_mapping);
+        pthread_rwlock_unlock(&server->lock);
+        if (rc == -1) {
+            /* Socket buffer full of responses not read by the master */
+            return -1;
+        }
+
+        worker->requests++;
+        offset += frame_length;
+    }
+
+    /* Keeps the start of the next frame */
+    if (offset > 0) {
+        connection->length -= offset;
+        memmove(buf, buf + offset, connection->length);
+    }
+
+    return 0;
+}
+
+/* Reads the socket until it is drained as the epoll instance is edge
+   triggered */
+static void read_connection(struct _modbus_server_worker *worker,
+                            struct _modbus_server_connection *connection)
+{
+    for (;;) {
+        ssize_t rc = recv(connection->s, connection->buf + connection->length,
+                          sizeof(connection->buf) - connection->length, 0);
+
+        if (rc > 0) {
+            connection->length += rc;
+            if (reply_frames(worker, connection) == -1) {
+                close_connection(worker, connection);
+                return;
+            }
+        } else if (rc == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        } else if (rc == -1 && errno == EINTR) {
+            continue;
+        } else {
+            /* Closed by the master or in error */
+            close_connection(worker, connection);
+            return;
+        }
+    }
+}
+
+static void *worker_run(void *arg)
+{
+    struct _modbus_server_worker *worker = arg;
+    modbus_server_t *server = worker->server;
+    struct epoll_event events[_MODBUS_SERVER_MAX_EVENTS];
+
+    for (;;) {
+        int nb_events = epoll_wait(worker->epfd, events,
+                                   _MODBUS_SERVER_MAX_EVENTS, -1);
+        int i;
+
+        if (nb_events == -1) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (i = 0; i < nb_events; i++) {
+            void *ptr = events[i].data.ptr;
+
+            if (ptr == &server->stop_fd) {
+                return NULL;
+            } else if (ptr == &worker->listen_socket) {
+                accept_connections(worker);
+            } else {
+                read_connection(worker, ptr);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* Closes the resources of the workers [0, nb_workers) */
+static void free_workers(modbus_server_t *server, int nb_workers)
+{
+    int i;
+
+    for (i = 0; i < nb_workers; i++) {
+        struct _modbus_server_worker *worker = &server->workers[i];
+
+        while (worker->connection_list != NULL)
+            close_connection(worker, worker->connection_list);
+        if (worker->epfd != -1)
+            close(worker->epfd);
+        if (worker->own_socket)
+            close(worker->listen_socket);
+        modbus_free(worker->ctx);
+    }
+}
+
+static int init_worker(modbus_server_t *server, int i)
+{
+    struct _modbus_server_worker *worker = &server->workers[i];
+
+    worker->server = server;
+    worker->started = FALSE;
+    worker->connections = 0;
+    worker->requests = 0;
+    worker->clients = 0;
+    worker->epfd = -1;
+    worker->connection_list = NULL;
+    worker->own_socket = FALSE;
+    worker->ctx = modbus_new_tcp(server->ip_address, server->port);
+    if (worker->ctx == NULL) {
+        return -1;
+    }
+    /* modbus_reply() waits for the response timeout before flushing the
+       connection after an invalid request, the other masters of the worker
+       would wait as long */
+    modbus_set_response_timeout(worker->ctx, 0, 1);
+
+    worker->listen_socket = listen_socket(worker->ctx, server->nb_workers > 1);
+    if (worker->listen_socket != -1) {
+        worker->own_socket = TRUE;
+    } else if (i > 0) {
+        /* Without SO_REUSEPORT, every worker waits on the first socket */
+        worker->listen_socket = server->workers[0].listen_socket;
+    } else if (server->nb_workers > 1) {
+        worker->listen_socket = listen_socket(worker->ctx, FALSE);
+        if (worker->listen_socket == -1) {
+            return -1;
+        }
+        worker->own_socket = TRUE;
+    } else {
+        return -1;
+    }
+
+    worker->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (worker->epfd == -1 ||
+        add_event(worker->epfd, worker->listen_socket, EPOLLIN,
+                  &worker->listen_socket) == -1 ||
+        add_event(worker->epfd, server->stop_fd, EPOLLIN,
+                  &server->stop_fd) == -1) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Starts nb_workers threads, each with its own listening socket and epoll
+   instance */
+int modbus_server_start(modbus_server_t *server, int nb_workers)
+{
+    int saved_errno;
+    int i;
+
+    if (server == NULL || nb_workers < 1) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (server->workers != NULL) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    server->workers = (struct _modbus_server_worker *)calloc(
+        nb_workers, sizeof(struct _modbus_server_worker));
+    if (server->workers == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    server->nb_workers = nb_workers;
+
+    server->stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (server->stop_fd == -1) {
+        goto error;
+    }
+
+    for (i = 0; i < nb_workers; i++) {
+        int rc = init_worker(server, i);
+
+        if (rc == -1) {
+            saved_errno = errno;
+            free_workers(server, i + 1);
+            errno = saved_errno;
+            goto error;
+        }
+    }
+
+    for (i = 0; i < nb_workers; i++) {
+        errno = pthread_create(&server->workers[i].thread, NULL, worker_run,
+                               &server->workers[i]);
+        if (errno != 0) {
+            saved_errno = errno;
+            modbus_server_stop(server);
+            errno = saved_errno;
+            return -1;
+        }
+        server->workers[i].started = TRUE;
+    }
+
+    return 0;
+
+error:
+    saved_errno = errno;
+    if (server->stop_fd != -1)
+        close(server->stop_fd);
+    server->stop_fd = -1;
+    free(server->workers);
+    server->workers = NULL;
+    server->nb_workers = 0;
+    errno = saved_errno;
+    return -1;
+}
+
+/* Waits for the workers to end and closes the connections, the masters see
+   the end of their stream */
+int modbus_server_stop(modbus_server_t *server)
+{
+    uint64_t value = 1;
+    int i;
+
+    if (server == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (server->workers == NULL) {
+        return 0;
+    }
+
+    /* Level triggered, seen by every worker */
+    if (write(server->stop_fd, &value, sizeof(value)) != sizeof(value)) {
+        return -1;
+    }
+
+    for (i = 0; i < server->nb_workers; i++) {
+        if (server->workers[i].started)
+            pthread_join(server->workers[i].thread, NULL);
+        server->connections += server->workers[i].connections;
+        server->requests += server->workers[i].requests;
+    }
+
+    free_workers(server, server->nb_workers);
+    close(server->stop_fd);
+    server->stop_fd = -1;
+    free(server->workers);
+    server->workers = NULL;
+    server->nb_workers = 0;
+
+    return 0;
+}
+
+/* The counters add up the runs of the server. Those of running workers are
+   read without synchronization, the values are exact once it is stopped. */
+int modbus_server_get_stats(modbus_server_t *server,
+                            modbus_server_stats_t *stats)
+{
+    int i;
+
+    if (server == NULL || stats == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(stats, 0, sizeof(modbus_server_stats_t));
+    stats->connections = server->connections;
+    stats->requests = server->requests;
+    for (i = 0; i < server->nb_workers; i++) {
+        stats->connections += server->workers[i].connections;
+        stats->requests += server->workers[i].requests;
+        stats->clients += server->workers[i].clients;
+    }
+
+    return 0;
+}
+
+#else
+
+modbus_server_t* modbus_server_new(const char *ip_address, int port,
+                                   modbus_mapping_t *mb_mapping)
+{
+    (void)ip_address;
+    (void)port;
+    (void)mb_mapping;
+    errno = ENOTSUP;
+    return NULL;
+}
+
+void modbus_server_free(modbus_server_t *server)
+{
+    (void)server;
+}
+
+int modbus_server_start(modbus_server_t *server, int nb_workers)
+{
+    (void)server;
+    (void)nb_workers;
+    errno = ENOTSUP;
+    return -1;
+}
+
+int modbus_server_stop(modbus_server_t *server)
+{
+    (void)server;
+    errno = ENOTSUP;
+    return -1;
+}
+
+int modbus_server_get_stats(modbus_server_t *server,
+                            modbus_server_stats_t *stats)
+{
+    (void)server;
+    (void)stats;
+    errno = ENOTSUP;
+    return -1;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * Copyright © 2001-2010 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#ifndef MODBUS_SERVER_H
+#define MODBUS_SERVER_H
+
+#include "modbus.h"
+
+MODBUS_BEGIN_DECLS
+
+#if !defined(_WIN32)
+
+typedef struct _modbus_server modbus_server_t;
+
+typedef struct {
+    /* Connections accepted and requests answered since the start */
+    uint64_t connections;
+    uint64_t requests;
+    /* Masters connected */
+    uint32_t clients;
+} modbus_server_stats_t;
+
+MODBUS_API modbus_server_t* modbus_server_new(const char *ip_address, int port,
+                                              modbus_mapping_t *mb_mapping);
+MODBUS_API void modbus_server_free(modbus_server_t *server);
+
+MODBUS_API int modbus_server_start(modbus_server_t *server, int nb_workers);
+MODBUS_API int modbus_server_stop(modbus_server_t *server);
+
+MODBUS_API int modbus_server_get_stats(modbus_server_t *server,
+                                       modbus_server_stats_t *stats);
+
+#endif
+
+MODBUS_END_DECLS
+
+#endif /* MODBUS_SERVER_H */
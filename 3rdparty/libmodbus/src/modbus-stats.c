@@ -0,0 +1,256 @@
+/*
+ * Copyright © 2001-2011 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#ifndef _MSC_VER
+#  include <stdint.h>
+#else
+#  include "stdint.h"
+#endif
+
+#include <config.h>
+
+#include "modbus-private.h"
+
+/* Log-linear buckets: latencies below 8 us have their own bucket, above each
+   power of two is split in 8 buckets so a bucket is never wider than 12.5 %
+   of its values. The last bucket holds everything from 2^32 us (71 min). */
+#define LATENCY_SUB_BUCKET_BITS 3
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_MAX_MSB 31
+
+static int msb_index(uint64_t value)
+{
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(value);
+#else
+    int msb = 0;
+
+    while (value >>= 1)
+        msb++;
+    return msb;
+#endif
+}
+
+static int latency_bucket(uint64_t us)
+{
+    int msb;
+
+    if (us < LATENCY_SUB_BUCKETS)
+        return (int)us;
+
+    msb = msb_index(us);
+    if (msb > LATENCY_MAX_MSB)
+        return MODBUS_LATENCY_BUCKETS - 1;
+
+    return (msb - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS +
+        (int)((us >> (msb - LATENCY_SUB_BUCKET_BITS)) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+/* Largest value stored in the bucket */
+static uint64_t latency_bucket_upper(int bucket)
+{
+    int shift;
+    uint64_t lower;
+
+    if (bucket < LATENCY_SUB_BUCKETS)
+        return bucket;
+    if (bucket == MODBUS_LATENCY_BUCKETS - 1)
+        return UINT64_MAX;
+
+    shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    lower = (uint64_t)(LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS) << shift;
+
+    return lower + ((uint64_t)1 << shift) - 1;
+}
+
+void _modbus_stats_latency(modbus_latency_t *latency, uint64_t us)
+{
+    if (latency->count == 0 || us < latency->min)
+        latency->min = us;
+    if (us > latency->max)
+        latency->max = us;
+    latency->count++;
+    latency->sum += us;
+    latency->buckets[latency_bucket(us)]++;
+}
+
+/* The response timeout of a slave is learned from the first byte latency of
+   its confirmations as the retransmission timeout of TCP (RFC 6298): the
+   smoothed latency plus four times its mean deviation, doubled after each
+   timeout in a row and bounded by the floor and the ceiling set by
+   modbus_set_adaptive_timeout. */
+#define RTT_K 4
+#define RTT_MAX_BACKOFF 16
+
+void _modbus_rtt_sample(modbus_t *ctx, int slave, uint64_t us)
+{
+    struct _modbus_rtt *rtt;
+    uint32_t r = (us > UINT32_MAX) ? UINT32_MAX : (uint32_t)us;
+
+    if (slave < 0 || slave > 255)
+        return;
+
+    rtt = &ctx->rtt[slave];
+    if (!rtt->valid) {
+        rtt->srtt = r;
+        rtt->rttvar = r / 2;
+        rtt->valid = TRUE;
+    } else {
+        uint32_t delta = (rtt->srtt > r) ? rtt->srtt - r : r - rtt->srtt;
+
+        /* Gains of 1/4 and 1/8 */
+        rtt->rttvar = (uint32_t)((3 * (uint64_t)rtt->rttvar + delta) / 4);
+        rtt->srtt = (uint32_t)((7 * (uint64_t)rtt->srtt + r) / 8);
+    }
+    rtt->backoff = 0;
+}
+
+void _modbus_rtt_timeout(modbus_t *ctx, int slave)
+{
+    if (slave < 0 || slave > 255)
+        return;
+
+    if (ctx->rtt[slave].valid && ctx->rtt[slave].backoff < RTT_MAX_BACKOFF) {
+        ctx->rtt[slave].backoff++;
+    }
+}
+
+/* Returns the time to wait for the first byte of a confirmation of the
+   slave in microseconds, the response timeout of the context until the
+   adaptive timeout is enabled and the slave has answered once */
+uint64_t _modbus_response_timeout(modbus_t *ctx, int slave)
+{
+    struct _modbus_rtt *rtt;
+    uint64_t rto;
+
+    if (ctx->rto_ceiling == 0 || slave < 0 || slave > 255 ||
+        !ctx->rtt[slave].valid) {
+        return (uint64_t)ctx->response_timeout.tv_sec * 1000000 +
+            ctx->response_timeout.tv_usec;
+    }
+
+    rtt = &ctx->rtt[slave];
+    rto = (uint64_t)rtt->srtt + RTT_K * (uint64_t)rtt->rttvar;
+    if (rto < ctx->rto_floor)
+        rto = ctx->rto_floor;
+    rto <<= rtt->backoff;
+    if (rto > ctx->rto_ceiling)
+        rto = ctx->rto_ceiling;
+
+    return rto;
+}
+
+int modbus_get_stats(modbus_t *ctx, modbus_stats_t *stats)
+{
+    if (ctx == NULL || stats == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memcpy(stats, &ctx->stats, sizeof(modbus_stats_t));
+    return 0;
+}
+
+int modbus_reset_stats(modbus_t *ctx)
+{
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(&ctx->stats, 0, sizeof(modbus_stats_t));
+    return 0;
+}
+
+/* Returns an upper bound of the given percentile (0 to 100) of the latencies
+   in microseconds, the error is at most 12.5 % */
+uint64_t modbus_latency_percentile(const modbus_latency_t *latency,
+                                   double percentile)
+{
+    uint64_t rank;
+    uint64_t total = 0;
+    int i;
+
+    if (latency == NULL || latency->count == 0)
+        return 0;
+
+    if (percentile <= 0)
+        return latency->min;
+    if (percentile >= 100)
+        return latency->max;
+
+    /* Rank of the value, rounded up and at least the first one */
+    rank = (uint64_t)(percentile * latency->count / 100.0);
+    if (rank * 100.0 < percentile * latency->count || rank == 0)
+        rank++;
+
+    for (i = 0; i < MODBUS_LATENCY_BUCKETS; i++) {
+        total += latency->buckets[i];
+        if (total >= rank) {
+            uint64_t upper = latency_bucket_upper(i);
+
+            /* No bound is better than the largest value seen */
+            return (upper < latency->max) ? upper : latency->max;
+        }
+    }
+
+    return latency->max;
+}
+
+/* Reads one holding register of the slave nb_samples times and records the
+   time from the end of each request to the first byte and to the end of its
+   response. An exception response is a valid sample, only the requests left
+   unanswered (or answered with a corrupted frame) are not counted. */
+int modbus_measure_turnaround(modbus_t *ctx, int addr, int nb_samples,
+                              modbus_latency_t *first_byte,
+                              modbus_latency_t *response)
+{
+    uint16_t value;
+    int nb_measured = 0;
+    int i;
+
+    if (ctx == NULL || nb_samples <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (first_byte != NULL)
+        memset(first_byte, 0, sizeof(modbus_latency_t));
+    if (response != NULL)
+        memset(response, 0, sizeof(modbus_latency_t));
+
+    for (i = 0; i < nb_samples; i++) {
+        uint64_t now;
+        int rc;
+
+        ctx->stats_sent = 0;
+        ctx->stats_first_byte = 0;
+        rc = modbus_read_registers(ctx, addr, 1, &value);
+        now = _modbus_time_us();
+        if (rc != 1 && (errno < EMBXILFUN || errno > EMBXGTAR))
+            continue;
+        if (ctx->stats_sent == 0 || now < ctx->stats_sent)
+            continue;
+
+        if (first_byte != NULL && ctx->stats_first_byte >= ctx->stats_sent) {
+            _modbus_stats_latency(first_byte,
+                                  ctx->stats_first_byte - ctx->stats_sent);
+        }
+        if (response != NULL) {
+            _modbus_stats_latency(response, now - ctx->stats_sent);
+        }
+        nb_measured++;
+    }
+
+    /* errno is left as set by the last request */
+    if (nb_measured == 0)
+        return -1;
+
+    return nb_measured;
+}
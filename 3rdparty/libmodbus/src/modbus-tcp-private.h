@@ -25,6 +25,8 @@ typedef struct _modbus_tcp {
     int port;
     /* IP address */
     char ip[16];
+    /* Slot of the context in its ring (modbus_new_tcp_uring) or NULL */
+    struct _modbus_uring_slot *uring;
 } modbus_tcp_t;
 
 #define _MODBUS_TCP_PI_NODE_LENGTH    1025
@@ -57,6 +57,7 @@
 
 #include "modbus-tcp.h"
 #include "modbus-tcp-private.h"
+#include "modbus-uring-private.h"
 
 #ifdef OS_WIN32
 static int _modbus_tcp_init_win32(void)
@@ -281,15 +282,26 @@ static int _connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen,
 #else
     if (rc == -1 && errno == EINPROGRESS) {
 #endif
-        fd_set wset;
         int optval;
         socklen_t optlen = sizeof(optval);
+#ifdef OS_WIN32
+        fd_set wset;
         struct timeval tv = *ro_tv;
 
         /* Wait to be available in writing */
         FD_ZERO(&wset);
         FD_SET(sockfd, &wset);
         rc = select(sockfd + 1, NULL, &wset, NULL, &tv);
+#else
+        struct pollfd pfd;
+
+        /* Wait to be available in writing (poll() isn't limited by the value
+           of the descriptor like select()) */
+        pfd.fd = sockfd;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        rc = poll(&pfd, 1, ro_tv->tv_sec * 1000 + (ro_tv->tv_usec + 999) / 1000);
+#endif
         if (rc <= 0) {
             /* Timeout or fail */
             return -1;
@@ -307,14 +319,13 @@ static int _connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen,
     return rc;
 }
 
-/* Establishes a modbus TCP connection with a Modbus server. */
-static int _modbus_tcp_connect(modbus_t *ctx)
+/* Returns a socket with the options of the context, ready to connect to the
+   address stored in addr */
+static int _modbus_tcp_socket(modbus_t *ctx, struct sockaddr_in *addr)
 {
-    int rc;
-    /* Specialized version of sockaddr for Internet socket address (same size) */
-    struct sockaddr_in addr;
     modbus_tcp_t *ctx_tcp = ctx->backend_data;
     int flags = SOCK_STREAM;
+    int s;
 
 #ifdef OS_WIN32
     if (_modbus_tcp_init_win32() == -1) {
@@ -330,15 +341,13 @@ static int _modbus_tcp_connect(modbus_t *ctx)
     flags |= SOCK_NONBLOCK;
 #endif
 
-    ctx->s = socket(PF_INET, flags, 0);
-    if (ctx->s == -1) {
+    s = socket(PF_INET, flags, 0);
+    if (s == -1) {
         return -1;
     }
 
-    rc = _modbus_tcp_set_ipv4_options(ctx->s);
-    if (rc == -1) {
-        close(ctx->s);
-        ctx->s = -1;
+    if (_modbus_tcp_set_ipv4_options(s) == -1) {
+        close(s);
         return -1;
     }
 
@@ -346,9 +355,25 @@ static int _modbus_tcp_connect(modbus_t *ctx)
         printf("Connecting to %s:%d\n", ctx_tcp->ip, ctx_tcp->port);
     }
 
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(ctx_tcp->port);
-    addr.sin_addr.s_addr = inet_addr(ctx_tcp->ip);
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(ctx_tcp->port);
+    addr->sin_addr.s_addr = inet_addr(ctx_tcp->ip);
+
+    return s;
+}
+
+/* Establishes a modbus TCP connection with a Modbus server. */
+static int _modbus_tcp_connect(modbus_t *ctx)
+{
+    int rc;
+    /* Specialized version of sockaddr for Internet socket address (same size) */
+    struct sockaddr_in addr;
+
+    ctx->s = _modbus_tcp_socket(ctx, &addr);
+    if (ctx->s == -1) {
+        return -1;
+    }
+
     rc = _connect(ctx->s, (struct sockaddr *)&addr, sizeof(addr), &ctx->response_timeout);
     if (rc == -1) {
         close(ctx->s);
@@ -712,28 +737,179 @@ int modbus_tcp_pi_accept(modbus_t *ctx, int *s)
     return ctx->s;
 }
 
-static int _modbus_tcp_select(modbus_t *ctx, fd_set *rset, struct timeval *tv, int length_to_read)
+#if !defined(_WIN32)
+static void _connect_done(modbus_t *ctx, modbus_tcp_connect_result_t *result,
+                          int error, uint64_t start)
 {
-    int s_rc;
-    while ((s_rc = select(ctx->s+1, rset, NULL, NULL, tv)) == -1) {
-        if (errno == EINTR) {
-            if (ctx->debug) {
-                fprintf(stderr, "A non blocked signal was caught\n");
-            }
-            /* Necessary after an error */
-            FD_ZERO(rset);
-            FD_SET(ctx->s, rset);
+    result->latency_us = (uint32_t)(_modbus_time_us() - start);
+    result->error = error;
+    if (error == 0) {
+        result->rc = 0;
+    } else {
+        result->rc = -1;
+        close(ctx->s);
+        ctx->s = -1;
+    }
+}
+
+/* Starts the connections of all the contexts then waits for them together,
+   each one within the response timeout of its context. Returns the number of
+   contexts connected, the outcome of each one is stored in results. */
+int modbus_tcp_connect_many(modbus_t **ctxs, int nb,
+                            modbus_tcp_connect_result_t *results)
+{
+    struct pollfd *fds;
+    uint64_t start;
+    int nb_pending = 0;
+    int nb_connected = 0;
+    int i;
+
+    if (ctxs == NULL || results == NULL || nb < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (nb == 0) {
+        return 0;
+    }
+
+    fds = (struct pollfd *)malloc(nb * sizeof(struct pollfd));
+    if (fds == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    start = _modbus_time_us();
+    for (i = 0; i < nb; i++) {
+        modbus_t *ctx = ctxs[i];
+        struct sockaddr_in addr;
+        int rc;
+
+        fds[i].fd = -1;
+        fds[i].events = POLLOUT;
+        fds[i].revents = 0;
+        results[i].rc = -1;
+        results[i].latency_us = 0;
+
+        /* The TCP PI contexts resolve their node, which blocks */
+        if (ctx == NULL || ctx->backend->connect != _modbus_tcp_connect) {
+            results[i].error = EINVAL;
+            continue;
+        }
+
+        /* Reconnection of a connected context */
+        _modbus_tcp_close(ctx);
+        ctx->s = _modbus_tcp_socket(ctx, &addr);
+        if (ctx->s == -1) {
+            results[i].error = errno;
+            continue;
+        }
+
+        rc = connect(ctx->s, (struct sockaddr *)&addr, sizeof(addr));
+        if (rc == -1 && errno == EINPROGRESS) {
+            fds[i].fd = ctx->s;
+            nb_pending++;
         } else {
-            return -1;
+            _connect_done(ctx, &results[i], rc == 0 ? 0 : errno, start);
+            nb_connected += rc == 0;
+        }
+    }
+
+    while (nb_pending > 0) {
+        uint64_t now = _modbus_time_us();
+        uint64_t next_deadline = UINT64_MAX;
+        int timeout_ms;
+        int rc;
+
+        /* Gives up the connections past the response timeout of their
+           context and waits until the closest deadline of the others */
+        for (i = 0; i < nb; i++) {
+            uint64_t deadline;
+
+            if (fds[i].fd == -1)
+                continue;
+            deadline = start + ctxs[i]->response_timeout.tv_sec * 1000000ULL +
+                ctxs[i]->response_timeout.tv_usec;
+            if (now >= deadline) {
+                fds[i].fd = -1;
+                nb_pending--;
+                _connect_done(ctxs[i], &results[i], ETIMEDOUT, start);
+            } else if (deadline < next_deadline) {
+                next_deadline = deadline;
+            }
+        }
+        if (nb_pending == 0)
+            break;
+
+        timeout_ms = (next_deadline - now + 999) / 1000;
+        rc = poll(fds, nb, timeout_ms);
+        if (rc == -1) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (i = 0; i < nb && rc > 0; i++) {
+            int optval;
+            socklen_t optlen = sizeof(optval);
+
+            if (fds[i].fd == -1 || fds[i].revents == 0)
+                continue;
+            rc--;
+
+            /* The connection is established if SO_ERROR is 0 */
+            if (getsockopt(fds[i].fd, SOL_SOCKET, SO_ERROR, (void *)&optval,
+                           &optlen) == -1) {
+                optval = errno;
+            } else if (optval == 0 && (fds[i].revents & (POLLERR | POLLHUP))) {
+                optval = ECONNREFUSED;
+            }
+            fds[i].fd = -1;
+            nb_pending--;
+            _connect_done(ctxs[i], &results[i], optval, start);
+            nb_connected += optval == 0;
         }
     }
 
+    /* Failure of poll() */
+    if (nb_pending > 0) {
+        int saved_errno = errno;
+
+        for (i = 0; i < nb; i++) {
+            if (fds[i].fd != -1)
+                _connect_done(ctxs[i], &results[i], saved_errno, start);
+        }
+    }
+
+    free(fds);
+
+    return nb_connected;
+}
+#endif
+
+static int _modbus_tcp_select(modbus_t *ctx, struct timeval *tv, int length_to_read)
+{
+#ifdef OS_WIN32
+    /* The Winsock fd_set is an array of sockets, its cost doesn't depend on
+       the value of the socket */
+    fd_set rset;
+    int s_rc;
+
+    FD_ZERO(&rset);
+    FD_SET(ctx->s, &rset);
+    s_rc = select(ctx->s+1, &rset, NULL, NULL, tv);
+    if (s_rc == -1) {
+        return -1;
+    }
+
     if (s_rc == 0) {
         errno = ETIMEDOUT;
         return -1;
     }
 
     return s_rc;
+#else
+    return _modbus_wait_readable(ctx, tv);
+#endif
 }
 
 static void _modbus_tcp_free(modbus_t *ctx) {
@@ -788,6 +964,46 @@ const modbus_backend_t _modbus_tcp_pi_backend = {
     _modbus_tcp_free
 };
 
+#if !defined(_WIN32)
+static int _modbus_tcp_uring_connect(modbus_t *ctx)
+{
+    if (_modbus_tcp_connect(ctx) == -1)
+        return -1;
+
+    _modbus_uring_connected(ctx);
+    return 0;
+}
+
+static void _modbus_tcp_uring_free(modbus_t *ctx)
+{
+    _modbus_uring_detach(ctx);
+    _modbus_tcp_free(ctx);
+}
+
+const modbus_backend_t _modbus_tcp_uring_backend = {
+    _MODBUS_BACKEND_TYPE_TCP,
+    _MODBUS_TCP_HEADER_LENGTH,
+    _MODBUS_TCP_CHECKSUM_LENGTH,
+    MODBUS_TCP_MAX_ADU_LENGTH,
+    _modbus_set_slave,
+    _modbus_tcp_build_request_basis,
+    _modbus_tcp_build_file_request_basis,
+    _modbus_tcp_build_response_basis,
+    _modbus_tcp_prepare_response_tid,
+    _modbus_tcp_send_msg_pre,
+    _modbus_uring_send,
+    _modbus_tcp_receive,
+    _modbus_uring_recv,
+    _modbus_tcp_check_integrity,
+    _modbus_tcp_pre_check_confirmation,
+    _modbus_tcp_uring_connect,
+    _modbus_uring_close,
+    _modbus_uring_flush,
+    _modbus_uring_select,
+    _modbus_tcp_uring_free
+};
+#endif
+
 modbus_t* modbus_new_tcp(const char *ip, int port)
 {
     modbus_t *ctx;
@@ -818,6 +1034,7 @@ modbus_t* modbus_new_tcp(const char *ip, int port)
 
     ctx->backend_data = (modbus_tcp_t *)malloc(sizeof(modbus_tcp_t));
     ctx_tcp = (modbus_tcp_t *)ctx->backend_data;
+    ctx_tcp->uring = NULL;
 
     if (ip != NULL) {
         dest_size = sizeof(char) * 16;
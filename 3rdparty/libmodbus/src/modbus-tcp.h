@@ -47,6 +47,20 @@ MODBUS_API modbus_t* modbus_new_tcp_pi(const char *node, const char *service);
 MODBUS_API int modbus_tcp_pi_listen(modbus_t *ctx, int nb_connection);
 MODBUS_API int modbus_tcp_pi_accept(modbus_t *ctx, int *s);
 
+#if !defined(_WIN32)
+typedef struct {
+    /* 0 if the context is connected, -1 otherwise */
+    int rc;
+    /* errno of the failure (ETIMEDOUT, ECONNREFUSED...) */
+    int error;
+    /* Time to connect or to fail */
+    uint32_t latency_us;
+} modbus_tcp_connect_result_t;
+
+MODBUS_API int modbus_tcp_connect_many(modbus_t **ctxs, int nb,
+                                       modbus_tcp_connect_result_t *results);
+#endif
+
 MODBUS_END_DECLS
 
 #endif /* MODBUS_TCP_H */
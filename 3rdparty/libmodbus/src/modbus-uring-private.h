@@ -0,0 +1,38 @@
+/*
+ * Copyright © 2001-2011 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#ifndef MODBUS_URING_PRIVATE_H
+#define MODBUS_URING_PRIVATE_H
+
+#include "modbus-uring.h"
+
+#if !defined(_WIN32)
+
+/* Buffers and operations of a context in its ring */
+struct _modbus_uring_slot;
+
+/* Backend of modbus_new_tcp_uring(), the framing of the TCP backend with the
+   I/O below */
+extern const modbus_backend_t _modbus_tcp_uring_backend;
+
+ssize_t _modbus_uring_send(modbus_t *ctx, const uint8_t *req, int req_length);
+ssize_t _modbus_uring_recv(modbus_t *ctx, uint8_t *rsp, int rsp_length);
+int _modbus_uring_select(modbus_t *ctx, struct timeval *tv, int length_to_read);
+int _modbus_uring_flush(modbus_t *ctx);
+void _modbus_uring_connected(modbus_t *ctx);
+void _modbus_uring_close(modbus_t *ctx);
+void _modbus_uring_detach(modbus_t *ctx);
+
+/* Used by the reactor to wait on the ring instead of the sockets */
+modbus_uring_t *_modbus_uring_ring(modbus_t *ctx);
+int _modbus_uring_readable(modbus_t *ctx);
+int _modbus_uring_fd(modbus_uring_t *ring);
+int _modbus_uring_wait(modbus_uring_t *ring, int timeout_ms);
+void _modbus_uring_reap(modbus_uring_t *ring);
+
+#endif
+
+#endif /* MODBUS_URING_PRIVATE_H */
@@ -0,0 +1,978 @@
+/*
+ * Copyright © 2001-2011 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <config.h>
+
+#include "modbus-private.h"
+#include "modbus-tcp.h"
+#include "modbus-tcp-private.h"
+#include "modbus-uring-private.h"
+
+#if !defined(_WIN32)
+
+#if HAVE_LINUX_IO_URING_H
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/socket.h>
+# include <sys/syscall.h>
+# include <sys/uio.h>
+# include <linux/io_uring.h>
+/* The waits with a timeout need Linux 5.11 */
+# if defined(__NR_io_uring_setup) && defined(IORING_ENTER_EXT_ARG)
+#  define _MODBUS_URING
+# endif
+#endif
+
+/* The I/O of the contexts of a ring go through io_uring, without liburing:
+ * a request is only queued in the submission ring by send(), with the read of
+ * its response, and both are submitted by the next wait on the ring. A single
+ * io_uring_enter() then submits the requests queued by all the contexts of
+ * the ring and reaps their responses, where the TCP backend needs a send(),
+ * a poll() and a recv() per transaction.
+ *
+ * Each context owns a slot of a buffer area registered with the ring, the
+ * responses are read there with IORING_OP_READ_FIXED. The requests are sent
+ * with IORING_OP_SEND for its MSG_NOSIGNAL flag, a write on a closed
+ * connection would raise SIGPIPE. */
+
+#ifdef _MODBUS_URING
+
+/* Bytes of the requests queued by a context before the completion of their
+   sending (pipelined requests included) */
+#define _MODBUS_URING_TX_LENGTH 2048
+#define _MODBUS_URING_SLOT_LENGTH (_MODBUS_URING_TX_LENGTH + _MODBUS_RX_BUFFER_LENGTH)
+#define _MODBUS_URING_MAX_CONTEXTS 8192
+
+/* Operation stored in the low bits of the user data, next to the slot */
+#define _MODBUS_URING_OP_READ   0
+#define _MODBUS_URING_OP_SEND   1
+#define _MODBUS_URING_OP_CANCEL 2
+#define _MODBUS_URING_OP_MASK   3
+
+struct _modbus_uring_slot {
+    modbus_uring_t *ring;
+    int in_use;
+    /* In the registered area */
+    uint8_t *tx;
+    uint8_t *rx;
+    /* Requests copied to tx, the bytes sent of them and the sending in
+       flight (of the bytes not sent yet, to keep their order) */
+    int tx_length;
+    int tx_sent;
+    int sending;
+    int send_s;
+    /* Read in flight and its socket */
+    int reading;
+    int read_s;
+    /* Bytes of the last read not consumed yet */
+    int rx_start;
+    int rx_length;
+    /* errno of a failed operation, end of the stream */
+    int error;
+    int eof;
+};
+
+struct _modbus_uring {
+    int fd;
+    /* Submission ring, its entries and the index of the next one */
+    void *sq_ptr;
+    size_t sq_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    /* Completion ring (mapped with the submission ring since Linux 5.4) */
+    void *cq_ptr;
+    size_t cq_size;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    /* Entries queued but not submitted yet */
+    unsigned nb_queued;
+    uint8_t *area;
+    size_t area_size;
+    struct _modbus_uring_slot *slots;
+    int nb_slots;
+    modbus_uring_stats_t stats;
+};
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                              unsigned flags, void *arg, size_t argsz)
+{
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                   arg, argsz);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg,
+                                 unsigned nr_args)
+{
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void unmap_rings(modbus_uring_t *ring)
+{
+    if (ring->sqes != NULL)
+        munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ptr != NULL && ring->cq_ptr != ring->sq_ptr)
+        munmap(ring->cq_ptr, ring->cq_size);
+    if (ring->sq_ptr != NULL)
+        munmap(ring->sq_ptr, ring->sq_size);
+}
+
+static int map_rings(modbus_uring_t *ring, struct io_uring_params *p)
+{
+    unsigned *sq_array;
+    unsigned i;
+
+    ring->sq_size = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+    ring->cq_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_size > ring->sq_size)
+            ring->sq_size = ring->cq_size;
+        ring->cq_size = ring->sq_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        ring->sq_ptr = NULL;
+        return -1;
+    }
+
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring->fd,
+                            IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            ring->cq_ptr = NULL;
+            return -1;
+        }
+    }
+
+    ring->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        return -1;
+    }
+
+    ring->sq_head = (unsigned *)((uint8_t *)ring->sq_ptr + p->sq_off.head);
+    ring->sq_tail = (unsigned *)((uint8_t *)ring->sq_ptr + p->sq_off.tail);
+    ring->sq_mask = *(unsigned *)((uint8_t *)ring->sq_ptr + p->sq_off.ring_mask);
+    ring->sq_entries = p->sq_entries;
+    ring->cq_head = (unsigned *)((uint8_t *)ring->cq_ptr + p->cq_off.head);
+    ring->cq_tail = (unsigned *)((uint8_t *)ring->cq_ptr + p->cq_off.tail);
+    ring->cq_mask = *(unsigned *)((uint8_t *)ring->cq_ptr + p->cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)((uint8_t *)ring->cq_ptr + p->cq_off.cqes);
+
+    /* The entry of each index of the submission ring never changes */
+    sq_array = (unsigned *)((uint8_t *)ring->sq_ptr + p->sq_off.array);
+    for (i = 0; i < p->sq_entries; i++) {
+        sq_array[i] = i;
+    }
+
+    return 0;
+}
+
+/* Each context has 2 operations in flight at most (a read and the sending of
+   its requests), and the cancellations when it is closed */
+modbus_uring_t* modbus_uring_new(int nb_contexts)
+{
+    modbus_uring_t *ring;
+    struct io_uring_params p;
+    struct iovec iov;
+    unsigned entries = 8;
+    int saved_errno;
+    int i;
+
+    if (nb_contexts < 1 || nb_contexts > _MODBUS_URING_MAX_CONTEXTS) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    ring = (modbus_uring_t *)calloc(1, sizeof(modbus_uring_t));
+    if (ring == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    while (entries < 2 * (unsigned)nb_contexts)
+        entries *= 2;
+
+    memset(&p, 0, sizeof(p));
+    ring->fd = sys_io_uring_setup(entries, &p);
+    if (ring->fd == -1) {
+        free(ring);
+        return NULL;
+    }
+    if (!(p.features & IORING_FEAT_EXT_ARG)) {
+        close(ring->fd);
+        free(ring);
+        errno = ENOTSUP;
+        return NULL;
+    }
+    if (map_rings(ring, &p) == -1) {
+        goto error;
+    }
+
+    ring->nb_slots = nb_contexts;
+    ring->slots = (struct _modbus_uring_slot *)calloc(
+        nb_contexts, sizeof(struct _modbus_uring_slot));
+    ring->area_size = (size_t)nb_contexts * _MODBUS_URING_SLOT_LENGTH;
+    ring->area = mmap(NULL, ring->area_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->area == MAP_FAILED) {
+        ring->area = NULL;
+    }
+    if (ring->slots == NULL || ring->area == NULL) {
+        errno = ENOMEM;
+        goto error;
+    }
+    for (i = 0; i < nb_contexts; i++) {
+        ring->slots[i].ring = ring;
+        ring->slots[i].tx = ring->area + (size_t)i * _MODBUS_URING_SLOT_LENGTH;
+        ring->slots[i].rx = ring->slots[i].tx + _MODBUS_URING_TX_LENGTH;
+    }
+
+    /* The whole area is the registered buffer 0. The pages are pinned and
+       charged to RLIMIT_MEMLOCK, the plain reads are used if refused. */
+    iov.iov_base = ring->area;
+    iov.iov_len = ring->area_size;
+    ring->stats.registered =
+        sys_io_uring_register(ring->fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0;
+
+    return ring;
+
+error:
+    saved_errno = errno;
+    unmap_rings(ring);
+    if (ring->area != NULL)
+        munmap(ring->area, ring->area_size);
+    close(ring->fd);
+    free(ring->slots);
+    free(ring);
+    errno = saved_errno;
+    return NULL;
+}
+
+/* The contexts of the ring must have been freed */
+void modbus_uring_free(modbus_uring_t *ring)
+{
+    if (ring == NULL)
+        return;
+
+    /* Unregisters the area and ends the operations in flight */
+    close(ring->fd);
+    unmap_rings(ring);
+    munmap(ring->area, ring->area_size);
+    free(ring->slots);
+    free(ring);
+}
+
+/* Submits the queued entries and waits for min_complete completions during
+   timeout_us microseconds (no limit if negative). Returns -1 if the call
+   fails, ETIME if the time is elapsed. */
+static int ring_enter(modbus_uring_t *ring, unsigned min_complete,
+                      int64_t timeout_us)
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned flags = 0;
+    unsigned nb_queued = ring->nb_queued;
+    int rc;
+
+    if (min_complete > 0) {
+        flags |= IORING_ENTER_GETEVENTS;
+    }
+    memset(&arg, 0, sizeof(arg));
+    if (min_complete > 0 && timeout_us >= 0) {
+        ts.tv_sec = timeout_us / 1000000;
+        ts.tv_nsec = (timeout_us % 1000000) * 1000;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+    }
+    flags |= IORING_ENTER_EXT_ARG;
+
+    rc = sys_io_uring_enter(ring->fd, nb_queued, min_complete, flags,
+                            &arg, sizeof(arg));
+    ring->stats.enters++;
+
+    /* The kernel moves the head over the entries it has consumed, even if
+       the wait fails */
+    ring->nb_queued = *ring->sq_tail - __atomic_load_n(ring->sq_head,
+                                                       __ATOMIC_ACQUIRE);
+    ring->stats.submitted += nb_queued - ring->nb_queued;
+
+    return rc < 0 ? -1 : 0;
+}
+
+static struct io_uring_sqe *get_sqe(modbus_uring_t *ring)
+{
+    struct io_uring_sqe *sqe;
+    unsigned tail = *ring->sq_tail;
+
+    if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >=
+        ring->sq_entries) {
+        /* Full, the entries are submitted without waiting */
+        ring_enter(ring, 0, -1);
+        if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >=
+            ring->sq_entries) {
+            errno = EBUSY;
+            return NULL;
+        }
+    }
+
+    sqe = &ring->sqes[tail & ring->sq_mask];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    return sqe;
+}
+
+static void queue_sqe(modbus_uring_t *ring)
+{
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + 1, __ATOMIC_RELEASE);
+    ring->nb_queued++;
+}
+
+static uint64_t user_data(struct _modbus_uring_slot *slot, int op)
+{
+    return (uint64_t)(uintptr_t)slot | op;
+}
+
+static void queue_send(struct _modbus_uring_slot *slot);
+
+static void complete(struct io_uring_cqe *cqe)
+{
+    struct _modbus_uring_slot *slot = (struct _modbus_uring_slot *)(uintptr_t)
+        (cqe->user_data & ~(uint64_t)_MODBUS_URING_OP_MASK);
+    const int res = cqe->res;
+
+    switch (cqe->user_data & _MODBUS_URING_OP_MASK) {
+    case _MODBUS_URING_OP_READ:
+        slot->reading = FALSE;
+        if (res > 0) {
+            slot->rx_start = 0;
+            slot->rx_length = res;
+        } else if (res == 0) {
+            slot->eof = TRUE;
+        } else if (res != -ECANCELED) {
+            slot->error = -res;
+        }
+        break;
+    case _MODBUS_URING_OP_SEND:
+        slot->sending = FALSE;
+        if (res < 0 && res != -ECANCELED)
+            slot->error = -res;
+        if (res < 0 || slot->tx_length == 0) {
+            /* Failed or canceled, the requests not sent are dropped */
+            slot->tx_length = 0;
+            slot->tx_sent = 0;
+        } else {
+            slot->tx_sent += res;
+            if (slot->tx_sent == slot->tx_length) {
+                slot->tx_length = 0;
+                slot->tx_sent = 0;
+            } else {
+                /* Short sending, the rest of the requests is sent again */
+                queue_send(slot);
+            }
+        }
+        break;
+    default:
+        /* Outcome of a cancellation, the canceled operation completes too */
+        break;
+    }
+}
+
+/* Handles the completions without system call */
+void _modbus_uring_reap(modbus_uring_t *ring)
+{
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+    if (head == tail)
+        return;
+
+    for (; head != tail; head++) {
+        complete(&ring->cqes[head & ring->cq_mask]);
+        ring->stats.completed++;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static struct _modbus_uring_slot *get_slot(modbus_t *ctx)
+{
+    return ((modbus_tcp_t *)ctx->backend_data)->uring;
+}
+
+static int is_ready(struct _modbus_uring_slot *slot)
+{
+    return slot->rx_length > 0 || slot->error != 0 || slot->eof;
+}
+
+/* Queues the read of the next bytes of the socket, done once the previous
+   ones are consumed */
+static void arm_read(struct _modbus_uring_slot *slot, int s)
+{
+    modbus_uring_t *ring = slot->ring;
+    struct io_uring_sqe *sqe;
+
+    if (slot->reading || is_ready(slot) || s == -1)
+        return;
+
+    sqe = get_sqe(ring);
+    if (sqe == NULL) {
+        slot->error = errno;
+        return;
+    }
+
+    sqe->fd = s;
+    sqe->addr = (uint64_t)(uintptr_t)slot->rx;
+    sqe->len = _MODBUS_RX_BUFFER_LENGTH;
+    if (ring->stats.registered) {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->buf_index = 0;
+        /* No position on a socket */
+        sqe->off = (uint64_t)-1;
+    } else {
+        sqe->opcode = IORING_OP_RECV;
+    }
+    sqe->user_data = user_data(slot, _MODBUS_URING_OP_READ);
+    queue_sqe(ring);
+
+    slot->reading = TRUE;
+    slot->read_s = s;
+}
+
+/* Queues the sending of the bytes of tx not sent yet, unless a sending is
+   already in flight */
+static void queue_send(struct _modbus_uring_slot *slot)
+{
+    modbus_uring_t *ring = slot->ring;
+    struct io_uring_sqe *sqe;
+
+    if (slot->sending || slot->tx_sent == slot->tx_length)
+        return;
+
+    sqe = get_sqe(ring);
+    if (sqe == NULL) {
+        slot->error = errno;
+        slot->tx_length = 0;
+        slot->tx_sent = 0;
+        return;
+    }
+
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = slot->send_s;
+    sqe->addr = (uint64_t)(uintptr_t)(slot->tx + slot->tx_sent);
+    sqe->len = slot->tx_length - slot->tx_sent;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = user_data(slot, _MODBUS_URING_OP_SEND);
+    queue_sqe(ring);
+    slot->sending = TRUE;
+}
+
+/* Cancels the operations of the slot and waits for their completion, the
+   kernel won't use its buffers anymore */
+static void cancel_slot(struct _modbus_uring_slot *slot)
+{
+    modbus_uring_t *ring = slot->ring;
+    int op;
+
+    _modbus_uring_reap(ring);
+    /* The rest of a short sending isn't sent again */
+    slot->tx_length = 0;
+    for (op = _MODBUS_URING_OP_READ; op <= _MODBUS_URING_OP_SEND; op++) {
+        struct io_uring_sqe *sqe;
+
+        if ((op == _MODBUS_URING_OP_READ && !slot->reading) ||
+            (op == _MODBUS_URING_OP_SEND && !slot->sending))
+            continue;
+
+        sqe = get_sqe(ring);
+        if (sqe == NULL)
+            continue;
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = user_data(slot, op);
+#ifdef IORING_ASYNC_CANCEL_ALL
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+#endif
+        sqe->user_data = user_data(slot, _MODBUS_URING_OP_CANCEL);
+        queue_sqe(ring);
+    }
+
+    while (slot->reading || slot->sending) {
+        if (ring_enter(ring, 1, -1) == -1 && errno != EINTR)
+            break;
+        _modbus_uring_reap(ring);
+    }
+}
+
+/* The bytes of the previous socket of the context (see modbus_set_socket)
+   don't belong to the new one */
+static void follow_socket(struct _modbus_uring_slot *slot, int s)
+{
+    if (slot->reading && slot->read_s != s) {
+        cancel_slot(slot);
+        slot->rx_length = 0;
+        slot->eof = FALSE;
+        slot->error = 0;
+    }
+}
+
+/* Waits the bytes of the context for timeout_us microseconds (no limit if
+   negative), the completions of the other contexts are stored in their
+   slots */
+static int wait_slot(modbus_t *ctx, struct _modbus_uring_slot *slot,
+                     int64_t timeout_us)
+{
+    modbus_uring_t *ring = slot->ring;
+    const uint64_t deadline = _modbus_time_us() + (timeout_us > 0 ? timeout_us : 0);
+
+    follow_socket(slot, ctx->s);
+    for (;;) {
+        int64_t wait_us = -1;
+
+        _modbus_uring_reap(ring);
+        if (is_ready(slot))
+            return 1;
+        arm_read(slot, ctx->s);
+
+        if (timeout_us >= 0) {
+            uint64_t now = _modbus_time_us();
+
+            if (now >= deadline) {
+                if (ring->nb_queued > 0) {
+                    ring_enter(ring, 0, -1);
+                    _modbus_uring_reap(ring);
+                    if (is_ready(slot))
+                        return 1;
+                }
+                errno = ETIMEDOUT;
+                return -1;
+            }
+            wait_us = deadline - now;
+        }
+
+        if (ring_enter(ring, 1, wait_us) == -1 && errno != ETIME &&
+            errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+/* The request is only queued, it is submitted by the next wait on the ring
+   with the read of its response */
+ssize_t _modbus_uring_send(modbus_t *ctx, const uint8_t *req, int req_length)
+{
+    struct _modbus_uring_slot *slot = get_slot(ctx);
+    modbus_uring_t *ring = slot->ring;
+
+    if (ctx->s == -1) {
+        errno = EBADF;
+        return -1;
+    }
+    follow_socket(slot, ctx->s);
+    _modbus_uring_reap(ring);
+    if (slot->error != 0) {
+        errno = slot->error;
+        slot->error = 0;
+        return -1;
+    }
+
+    /* The buffer of the requests is reused once they are sent */
+    while (slot->tx_length + req_length > _MODBUS_URING_TX_LENGTH) {
+        if (ring_enter(ring, 1, -1) == -1 && errno != EINTR)
+            return -1;
+        _modbus_uring_reap(ring);
+    }
+
+    memcpy(slot->tx + slot->tx_length, req, req_length);
+    slot->tx_length += req_length;
+    slot->send_s = ctx->s;
+    queue_send(slot);
+    if (slot->error != 0) {
+        errno = slot->error;
+        slot->error = 0;
+        return -1;
+    }
+
+    arm_read(slot, ctx->s);
+
+    return req_length;
+}
+
+ssize_t _modbus_uring_recv(modbus_t *ctx, uint8_t *rsp, int rsp_length)
+{
+    struct _modbus_uring_slot *slot = get_slot(ctx);
+
+    follow_socket(slot, ctx->s);
+    _modbus_uring_reap(slot->ring);
+
+    if (slot->rx_length > 0) {
+        int length = (rsp_length < slot->rx_length) ? rsp_length : slot->rx_length;
+
+        memcpy(rsp, slot->rx + slot->rx_start, length);
+        slot->rx_start += length;
+        slot->rx_length -= length;
+        /* Queued for the next wait */
+        arm_read(slot, ctx->s);
+        return length;
+    }
+
+    if (slot->error != 0) {
+        errno = slot->error;
+        slot->error = 0;
+        return -1;
+    }
+
+    if (slot->eof) {
+        return 0;
+    }
+
+    arm_read(slot, ctx->s);
+    errno = EAGAIN;
+    return -1;
+}
+
+int _modbus_uring_select(modbus_t *ctx, struct timeval *tv, int length_to_read)
+{
+    struct _modbus_uring_slot *slot = get_slot(ctx);
+
+    (void)length_to_read;
+    return wait_slot(ctx, slot, tv == NULL ? -1 :
+                     (int64_t)tv->tv_sec * 1000000 + tv->tv_usec);
+}
+
+/* Discards the bytes received, as the TCP backend does with the bytes of the
+   socket */
+int _modbus_uring_flush(modbus_t *ctx)
+{
+    struct _modbus_uring_slot *slot = get_slot(ctx);
+    modbus_uring_t *ring = slot->ring;
+    uint8_t devnull[MODBUS_TCP_MAX_ADU_LENGTH];
+    int rc_sum = 0;
+    int rc;
+
+    if (ctx->s == -1) {
+        errno = EBADF;
+        return -1;
+    }
+    follow_socket(slot, ctx->s);
+
+    /* The completions of the bytes arrived are posted on entry */
+    ring_enter(ring, 0, -1);
+    _modbus_uring_reap(ring);
+    rc_sum = slot->rx_length;
+    slot->rx_length = 0;
+
+    /* Beyond the read in flight */
+    do {
+        rc = recv(ctx->s, (char *)devnull, MODBUS_TCP_MAX_ADU_LENGTH, MSG_DONTWAIT);
+        if (rc > 0) {
+            rc_sum += rc;
+        }
+    } while (rc == MODBUS_TCP_MAX_ADU_LENGTH);
+
+    if (ctx->debug && rc_sum > 0) {
+        printf("%d bytes flushed\n", rc_sum);
+    }
+    arm_read(slot, ctx->s);
+
+    return rc_sum;
+}
+
+void _modbus_uring_connected(modbus_t *ctx)
+{
+    struct _modbus_uring_slot *slot = get_slot(ctx);
+
+    cancel_slot(slot);
+    slot->rx_length = 0;
+    slot->tx_sent = 0;
+    slot->error = 0;
+    slot->eof = FALSE;
+}
+
+/* The read in flight ends with the shutdown, then the socket is closed */
+void _modbus_uring_close(modbus_t *ctx)
+{
+    struct _modbus_uring_slot *slot = get_slot(ctx);
+
+    if (ctx->s != -1) {
+        shutdown(ctx->s, SHUT_RDWR);
+        cancel_slot(slot);
+        close(ctx->s);
+        ctx->s = -1;
+    }
+    slot->rx_length = 0;
+    slot->error = 0;
+    slot->eof = FALSE;
+}
+
+/* Gives back the slot of a context being freed, its socket may stay open */
+void _modbus_uring_detach(modbus_t *ctx)
+{
+    struct _modbus_uring_slot *slot = get_slot(ctx);
+
+    if (slot == NULL)
+        return;
+
+    cancel_slot(slot);
+    slot->in_use = FALSE;
+    ((modbus_tcp_t *)ctx->backend_data)->uring = NULL;
+}
+
+modbus_t* modbus_new_tcp_uring(modbus_uring_t *ring, const char *ip_address,
+                               int port)
+{
+    struct _modbus_uring_slot *slot = NULL;
+    modbus_t *ctx;
+    int i;
+
+    if (ring == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    for (i = 0; i < ring->nb_slots; i++) {
+        if (!ring->slots[i].in_use) {
+            slot = &ring->slots[i];
+            break;
+        }
+    }
+    if (slot == NULL) {
+        errno = ENOSPC;
+        return NULL;
+    }
+
+    ctx = modbus_new_tcp(ip_address, port);
+    if (ctx == NULL)
+        return NULL;
+
+    memset(slot, 0, sizeof(struct _modbus_uring_slot));
+    slot->ring = ring;
+    slot->in_use = TRUE;
+    slot->tx = ring->area + (size_t)i * _MODBUS_URING_SLOT_LENGTH;
+    slot->rx = slot->tx + _MODBUS_URING_TX_LENGTH;
+    slot->read_s = -1;
+    slot->send_s = -1;
+
+    ctx->backend = &_modbus_tcp_uring_backend;
+    ((modbus_tcp_t *)ctx->backend_data)->uring = slot;
+
+    return ctx;
+}
+
+/* Submits the requests queued by the contexts of the ring without waiting
+   for their responses. Returns the number of entries submitted. */
+int modbus_uring_submit(modbus_uring_t *ring)
+{
+    unsigned nb_queued;
+
+    if (ring == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    nb_queued = ring->nb_queued;
+    if (nb_queued > 0 && ring_enter(ring, 0, -1) == -1) {
+        return -1;
+    }
+
+    return nb_queued - ring->nb_queued;
+}
+
+int modbus_uring_get_stats(modbus_uring_t *ring, modbus_uring_stats_t *stats)
+{
+    if (ring == NULL || stats == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    *stats = ring->stats;
+    return 0;
+}
+
+modbus_uring_t *_modbus_uring_ring(modbus_t *ctx)
+{
+    if (ctx->backend != &_modbus_tcp_uring_backend)
+        return NULL;
+
+    return get_slot(ctx)->ring;
+}
+
+/* Bytes, error or end of stream to report by recv() */
+int _modbus_uring_readable(modbus_t *ctx)
+{
+    struct _modbus_uring_slot *slot = get_slot(ctx);
+
+    follow_socket(slot, ctx->s);
+    if (is_ready(slot))
+        return TRUE;
+
+    arm_read(slot, ctx->s);
+    return FALSE;
+}
+
+int _modbus_uring_fd(modbus_uring_t *ring)
+{
+    return ring->fd;
+}
+
+/* Submits the queued entries and waits for a completion during timeout_ms
+   milliseconds (no limit if negative). Returns 0 once the completions are
+   handled or the time elapsed. */
+int _modbus_uring_wait(modbus_uring_t *ring, int timeout_ms)
+{
+    int rc;
+
+    rc = ring_enter(ring, 1, timeout_ms < 0 ? -1 : (int64_t)timeout_ms * 1000);
+    _modbus_uring_reap(ring);
+    if (rc == -1 && errno != ETIME) {
+        return -1;
+    }
+
+    return 0;
+}
+
+#else
+
+modbus_uring_t* modbus_uring_new(int nb_contexts)
+{
+    (void)nb_contexts;
+    errno = ENOTSUP;
+    return NULL;
+}
+
+void modbus_uring_free(modbus_uring_t *ring)
+{
+    (void)ring;
+}
+
+modbus_t* modbus_new_tcp_uring(modbus_uring_t *ring, const char *ip_address,
+                               int port)
+{
+    (void)ring;
+    (void)ip_address;
+    (void)port;
+    errno = ENOTSUP;
+    return NULL;
+}
+
+int modbus_uring_submit(modbus_uring_t *ring)
+{
+    (void)ring;
+    errno = ENOTSUP;
+    return -1;
+}
+
+int modbus_uring_get_stats(modbus_uring_t *ring, modbus_uring_stats_t *stats)
+{
+    (void)ring;
+    (void)stats;
+    errno = ENOTSUP;
+    return -1;
+}
+
+/* No context uses the backend without a ring */
+ssize_t _modbus_uring_send(modbus_t *ctx, const uint8_t *req, int req_length)
+{
+    (void)ctx;
+    (void)req;
+    (void)req_length;
+    errno = ENOTSUP;
+    return -1;
+}
+
+ssize_t _modbus_uring_recv(modbus_t *ctx, uint8_t *rsp, int rsp_length)
+{
+    (void)ctx;
+    (void)rsp;
+    (void)rsp_length;
+    errno = ENOTSUP;
+    return -1;
+}
+
+int _modbus_uring_select(modbus_t *ctx, struct timeval *tv, int length_to_read)
+{
+    (void)ctx;
+    (void)tv;
+    (void)length_to_read;
+    errno = ENOTSUP;
+    return -1;
+}
+
+int _modbus_uring_flush(modbus_t *ctx)
+{
+    (void)ctx;
+    errno = ENOTSUP;
+    return -1;
+}
+
+void _modbus_uring_connected(modbus_t *ctx)
+{
+    (void)ctx;
+}
+
+void _modbus_uring_close(modbus_t *ctx)
+{
+    (void)ctx;
+}
+
+void _modbus_uring_detach(modbus_t *ctx)
+{
+    (void)ctx;
+}
+
+modbus_uring_t *_modbus_uring_ring(modbus_t *ctx)
+{
+    (void)ctx;
+    return NULL;
+}
+
+int _modbus_uring_readable(modbus_t *ctx)
+{
+    (void)ctx;
+    return FALSE;
+}
+
+int _modbus_uring_fd(modbus_uring_t *ring)
+{
+    (void)ring;
+    return -1;
+}
+
+int _modbus_uring_wait(modbus_uring_t *ring, int timeout_ms)
+{
+    (void)ring;
+    (void)timeout_ms;
+    errno = ENOTSUP;
+    return -1;
+}
+
+void _modbus_uring_reap(modbus_uring_t *ring)
+{
+    (void)ring;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ * Copyright © 2001-2010 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#ifndef MODBUS_URING_H
+#define MODBUS_URING_H
+
+#include "modbus.h"
+
+MODBUS_BEGIN_DECLS
+
+#if !defined(_WIN32)
+
+typedef struct _modbus_uring modbus_uring_t;
+
+typedef struct {
+    /* Calls of io_uring_enter() */
+    uint64_t enters;
+    /* Operations submitted and completed through the ring */
+    uint64_t submitted;
+    uint64_t completed;
+    /* TRUE if the buffers of the contexts are registered with the ring */
+    int registered;
+} modbus_uring_stats_t;
+
+MODBUS_API modbus_uring_t* modbus_uring_new(int nb_contexts);
+MODBUS_API void modbus_uring_free(modbus_uring_t *ring);
+
+MODBUS_API modbus_t* modbus_new_tcp_uring(modbus_uring_t *ring,
+                                          const char *ip_address, int port);
+
+MODBUS_API int modbus_uring_submit(modbus_uring_t *ring);
+MODBUS_API int modbus_uring_get_stats(modbus_uring_t *ring,
+                                      modbus_uring_stats_t *stats);
+
+#endif
+
+MODBUS_END_DECLS
+
+#endif /* MODBUS_URING_H */
@@ -31,9 +31,6 @@ const unsigned int libmodbus_version_major = LIBMODBUS_VERSION_MAJOR;
 const unsigned int libmodbus_version_minor = LIBMODBUS_VERSION_MINOR;
 const unsigned int libmodbus_version_micro = LIBMODBUS_VERSION_MICRO;
 
-/* Max between RTU and TCP max adu length (so TCP) */
-#define MAX_MESSAGE_LENGTH 260
-
 /* 3 steps are used to parse the query */
 typedef enum {
     _STEP_FUNCTION,
@@ -90,24 +87,156 @@ void _error_print(modbus_t *ctx, const char *context)
     }
 }
 
+/* Sleeps the response timeout of the slave (learned when enabled), no longer
+   than the time left before the transaction deadline */
 static void _sleep_response_timeout(modbus_t *ctx)
 {
-    /* Response timeout is always positive */
+    uint64_t timeout = _modbus_response_timeout(ctx, ctx->slave);
+
+    if (ctx->transaction_deadline != 0) {
+        uint64_t now = _modbus_time_us();
+        uint64_t left = (now < ctx->transaction_deadline) ?
+            ctx->transaction_deadline - now : 0;
+
+        if (timeout > left)
+            timeout = left;
+    }
+
 #ifdef _WIN32
     /* usleep doesn't exist on Windows */
-    Sleep((ctx->response_timeout.tv_sec * 1000) +
-          (ctx->response_timeout.tv_usec / 1000));
+    Sleep((DWORD)(timeout / 1000));
 #else
     /* usleep source code */
     struct timespec request, remaining;
-    request.tv_sec = ctx->response_timeout.tv_sec;
-    request.tv_nsec = ((long int)ctx->response_timeout.tv_usec) * 1000;
+    request.tv_sec = timeout / 1000000;
+    request.tv_nsec = (long int)(timeout % 1000000) * 1000;
     while (nanosleep(&request, &remaining) == -1 && errno == EINTR) {
         request = remaining;
     }
 #endif
 }
 
+/* Error recovery after a timeout or an invalid confirmation: the rest of the
+   response is awaited (when wait is TRUE) and discarded, otherwise its bytes
+   would be taken for the confirmation of the next request. Nothing is
+   discarded while other requests are in flight on the context (see
+   modbus_complete), their confirmations would go with it. */
+static void flush_late_response(modbus_t *ctx, int wait)
+{
+    if (ctx->nb_in_flight > 1)
+        return;
+
+    if (wait) {
+        _sleep_response_timeout(ctx);
+    }
+    modbus_flush(ctx);
+}
+
+/* Returns a monotonic time in microseconds, only differences between two
+   values are meaningful */
+uint64_t _modbus_time_us(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000 +
+        (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000 /
+        frequency.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+#if !defined(_WIN32)
+/* Waits until the descriptor of the context is readable or until tv has
+   elapsed (forever if tv is NULL). The wait is a poll() on the single
+   descriptor so its cost doesn't depend on the value of the descriptor nor on
+   the number of descriptors opened by the process, unlike select() which
+   scans the set up to the highest descriptor and can't handle one above
+   FD_SETSIZE. */
+int _modbus_wait_readable(modbus_t *ctx, const struct timeval *tv)
+{
+    struct pollfd wait_fd;
+    uint64_t deadline = 0;
+    int rc;
+
+    if (tv != NULL) {
+        deadline = _modbus_time_us() +
+            (uint64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+    }
+
+    wait_fd.fd = ctx->s;
+    wait_fd.events = POLLIN;
+    wait_fd.revents = 0;
+
+    for (;;) {
+        uint64_t remaining = 0;
+
+        if (tv != NULL) {
+            uint64_t now = _modbus_time_us();
+
+            /* Computed again after a signal to keep the original deadline */
+            if (now < deadline) {
+                remaining = deadline - now;
+            }
+        }
+
+#ifdef HAVE_PPOLL
+        if (tv != NULL) {
+            struct timespec ts;
+
+            ts.tv_sec = remaining / 1000000;
+            ts.tv_nsec = (remaining % 1000000) * 1000;
+            rc = ppoll(&wait_fd, 1, &ts, NULL);
+        } else {
+            rc = ppoll(&wait_fd, 1, NULL, NULL);
+        }
+#else
+        if (tv != NULL) {
+            /* Rounded up to not return before the end of the timeout */
+            uint64_t timeout_ms = (remaining + 999) / 1000;
+
+            rc = poll(&wait_fd, 1,
+                      timeout_ms > INT_MAX ? INT_MAX : (int)timeout_ms);
+        } else {
+            rc = poll(&wait_fd, 1, -1);
+        }
+#endif
+        if (rc != -1 || errno != EINTR) {
+            break;
+        }
+
+        if (ctx->debug) {
+            fprintf(stderr, "A non blocked signal was caught\n");
+        }
+    }
+
+    if (rc == 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    if (rc > 0 && (wait_fd.revents & POLLNVAL)) {
+        /* Same error as select() on a closed descriptor */
+        errno = EBADF;
+        return -1;
+    }
+
+    return rc;
+}
+#endif
+
 int modbus_flush(modbus_t *ctx)
 {
     int rc;
@@ -117,6 +246,9 @@ int modbus_flush(modbus_t *ctx)
         return -1;
     }
 
+    /* Buffered bytes are discarded too */
+    ctx->rx_start = ctx->rx_length = 0;
+
     rc = ctx->backend->flush(ctx);
     if (rc != -1 && ctx->debug) {
         /* Not all backends are able to return the number of bytes flushed */
@@ -166,13 +298,24 @@ static unsigned int compute_response_length_from_request(modbus_t *ctx, uint8_t
 }
 
 /* Sends a request/response */
-static int send_msg(modbus_t *ctx, uint8_t *msg, int msg_length)
+static int send_adu(modbus_t *ctx, uint8_t *msg, int msg_length)
 {
     int rc;
     int i;
 
     msg_length = ctx->backend->send_msg_pre(msg, msg_length);
 
+    /* Start of a transaction, the confirmation must be received before the
+       deadline */
+    if (ctx->transaction_timeout.tv_sec > 0 ||
+        ctx->transaction_timeout.tv_usec > 0) {
+        ctx->transaction_deadline = _modbus_time_us() +
+            (uint64_t)ctx->transaction_timeout.tv_sec * 1000000 +
+            ctx->transaction_timeout.tv_usec;
+    } else {
+        ctx->transaction_deadline = 0;
+    }
+
     if (ctx->debug) {
         for (i = 0; i < msg_length; i++)
             printf("[%.2X]", msg[i]);
@@ -205,16 +348,68 @@ static int send_msg(modbus_t *ctx, uint8_t *msg, int msg_length)
         }
         /* -- END QMODBUS MODIFICATION -- */
     } while ((ctx->error_recovery & MODBUS_ERROR_RECOVERY_LINK) &&
-             rc == -1);
+             rc == -1 &&
+             (ctx->transaction_deadline == 0 ||
+              _modbus_time_us() < ctx->transaction_deadline));
 
     if (rc > 0 && rc != msg_length) {
         errno = EMBBADDATA;
         return -1;
     }
 
+    if (rc > 0) {
+        ctx->stats.bytes_out += rc;
+    }
+
+    return rc;
+}
+
+/* Sends a request, the latencies of its confirmation start from there */
+static int send_msg(modbus_t *ctx, uint8_t *msg, int msg_length)
+{
+    int rc = send_adu(ctx, msg, msg_length);
+
+    if (rc > 0) {
+        ctx->stats.requests++;
+        ctx->stats_sent = _modbus_time_us();
+    }
+
+    return rc;
+}
+
+/* Sends the response to an indication */
+static int send_rsp(modbus_t *ctx, uint8_t *msg, int msg_length)
+{
+    int rc = send_adu(ctx, msg, msg_length);
+
+    if (rc > 0) {
+        ctx->stats.responses++;
+    }
+
     return rc;
 }
 
+/* Counts a confirmation received for a request sent at the given time */
+void _modbus_stats_confirmation(modbus_t *ctx, uint64_t sent)
+{
+    uint64_t now = _modbus_time_us();
+
+    ctx->stats.responses++;
+    if (ctx->stats_first_byte >= sent) {
+        _modbus_stats_latency(&ctx->stats.first_byte_latency,
+                              ctx->stats_first_byte - sent);
+        _modbus_rtt_sample(ctx, ctx->slave, ctx->stats_first_byte - sent);
+    }
+    if (now >= sent) {
+        _modbus_stats_latency(&ctx->stats.response_latency, now - sent);
+    }
+}
+
+int _modbus_send_msg(modbus_t *ctx, uint8_t *msg, int msg_length)
+{
+    return send_msg(ctx, msg, msg_length);
+}
+
 int modbus_send_raw_request(modbus_t *ctx, uint8_t *raw_req, int raw_req_length)
 {
     sft_t sft;
@@ -302,20 +497,21 @@ static uint8_t compute_meta_length_after_function(int function,
 }
 
 /* Computes the length to read after the meta information (address, count, etc) */
-static int compute_data_length_after_meta(modbus_t *ctx, uint8_t *msg,
+static int compute_data_length_after_meta(const modbus_backend_t *backend,
+                                          const uint8_t *msg,
                                           msg_type_t msg_type)
 {
-    int function = msg[ctx->backend->header_length];
+    int function = msg[backend->header_length];
     int length;
 
     if (msg_type == MSG_INDICATION) {
         switch (function) {
         case MODBUS_FC_WRITE_MULTIPLE_COILS:
         case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
-            length = msg[ctx->backend->header_length + 5];
+            length = msg[backend->header_length + 5];
             break;
         case MODBUS_FC_WRITE_AND_READ_REGISTERS:
-            length = msg[ctx->backend->header_length + 9];
+            length = msg[backend->header_length + 9];
             break;
         default:
             length = 0;
@@ -326,17 +522,208 @@ static int compute_data_length_after_meta(modbus_t *ctx, uint8_t *msg,
             function == MODBUS_FC_REPORT_SLAVE_ID ||
             function == MODBUS_FC_WRITE_AND_READ_REGISTERS ||
             function == MODBUS_FC_READ_FILE_RECORD) {
-            length = msg[ctx->backend->header_length + 1];
+            length = msg[backend->header_length + 1];
         } else {
             length = 0;
         }
     }
 
-    length += ctx->backend->checksum_length;
+    length += backend->checksum_length;
+
+    return length;
+}
+
+/* Returns the length of the message starting at msg when the msg_length
+   bytes available are enough to compute it (the same steps as receive_msg),
+   otherwise the length to reach to go further, so the result is larger than
+   msg_length. Returns -1 and sets errno if the announced message is larger
+   than the ADU of the backend. */
+int _modbus_frame_length(const modbus_backend_t *backend, const uint8_t *msg,
+                         int msg_length, msg_type_t msg_type)
+{
+    const int offset = backend->header_length;
+    int length = offset + 1;
+
+    if (msg_length < length)
+        return length;
+
+    length += compute_meta_length_after_function(msg[offset], msg_type);
+    if (msg_length < length)
+        return length;
+
+    length += compute_data_length_after_meta(backend, msg, msg_type);
+    if (length > (int)backend->max_adu_length) {
+        errno = EMBBADDATA;
+        return -1;
+    }
 
     return length;
 }
 
+/* Returns the number of bytes still missing to complete the message of
+   msg_length bytes (0 if complete), as receive_msg reads it step by step, or
+   -1 if the announced message is larger than the ADU of the backend. */
+int _modbus_frame_missing(modbus_t *ctx, uint8_t *msg, int msg_length,
+                          msg_type_t msg_type)
+{
+    int length = _modbus_frame_length(ctx->backend, msg, msg_length, msg_type);
+
+    if (length == -1) {
+        _error_print(ctx, "too many data");
+        return -1;
+    }
+
+    return length - msg_length;
+}
+
+
+/* Copies up to length bytes from the receive buffer to msg and returns the
+   number of bytes copied. */
+static int rx_buffer_consume(modbus_t *ctx, uint8_t *msg, int length)
+{
+    int n = (ctx->rx_length < length) ? ctx->rx_length : length;
+    int first = _MODBUS_RX_BUFFER_LENGTH - ctx->rx_start;
+
+    if (first > n)
+        first = n;
+
+    memcpy(msg, ctx->rx_buf + ctx->rx_start, first);
+    memcpy(msg + first, ctx->rx_buf, n - first);
+
+    ctx->rx_start = (ctx->rx_start + n) & (_MODBUS_RX_BUFFER_LENGTH - 1);
+    ctx->rx_length -= n;
+
+    return n;
+}
+
+/* Reads as many bytes as the kernel holds (up to the contiguous free space of
+   the receive buffer) with a single call to the backend. */
+static ssize_t rx_buffer_fill(modbus_t *ctx)
+{
+    ssize_t rc;
+    int end;
+    int space;
+
+    if (ctx->rx_length == 0) {
+        /* Restart at the beginning to offer the largest contiguous space */
+        ctx->rx_start = 0;
+    }
+
+    end = (ctx->rx_start + ctx->rx_length) & (_MODBUS_RX_BUFFER_LENGTH - 1);
+    if (end < ctx->rx_start || ctx->rx_length == _MODBUS_RX_BUFFER_LENGTH) {
+        space = _MODBUS_RX_BUFFER_LENGTH - ctx->rx_length;
+    } else {
+        space = _MODBUS_RX_BUFFER_LENGTH - end;
+    }
+
+    rc = ctx->backend->recv(ctx, ctx->rx_buf + end, space);
+    if (rc > 0) {
+        ctx->rx_length += rc;
+    }
+
+    return rc;
+}
+
+/* Function codes the library knows, the exception responses included for the
+   confirmations */
+static int is_known_function(int function, msg_type_t msg_type)
+{
+    if (msg_type == MSG_CONFIRMATION)
+        function &= 0x7F;
+
+    switch (function) {
+    case MODBUS_FC_READ_COILS:
+    case MODBUS_FC_READ_DISCRETE_INPUTS:
+    case MODBUS_FC_READ_HOLDING_REGISTERS:
+    case MODBUS_FC_READ_INPUT_REGISTERS:
+    case MODBUS_FC_WRITE_SINGLE_COIL:
+    case MODBUS_FC_WRITE_SINGLE_REGISTER:
+    case MODBUS_FC_READ_EXCEPTION_STATUS:
+    case MODBUS_FC_WRITE_MULTIPLE_COILS:
+    case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+    case MODBUS_FC_REPORT_SLAVE_ID:
+    case MODBUS_FC_READ_FILE_RECORD:
+    case MODBUS_FC_MASK_WRITE_REGISTER:
+    case MODBUS_FC_WRITE_AND_READ_REGISTERS:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+/* With MODBUS_ERROR_RECOVERY_RESYNC, looks for the next RTU frame after the
+   first byte of the invalid message of msg_length bytes, in the rest of the
+   message and in the receive buffer. A frame starts with the slave of the
+   context (or the broadcast address) and is either complete with a valid CRC
+   or cut by the end of the bytes received with a known function code. The
+   bytes before it are dropped and counted in the stats, the frame and the
+   bytes after it are left in the receive buffer to be read again. Returns
+   TRUE if a frame was found, FALSE if all the bytes were dropped. */
+static int rx_buffer_resync(modbus_t *ctx, const uint8_t *msg, int msg_length,
+                            msg_type_t msg_type)
+{
+    uint8_t buf[MAX_MESSAGE_LENGTH + _MODBUS_RX_BUFFER_LENGTH];
+    int length = 0;
+    int offset;
+
+    if (ctx->backend->backend_type != _MODBUS_BACKEND_TYPE_RTU ||
+        !(ctx->error_recovery & MODBUS_ERROR_RECOVERY_RESYNC)) {
+        return FALSE;
+    }
+
+    if (msg_length > 1) {
+        memcpy(buf, msg + 1, msg_length - 1);
+        length = msg_length - 1;
+    }
+    length += rx_buffer_consume(ctx, buf + length, ctx->rx_length);
+    ctx->rx_start = 0;
+
+    for (offset = 0; offset < length; offset++) {
+        const uint8_t *frame = buf + offset;
+        int available = length - offset;
+        int frame_length;
+
+        if (frame[0] != ctx->slave && frame[0] != MODBUS_BROADCAST_ADDRESS)
+            continue;
+
+        if (available < 2) {
+            /* Only the slave address, the function code is still to come */
+            break;
+        }
+
+        frame_length = _modbus_frame_length(ctx->backend, frame, available,
+                                            msg_type);
+        if (frame_length == -1)
+            continue;
+
+        if (frame_length > available) {
+            if (is_known_function(frame[1], msg_type))
+                break;
+        } else if (modbus_rtu_crc16((uint8_t *)frame, frame_length - 2) ==
+                   ((frame[frame_length - 2] << 8) | frame[frame_length - 1])) {
+            break;
+        }
+    }
+
+    ctx->stats.resync_bytes += offset + 1;
+    if (ctx->debug) {
+        printf("Resync: %d bytes dropped%s\n", offset + 1,
+               (offset < length) ? "" : ", no frame found");
+    }
+
+    if (offset == length)
+        return FALSE;
+
+    /* The frame and what follows are read again, from the receive buffer */
+    if (length - offset > _MODBUS_RX_BUFFER_LENGTH) {
+        ctx->stats.resync_bytes += length - offset - _MODBUS_RX_BUFFER_LENGTH;
+        length = offset + _MODBUS_RX_BUFFER_LENGTH;
+    }
+    memcpy(ctx->rx_buf, buf + offset, length - offset);
+    ctx->rx_length = length - offset;
+
+    return TRUE;
+}
 
 /* Waits a response from a modbus server or a request from a modbus client.
    This function blocks if there is no replies (3 timeouts).
@@ -351,12 +738,18 @@ static int compute_data_length_after_meta(modbus_t *ctx, uint8_t *msg,
    - read() or recv() error codes
 */
 
-int _modbus_receive_msg(modbus_t *ctx, uint8_t *msg, msg_type_t msg_type)
+/* Same as _modbus_receive_msg but the first byte of a confirmation is
+   awaited for response_tv instead of the response timeout of the context.
+   When deadline isn't 0, no wait goes beyond this absolute time (see
+   _modbus_time_us) whatever the response and byte timeouts. */
+static int receive_msg(modbus_t *ctx, uint8_t *msg, msg_type_t msg_type,
+                       const struct timeval *response_tv, uint64_t deadline)
 {
     int rc;
-    fd_set rset;
     struct timeval tv;
     struct timeval *p_tv;
+    struct timeval deadline_tv;
+    struct timeval *wait_tv;
     int length_to_read;
     int msg_length = 0;
     _step_t step;
@@ -369,10 +762,6 @@ int _modbus_receive_msg(modbus_t *ctx, uint8_t *msg, msg_type_t msg_type)
         }
     }
 
-    /* Add a file descriptor to the set */
-    FD_ZERO(&rset);
-    FD_SET(ctx->s, &rset);
-
     /* We need to analyse the message step by step.  At the first step, we want
      * to reach the function code because all packets contain this
      * information. */
@@ -384,48 +773,89 @@ int _modbus_receive_msg(modbus_t *ctx, uint8_t *msg, msg_type_t msg_type)
          * received */
         p_tv = NULL;
     } else {
-        tv.tv_sec = ctx->response_timeout.tv_sec;
-        tv.tv_usec = ctx->response_timeout.tv_usec;
+        tv.tv_sec = response_tv->tv_sec;
+        tv.tv_usec = response_tv->tv_usec;
         p_tv = &tv;
     }
 
+resync:
     while (length_to_read != 0) {
-        rc = ctx->backend->select(ctx, &rset, p_tv, length_to_read);
-        if (rc == -1) {
-            _error_print(ctx, "select");
-            if (ctx->error_recovery & MODBUS_ERROR_RECOVERY_LINK) {
-                int saved_errno = errno;
+        if (ctx->rx_length == 0) {
+            wait_tv = p_tv;
+            if (deadline != 0) {
+                /* The remaining time is computed again before each wait, a
+                   slow sender can't stretch the transaction byte after
+                   byte */
+                uint64_t now = _modbus_time_us();
+                uint64_t remaining = (now < deadline) ? deadline - now : 0;
+
+                if (wait_tv == NULL ||
+                    remaining < (uint64_t)wait_tv->tv_sec * 1000000 +
+                    wait_tv->tv_usec) {
+                    deadline_tv.tv_sec = remaining / 1000000;
+                    deadline_tv.tv_usec = remaining % 1000000;
+                    wait_tv = &deadline_tv;
+                }
+            }
 
+            rc = ctx->backend->select(ctx, wait_tv, length_to_read);
+            if (rc == -1) {
                 if (errno == ETIMEDOUT) {
-                    _sleep_response_timeout(ctx);
-                    modbus_flush(ctx);
-                } else if (errno == EBADF) {
+                    ctx->stats.timeouts++;
+                    if (msg_type == MSG_CONFIRMATION && msg_length == 0) {
+                        _modbus_rtt_timeout(ctx, ctx->slave);
+                    }
+                }
+                _error_print(ctx, "select");
+                if (ctx->error_recovery & MODBUS_ERROR_RECOVERY_LINK) {
+                    int saved_errno = errno;
+
+                    if (errno == ETIMEDOUT) {
+                        /* No time left to wait for a late response */
+                        flush_late_response(ctx, deadline == 0);
+                    } else if (errno == EBADF) {
+                        modbus_close(ctx);
+                        modbus_connect(ctx);
+                    }
+                    errno = saved_errno;
+                }
+                return -1;
+            }
+
+            /* A confirmation is read in one call with everything the kernel
+               holds. An indication is read step by step to leave the next
+               request in the kernel, where the select() or poll() of the
+               server loop can see it. */
+            if (msg_type == MSG_CONFIRMATION && ctx->rx_buffering) {
+                rc = rx_buffer_fill(ctx);
+            } else {
+                rc = ctx->backend->recv(ctx, msg + msg_length, length_to_read);
+            }
+            if (rc == 0) {
+                errno = ECONNRESET;
+                rc = -1;
+            }
+
+            if (rc == -1) {
+                _error_print(ctx, "read");
+                if ((ctx->error_recovery & MODBUS_ERROR_RECOVERY_LINK) &&
+                    (errno == ECONNRESET || errno == ECONNREFUSED ||
+                     errno == EBADF)) {
+                    int saved_errno = errno;
                     modbus_close(ctx);
                     modbus_connect(ctx);
+                    /* Could be removed by previous calls */
+                    errno = saved_errno;
                 }
-                errno = saved_errno;
+                return -1;
             }
-            return -1;
-        }
 
-        rc = ctx->backend->recv(ctx, msg + msg_length, length_to_read);
-        if (rc == 0) {
-            errno = ECONNRESET;
-            rc = -1;
-        }
-
-        if (rc == -1) {
-            _error_print(ctx, "read");
-            if ((ctx->error_recovery & MODBUS_ERROR_RECOVERY_LINK) &&
-                (errno == ECONNRESET || errno == ECONNREFUSED ||
-                 errno == EBADF)) {
-                int saved_errno = errno;
-                modbus_close(ctx);
-                modbus_connect(ctx);
-                /* Could be removed by previous calls */
-                errno = saved_errno;
+            if (ctx->rx_length > 0) {
+                rc = rx_buffer_consume(ctx, msg + msg_length, length_to_read);
             }
-            return -1;
+        } else {
+            /* Bytes already buffered are consumed first */
+            rc = rx_buffer_consume(ctx, msg + msg_length, length_to_read);
         }
 
         /* -- BEGIN QMODBUS MODIFICATION -- */
@@ -441,8 +871,13 @@ int _modbus_receive_msg(modbus_t *ctx, uint8_t *msg, msg_type_t msg_type)
                 printf("<%.2X>", msg[msg_length + i]);
         }
 
+        if (msg_length == 0 && msg_type == MSG_CONFIRMATION) {
+            ctx->stats_first_byte = _modbus_time_us();
+        }
+
         /* Sums bytes received */
         msg_length += rc;
+        ctx->stats.bytes_in += rc;
         /* Computes remaining bytes */
         length_to_read -= rc;
 
@@ -459,8 +894,14 @@ int _modbus_receive_msg(modbus_t *ctx, uint8_t *msg, msg_type_t msg_type)
                 } /* else switches straight to the next step */
             case _STEP_META:
                 length_to_read = compute_data_length_after_meta(
-                    ctx, msg, msg_type);
+                    ctx->backend, msg, msg_type);
                 if ((msg_length + length_to_read) > (int)ctx->backend->max_adu_length) {
+                    if (rx_buffer_resync(ctx, msg, msg_length, msg_type)) {
+                        step = _STEP_FUNCTION;
+                        length_to_read = ctx->backend->header_length + 1;
+                        msg_length = 0;
+                        goto resync;
+                    }
                     errno = EMBBADDATA;
                     _error_print(ctx, "too many data");
                     return -1;
@@ -488,45 +929,175 @@ int _modbus_receive_msg(modbus_t *ctx, uint8_t *msg, msg_type_t msg_type)
     if (ctx->debug)
         printf("\n");
 
-    return ctx->backend->check_integrity(ctx, msg, msg_length);
+    rc = ctx->backend->check_integrity(ctx, msg, msg_length);
+    if (rc == -1 && errno == EMBBADCRC) {
+        ctx->stats.crc_errors++;
+        if (rx_buffer_resync(ctx, msg, msg_length, msg_type)) {
+            step = _STEP_FUNCTION;
+            length_to_read = ctx->backend->header_length + 1;
+            msg_length = 0;
+            goto resync;
+        }
+        errno = EMBBADCRC;
+    }
+
+    return rc;
 }
 
-/* Receive the request from a modbus master */
-int modbus_receive(modbus_t *ctx, uint8_t *req)
+/* Reads without blocking the bytes of a confirmation already available,
+   after the msg_length ones stored in msg by the previous calls. The backend
+   is read once at most so the caller must only call it when the descriptor
+   is readable or when bytes are buffered (rx_length > 0). Returns the length
+   of the message once complete and checked, 0 when bytes are missing or -1
+   with errno set. */
+int _modbus_receive_available(modbus_t *ctx, uint8_t *msg, int *msg_length)
 {
-    if (ctx == NULL) {
-        errno = EINVAL;
-        return -1;
-    }
+    int length_to_read;
+    int rc;
+    int has_read = FALSE;
+
+resync:
+    length_to_read = _modbus_frame_missing(ctx, msg, *msg_length,
+                                           MSG_CONFIRMATION);
+    while (length_to_read > 0) {
+        if (ctx->rx_length == 0) {
+            if (has_read)
+                return 0;
+            has_read = TRUE;
+
+            if (ctx->rx_buffering) {
+                rc = rx_buffer_fill(ctx);
+            } else {
+                rc = ctx->backend->recv(ctx, msg + *msg_length, length_to_read);
+            }
+            if (rc == 0) {
+                errno = ECONNRESET;
+                rc = -1;
+            }
+            if (rc == -1) {
+                _error_print(ctx, "read");
+                return -1;
+            }
 
-    return ctx->backend->receive(ctx, req);
-}
+            if (ctx->rx_length > 0) {
+                rc = rx_buffer_consume(ctx, msg + *msg_length, length_to_read);
+            }
+        } else {
+            rc = rx_buffer_consume(ctx, msg + *msg_length, length_to_read);
+        }
 
-/* Receives the confirmation.
+        /* -- BEGIN QMODBUS MODIFICATION -- */
+        if (ctx->monitor_raw_data) {
+            ctx->monitor_raw_data(ctx, msg + *msg_length, rc, 0, 1);
+        }
+        /* -- END QMODBUS MODIFICATION -- */
 
-   The function shall store the read response in rsp and return the number of
-   values (bits or words). Otherwise, its shall return -1 and errno is set.
+        if (ctx->debug) {
+            int i;
+            for (i = 0; i < rc; i++)
+                printf("<%.2X>", msg[*msg_length + i]);
+        }
 
-   The function doesn't check the confirmation is the expected response to the
-   initial request.
-*/
-int modbus_receive_confirmation(modbus_t *ctx, uint8_t *rsp)
-{
-    if (ctx == NULL) {
-        errno = EINVAL;
+        if (*msg_length == 0) {
+            ctx->stats_first_byte = _modbus_time_us();
+        }
+        *msg_length += rc;
+        ctx->stats.bytes_in += rc;
+
+        length_to_read = _modbus_frame_missing(ctx, msg, *msg_length,
+                                               MSG_CONFIRMATION);
+    }
+
+    if (length_to_read == -1) {
+        if (rx_buffer_resync(ctx, msg, *msg_length, MSG_CONFIRMATION)) {
+            *msg_length = 0;
+            goto resync;
+        }
         return -1;
     }
 
-    return _modbus_receive_msg(ctx, rsp, MSG_CONFIRMATION);
+    if (ctx->debug)
+        printf("\n");
+
+    rc = ctx->backend->check_integrity(ctx, msg, *msg_length);
+    if (rc == -1 && errno == EMBBADCRC) {
+        ctx->stats.crc_errors++;
+        if (rx_buffer_resync(ctx, msg, *msg_length, MSG_CONFIRMATION)) {
+            *msg_length = 0;
+            goto resync;
+        }
+        errno = EMBBADCRC;
+    }
+
+    return rc;
 }
 
-static int check_confirmation(modbus_t *ctx, uint8_t *req,
-                              uint8_t *rsp, int rsp_length)
+int _modbus_receive_msg(modbus_t *ctx, uint8_t *msg, msg_type_t msg_type)
 {
+    struct timeval tv;
+    uint64_t timeout;
     int rc;
-    int rsp_length_computed;
-    const int offset = ctx->backend->header_length;
-    const int function = rsp[offset];
+
+    /* An indication is not bound by the deadline of the last response sent */
+    if (msg_type == MSG_INDICATION) {
+        ctx->transaction_deadline = 0;
+    }
+
+    /* The response timeout learned for the slave when enabled */
+    timeout = _modbus_response_timeout(ctx, ctx->slave);
+    tv.tv_sec = timeout / 1000000;
+    tv.tv_usec = timeout % 1000000;
+
+    rc = receive_msg(ctx, msg, msg_type, &tv,
+                     msg_type == MSG_CONFIRMATION ?
+                     ctx->transaction_deadline : 0);
+    if (rc > 0) {
+        if (msg_type == MSG_CONFIRMATION) {
+            _modbus_stats_confirmation(ctx, ctx->stats_sent);
+        } else {
+            ctx->stats.requests++;
+        }
+    }
+
+    return rc;
+}
+
+/* Receive the request from a modbus master */
+int modbus_receive(modbus_t *ctx, uint8_t *req)
+{
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return ctx->backend->receive(ctx, req);
+}
+
+/* Receives the confirmation.
+
+   The function shall store the read response in rsp and return the number of
+   values (bits or words). Otherwise, its shall return -1 and errno is set.
+
+   The function doesn't check the confirmation is the expected response to the
+   initial request.
+*/
+int modbus_receive_confirmation(modbus_t *ctx, uint8_t *rsp)
+{
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return _modbus_receive_msg(ctx, rsp, MSG_CONFIRMATION);
+}
+
+static int check_confirmation(modbus_t *ctx, uint8_t *req,
+                              uint8_t *rsp, int rsp_length)
+{
+    int rc;
+    int rsp_length_computed;
+    const int offset = ctx->backend->header_length;
+    const int function = rsp[offset];
 
 	/* BEGIN QMODBUS MODIFICATION */
 	int s_crc = 0; /* TODO */
@@ -557,8 +1128,7 @@ static int check_confirmation(modbus_t *ctx, uint8_t *req,
         rc = ctx->backend->pre_check_confirmation(ctx, req, rsp, rsp_length);
         if (rc == -1) {
             if (ctx->error_recovery & MODBUS_ERROR_RECOVERY_PROTOCOL) {
-                _sleep_response_timeout(ctx);
-                modbus_flush(ctx);
+                flush_late_response(ctx, TRUE);
             }
             return -1;
         }
@@ -573,6 +1143,10 @@ static int check_confirmation(modbus_t *ctx, uint8_t *req,
             /* Valid exception code received */
 
             int exception_code = rsp[offset + 1];
+            ctx->stats.exceptions++;
+            ctx->stats.exceptions_by_function[req[offset] & 0x7F]++;
+            ctx->stats.exceptions_by_code[
+                exception_code < MODBUS_EXCEPTION_MAX ? exception_code : 0]++;
             if (exception_code < MODBUS_EXCEPTION_MAX) {
                 errno = MODBUS_ENOBASE + exception_code;
             } else {
@@ -602,8 +1176,7 @@ static int check_confirmation(modbus_t *ctx, uint8_t *req,
                         function, req[offset]);
             }
             if (ctx->error_recovery & MODBUS_ERROR_RECOVERY_PROTOCOL) {
-                _sleep_response_timeout(ctx);
-                modbus_flush(ctx);
+                flush_late_response(ctx, TRUE);
             }
             errno = EMBBADDATA;
             return -1;
@@ -694,8 +1267,7 @@ static int check_confirmation(modbus_t *ctx, uint8_t *req,
             }
 
             if (ctx->error_recovery & MODBUS_ERROR_RECOVERY_PROTOCOL) {
-                _sleep_response_timeout(ctx);
-                modbus_flush(ctx);
+                flush_late_response(ctx, TRUE);
             }
 
             errno = EMBBADDATA;
@@ -708,8 +1280,7 @@ static int check_confirmation(modbus_t *ctx, uint8_t *req,
                     rsp_length, rsp_length_computed);
         }
         if (ctx->error_recovery & MODBUS_ERROR_RECOVERY_PROTOCOL) {
-            _sleep_response_timeout(ctx);
-            modbus_flush(ctx);
+            flush_late_response(ctx, TRUE);
         }
         errno = EMBBADDATA;
         rc = -1;
@@ -718,6 +1289,12 @@ static int check_confirmation(modbus_t *ctx, uint8_t *req,
     return rc;
 }
 
+int _modbus_check_confirmation(modbus_t *ctx, uint8_t *req,
+                               uint8_t *rsp, int rsp_length)
+{
+    return check_confirmation(ctx, req, rsp, rsp_length);
+}
+
 static int response_io_status(uint8_t *tab_io_status,
                               int address, int nb,
                               uint8_t *rsp, int offset)
@@ -1075,7 +1652,7 @@ int modbus_reply(modbus_t *ctx, const uint8_t *req,
     }
 
     /* Suppress any responses when the request was a broadcast */
-    return (slave == MODBUS_BROADCAST_ADDRESS) ? 0 : send_msg(ctx, rsp, rsp_length);
+    return (slave == MODBUS_BROADCAST_ADDRESS) ? 0 : send_rsp(ctx, rsp, rsp_length);
 }
 
 int modbus_reply_exception(modbus_t *ctx, const uint8_t *req,
@@ -1106,51 +1683,68 @@ int modbus_reply_exception(modbus_t *ctx, const uint8_t *req,
     /* Positive exception code */
     if (exception_code < MODBUS_EXCEPTION_MAX) {
         rsp[rsp_length++] = exception_code;
-        return send_msg(ctx, rsp, rsp_length);
+        return send_rsp(ctx, rsp, rsp_length);
     } else {
         errno = EINVAL;
         return -1;
     }
 }
 
-/* Reads IO status */
-static int read_io_status(modbus_t *ctx, int function,
-                          int addr, int nb, uint8_t *dest)
+/* Reads IO status in rsp, the packed bits start at rsp + header_length + 2 */
+static int read_io_status_rsp(modbus_t *ctx, int function,
+                              int addr, int nb, uint8_t *rsp)
 {
     int rc;
     int req_length;
 
     uint8_t req[_MIN_REQ_LENGTH];
-    uint8_t rsp[MAX_MESSAGE_LENGTH];
 
     req_length = ctx->backend->build_request_basis(ctx, function, addr, nb, req);
 
     rc = send_msg(ctx, req, req_length);
     if (rc > 0) {
-        int i, temp, bit;
-        int pos = 0;
-        int offset;
-        int offset_end;
-
         rc = _modbus_receive_msg(ctx, rsp, MSG_CONFIRMATION);
         if (rc == -1)
             return -1;
 
         rc = check_confirmation(ctx, req, rsp, rc);
-        if (rc == -1)
-            return -1;
+    }
 
-        offset = ctx->backend->header_length + 2;
-        offset_end = offset + rc;
-        for (i = offset; i < offset_end; i++) {
-            /* Shift reg hi_byte to temp */
-            temp = rsp[i];
-
-            for (bit = 0x01; (bit & 0xff) && (pos < nb);) {
-                dest[pos++] = (temp & bit) ? TRUE : FALSE;
-                bit = bit << 1;
-            }
+    return rc;
+}
 
+/* Reads IO status */
+static int read_io_status(modbus_t *ctx, int function,
+                          int addr, int nb, uint8_t *dest)
+{
+    int rc;
+    uint8_t rsp[MAX_MESSAGE_LENGTH];
+
+    rc = read_io_status_rsp(ctx, function, addr, nb, rsp);
+    if (rc > 0) {
+        modbus_set_bits_from_bytes(dest, 0, nb,
+                                   rsp + ctx->backend->header_length + 2);
+    }
+
+    return rc;
+}
+
+/* Reads IO status and copies the bits packed as in the response (LSB of the
+   first byte for the first bit), the unused bits of the last byte are
+   cleared */
+static int read_io_status_packed(modbus_t *ctx, int function,
+                                 int addr, int nb, uint8_t *dest)
+{
+    int rc;
+    uint8_t rsp[MAX_MESSAGE_LENGTH];
+
+    rc = read_io_status_rsp(ctx, function, addr, nb, rsp);
+    if (rc > 0) {
+        int nb_bytes = (nb / 8) + ((nb % 8) ? 1 : 0);
+
+        memcpy(dest, rsp + ctx->backend->header_length + 2, nb_bytes);
+        if (nb % 8) {
+            dest[nb_bytes - 1] &= (1 << (nb % 8)) - 1;
         }
     }
 
@@ -1215,14 +1809,74 @@ int modbus_read_input_bits(modbus_t *ctx, int addr, int nb, uint8_t *dest)
         return nb;
 }
 
-/* Reads the data from a remove device and put that data into an array */
-static int read_registers(modbus_t *ctx, int function, int addr, int nb,
-                          uint16_t *dest)
+/* Same as modbus_read_bits but the bits are packed in bytes as sent by the
+   remote device (8 bits per byte, LSB first) */
+int modbus_read_bits_packed(modbus_t *ctx, int addr, int nb, uint8_t *dest)
+{
+    int rc;
+
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (nb > MODBUS_MAX_READ_BITS) {
+        if (ctx->debug) {
+            fprintf(stderr,
+                    "ERROR Too many bits requested (%d > %d)\n",
+                    nb, MODBUS_MAX_READ_BITS);
+        }
+        errno = EMBMDATA;
+        return -1;
+    }
+
+    rc = read_io_status_packed(ctx, MODBUS_FC_READ_COILS, addr, nb, dest);
+
+    if (rc == -1)
+        return -1;
+    else
+        return nb;
+}
+
+/* Same as modbus_read_input_bits but the bits are packed in bytes as sent by
+   the remote device (8 bits per byte, LSB first) */
+int modbus_read_input_bits_packed(modbus_t *ctx, int addr, int nb,
+                                  uint8_t *dest)
+{
+    int rc;
+
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (nb > MODBUS_MAX_READ_BITS) {
+        if (ctx->debug) {
+            fprintf(stderr,
+                    "ERROR Too many discrete inputs requested (%d > %d)\n",
+                    nb, MODBUS_MAX_READ_BITS);
+        }
+        errno = EMBMDATA;
+        return -1;
+    }
+
+    rc = read_io_status_packed(ctx, MODBUS_FC_READ_DISCRETE_INPUTS,
+                               addr, nb, dest);
+
+    if (rc == -1)
+        return -1;
+    else
+        return nb;
+}
+
+/* Reads the registers in rsp, the big-endian values start at
+   rsp + header_length + 2 */
+static int read_registers_rsp(modbus_t *ctx, int function, int addr, int nb,
+                              uint8_t *rsp)
 {
     int rc;
     int req_length;
     uint8_t req[_MIN_REQ_LENGTH];
-    uint8_t rsp[MAX_MESSAGE_LENGTH];
 
     if (nb > MODBUS_MAX_READ_REGISTERS) {
         if (ctx->debug) {
@@ -1238,24 +1892,47 @@ static int read_registers(modbus_t *ctx, int function, int addr, int nb,
 
     rc = send_msg(ctx, req, req_length);
     if (rc > 0) {
-        int offset;
-        int i;
-
         rc = _modbus_receive_msg(ctx, rsp, MSG_CONFIRMATION);
         if (rc == -1)
             return -1;
 
         rc = check_confirmation(ctx, req, rsp, rc);
-        if (rc == -1)
-            return -1;
+    }
 
-        offset = ctx->backend->header_length;
+    return rc;
+}
 
-        for (i = 0; i < rc; i++) {
-            /* shift reg hi_byte to temp OR with lo_byte */
-            dest[i] = (rsp[offset + 2 + (i << 1)] << 8) |
-                rsp[offset + 3 + (i << 1)];
-        }
+/* Reads the data from a remove device and put that data into an array */
+static int read_registers(modbus_t *ctx, int function, int addr, int nb,
+                          uint16_t *dest)
+{
+    int rc;
+    uint8_t rsp[MAX_MESSAGE_LENGTH];
+
+    rc = read_registers_rsp(ctx, function, addr, nb, rsp);
+    if (rc > 0) {
+        modbus_set_registers_from_bytes(
+            dest, rsp + ctx->backend->header_length + 2, rc);
+    }
+
+    return rc;
+}
+
+/* Reads the registers in the response buffer of the context and points data
+   to their big-endian values, without any copy nor conversion */
+static int read_registers_view(modbus_t *ctx, int function, int addr, int nb,
+                               const uint8_t **data)
+{
+    int rc;
+
+    if (ctx == NULL || data == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    rc = read_registers_rsp(ctx, function, addr, nb, ctx->rsp);
+    if (rc > 0) {
+        *data = ctx->rsp + ctx->backend->header_length + 2;
     }
 
     return rc;
@@ -1312,6 +1989,24 @@ int modbus_read_input_registers(modbus_t *ctx, int addr, int nb,
     return status;
 }
 
+/* Reads the holding registers of remote device, data points to their
+   big-endian values in the context until the next request */
+int modbus_read_registers_view(modbus_t *ctx, int addr, int nb,
+                               const uint8_t **data)
+{
+    return read_registers_view(ctx, MODBUS_FC_READ_HOLDING_REGISTERS,
+                               addr, nb, data);
+}
+
+/* Reads the input registers of remote device, data points to their
+   big-endian values in the context until the next request */
+int modbus_read_input_registers_view(modbus_t *ctx, int addr, int nb,
+                                     const uint8_t **data)
+{
+    return read_registers_view(ctx, MODBUS_FC_READ_INPUT_REGISTERS,
+                               addr, nb, data);
+}
+
 /* Write a value to the specified register of the remote device.
    Used by write_bit and write_register */
 static int write_single(modbus_t *ctx, int function, int addr, int value)
@@ -1571,8 +2266,6 @@ int modbus_write_and_read_registers(modbus_t *ctx,
 
     rc = send_msg(ctx, req, req_length);
     if (rc > 0) {
-        int offset;
-
         rc = _modbus_receive_msg(ctx, rsp, MSG_CONFIRMATION);
         if (rc == -1)
             return -1;
@@ -1581,12 +2274,8 @@ int modbus_write_and_read_registers(modbus_t *ctx,
         if (rc == -1)
             return -1;
 
-        offset = ctx->backend->header_length;
-        for (i = 0; i < rc; i++) {
-            /* shift reg hi_byte to temp OR with lo_byte */
-            dest[i] = (rsp[offset + 2 + (i << 1)] << 8) |
-                rsp[offset + 3 + (i << 1)];
-        }
+        modbus_set_registers_from_bytes(
+            dest, rsp + ctx->backend->header_length + 2, rc);
     }
 
     return rc;
@@ -1681,6 +2370,378 @@ MODBUS_API int modbus_read_file_record(modbus_t *ctx, int file, int record, int
     return rc;
 }
 
+/*
+ * Pipelined requests
+ *
+ * The modbus_submit_* functions send a request without waiting for its
+ * confirmation, up to the window set by modbus_set_max_in_flight(). The
+ * confirmations are then collected in any order by modbus_complete(): each
+ * one is matched to its request by transaction identifier (TCP) before the
+ * usual checks of check_confirmation().
+ */
+
+/* Maximum number of requests in flight on one context */
+#define MAX_IN_FLIGHT 256
+
+struct _modbus_in_flight {
+    int used;
+    int t_id;
+    int function;
+    int nb;
+    void *dest;
+    /* Absolute times (see _modbus_time_us) of the sending and of the
+       response timeout */
+    uint64_t sent;
+    uint64_t deadline;
+    int req_length;
+    uint8_t req[MAX_MESSAGE_LENGTH];
+};
+
+static void release_in_flight(modbus_t *ctx, struct _modbus_in_flight *entry)
+{
+    entry->used = FALSE;
+    ctx->nb_in_flight--;
+}
+
+static void release_all_in_flight(modbus_t *ctx)
+{
+    int i;
+
+    for (i = 0; i < ctx->max_in_flight; i++) {
+        ctx->in_flight[i].used = FALSE;
+    }
+    ctx->nb_in_flight = 0;
+}
+
+int modbus_set_max_in_flight(modbus_t *ctx, int nb)
+{
+    struct _modbus_in_flight *in_flight;
+
+    if (ctx == NULL || nb < 1 || nb > MAX_IN_FLIGHT) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* Without transaction identifier, a serial line can't match more than one
+       confirmation */
+    if (nb > 1 && ctx->backend->backend_type != _MODBUS_BACKEND_TYPE_TCP) {
+        if (ctx->debug) {
+            fprintf(stderr, "ERROR Only one request in flight on a serial line\n");
+        }
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (ctx->nb_in_flight > 0) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    in_flight = (struct _modbus_in_flight *)realloc(
+        ctx->in_flight, nb * sizeof(struct _modbus_in_flight));
+    if (in_flight == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memset(in_flight, 0, nb * sizeof(struct _modbus_in_flight));
+
+    ctx->in_flight = in_flight;
+    ctx->max_in_flight = nb;
+    return 0;
+}
+
+int modbus_get_in_flight(modbus_t *ctx)
+{
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return ctx->nb_in_flight;
+}
+
+/* Sends the request and records it in a free slot of the window. Returns the
+   transaction identifier of the request. */
+static int submit_request(modbus_t *ctx, uint8_t *req, int req_length,
+                          int nb, void *dest)
+{
+    struct _modbus_in_flight *entry = NULL;
+    int dummy_length = req_length;
+    uint64_t timeout;
+    int rc;
+    int i;
+
+    if (ctx->in_flight == NULL && modbus_set_max_in_flight(ctx, 1) == -1) {
+        return -1;
+    }
+
+    for (i = 0; i < ctx->max_in_flight; i++) {
+        if (!ctx->in_flight[i].used) {
+            entry = &ctx->in_flight[i];
+            break;
+        }
+    }
+
+    if (entry == NULL) {
+        /* The window is full, modbus_complete() must be called first */
+        errno = EAGAIN;
+        return -1;
+    }
+
+    rc = send_msg(ctx, req, req_length);
+    if (rc == -1)
+        return -1;
+
+    timeout = _modbus_response_timeout(ctx, ctx->slave);
+
+    entry->used = TRUE;
+    entry->t_id = ctx->backend->prepare_response_tid(req, &dummy_length);
+    entry->function = req[ctx->backend->header_length];
+    entry->nb = nb;
+    entry->dest = dest;
+    entry->sent = ctx->stats_sent;
+    entry->deadline = entry->sent + timeout;
+    /* send_msg has completed the request (length or CRC) */
+    entry->req_length = rc;
+    memcpy(entry->req, req, rc);
+    ctx->nb_in_flight++;
+
+    return entry->t_id;
+}
+
+static int submit_read_io_status(modbus_t *ctx, int function,
+                                 int addr, int nb, uint8_t *dest)
+{
+    uint8_t req[_MIN_REQ_LENGTH];
+    int req_length;
+
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (nb > MODBUS_MAX_READ_BITS) {
+        if (ctx->debug) {
+            fprintf(stderr, "ERROR Too many bits requested (%d > %d)\n",
+                    nb, MODBUS_MAX_READ_BITS);
+        }
+        errno = EMBMDATA;
+        return -1;
+    }
+
+    req_length = ctx->backend->build_request_basis(ctx, function, addr, nb, req);
+    return submit_request(ctx, req, req_length, nb, dest);
+}
+
+static int submit_read_registers(modbus_t *ctx, int function,
+                                 int addr, int nb, uint16_t *dest)
+{
+    uint8_t req[_MIN_REQ_LENGTH];
+    int req_length;
+
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (nb > MODBUS_MAX_READ_REGISTERS) {
+        if (ctx->debug) {
+            fprintf(stderr, "ERROR Too many registers requested (%d > %d)\n",
+                    nb, MODBUS_MAX_READ_REGISTERS);
+        }
+        errno = EMBMDATA;
+        return -1;
+    }
+
+    req_length = ctx->backend->build_request_basis(ctx, function, addr, nb, req);
+    return submit_request(ctx, req, req_length, nb, dest);
+}
+
+int modbus_submit_read_bits(modbus_t *ctx, int addr, int nb, uint8_t *dest)
+{
+    return submit_read_io_status(ctx, MODBUS_FC_READ_COILS, addr, nb, dest);
+}
+
+int modbus_submit_read_input_bits(modbus_t *ctx, int addr, int nb,
+                                  uint8_t *dest)
+{
+    return submit_read_io_status(ctx, MODBUS_FC_READ_DISCRETE_INPUTS,
+                                 addr, nb, dest);
+}
+
+int modbus_submit_read_registers(modbus_t *ctx, int addr, int nb,
+                                 uint16_t *dest)
+{
+    return submit_read_registers(ctx, MODBUS_FC_READ_HOLDING_REGISTERS,
+                                 addr, nb, dest);
+}
+
+int modbus_submit_read_input_registers(modbus_t *ctx, int addr, int nb,
+                                       uint16_t *dest)
+{
+    return submit_read_registers(ctx, MODBUS_FC_READ_INPUT_REGISTERS,
+                                 addr, nb, dest);
+}
+
+int modbus_submit_write_register(modbus_t *ctx, int addr, int value)
+{
+    uint8_t req[_MIN_REQ_LENGTH];
+    int req_length;
+
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    req_length = ctx->backend->build_request_basis(
+        ctx, MODBUS_FC_WRITE_SINGLE_REGISTER, addr, value, req);
+    return submit_request(ctx, req, req_length, 1, NULL);
+}
+
+int modbus_submit_write_registers(modbus_t *ctx, int addr, int nb,
+                                  const uint16_t *src)
+{
+    uint8_t req[MAX_MESSAGE_LENGTH];
+    int req_length;
+    int i;
+
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (nb > MODBUS_MAX_WRITE_REGISTERS) {
+        if (ctx->debug) {
+            fprintf(stderr,
+                    "ERROR Trying to write to too many registers (%d > %d)\n",
+                    nb, MODBUS_MAX_WRITE_REGISTERS);
+        }
+        errno = EMBMDATA;
+        return -1;
+    }
+
+    req_length = ctx->backend->build_request_basis(
+        ctx, MODBUS_FC_WRITE_MULTIPLE_REGISTERS, addr, nb, req);
+    req[req_length++] = nb * 2;
+
+    for (i = 0; i < nb; i++) {
+        req[req_length++] = src[i] >> 8;
+        req[req_length++] = src[i] & 0x00FF;
+    }
+
+    return submit_request(ctx, req, req_length, nb, NULL);
+}
+
+/* Waits for the next confirmation of a request in flight, or for the
+   expiration of the oldest one, and stores its transaction identifier in
+   t_id. The function returns the number of values of the completed request
+   or -1 with errno set (t_id is set to -1 when the connection is lost and all
+   the requests in flight are dropped). */
+int modbus_complete(modbus_t *ctx, int *t_id)
+{
+    uint8_t rsp[MAX_MESSAGE_LENGTH];
+    const int offset = (ctx != NULL) ? (int)ctx->backend->header_length : 0;
+
+    if (ctx == NULL || t_id == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    *t_id = -1;
+
+    if (ctx->nb_in_flight == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (;;) {
+        struct _modbus_in_flight *entry = NULL;
+        struct timeval tv;
+        uint64_t now;
+        int dummy_length;
+        int rsp_t_id;
+        int rc;
+        int i;
+
+        /* Oldest deadline */
+        for (i = 0; i < ctx->max_in_flight; i++) {
+            if (ctx->in_flight[i].used &&
+                (entry == NULL || ctx->in_flight[i].deadline < entry->deadline)) {
+                entry = &ctx->in_flight[i];
+            }
+        }
+
+        now = _modbus_time_us();
+        if (entry->deadline <= now) {
+            *t_id = entry->t_id;
+            release_in_flight(ctx, entry);
+            errno = ETIMEDOUT;
+            _error_print(ctx, "request in flight");
+            return -1;
+        }
+
+        tv.tv_sec = (entry->deadline - now) / 1000000;
+        tv.tv_usec = (entry->deadline - now) % 1000000;
+        rc = receive_msg(ctx, rsp, MSG_CONFIRMATION, &tv, 0);
+        if (rc == -1) {
+            if (ctx->s == -1 || errno == ECONNRESET || errno == ECONNREFUSED ||
+                errno == EBADF) {
+                /* The confirmations can't be received anymore */
+                release_all_in_flight(ctx);
+                return -1;
+            }
+            /* The other requests may still be answered, the oldest one
+               expires on the next iteration once its deadline is passed */
+            continue;
+        }
+
+        dummy_length = rc;
+        rsp_t_id = ctx->backend->prepare_response_tid(rsp, &dummy_length);
+        entry = NULL;
+        for (i = 0; i < ctx->max_in_flight; i++) {
+            if (ctx->in_flight[i].used && ctx->in_flight[i].t_id == rsp_t_id) {
+                entry = &ctx->in_flight[i];
+                break;
+            }
+        }
+
+        if (entry == NULL) {
+            /* Late confirmation of an expired request */
+            if (ctx->debug) {
+                fprintf(stderr, "No request in flight for transaction ID 0x%X\n",
+                        rsp_t_id);
+            }
+            continue;
+        }
+
+        *t_id = entry->t_id;
+        _modbus_stats_confirmation(ctx, entry->sent);
+
+        /* Released once checked, the error recovery counts it in flight */
+        rc = check_confirmation(ctx, entry->req, rsp, rc);
+        release_in_flight(ctx, entry);
+        if (rc == -1)
+            return -1;
+
+        switch (entry->function) {
+        case MODBUS_FC_READ_COILS:
+        case MODBUS_FC_READ_DISCRETE_INPUTS:
+            modbus_set_bits_from_bytes(entry->dest, 0, entry->nb,
+                                       rsp + offset + 2);
+            rc = entry->nb;
+            break;
+        case MODBUS_FC_READ_HOLDING_REGISTERS:
+        case MODBUS_FC_READ_INPUT_REGISTERS:
+            modbus_set_registers_from_bytes(entry->dest, rsp + offset + 2, rc);
+            break;
+        default:
+            break;
+        }
+
+        return rc;
+    }
+}
+
 void _modbus_init_common(modbus_t *ctx)
 {
     /* Slave and socket are initialized to -1 */
@@ -1695,6 +2756,31 @@ void _modbus_init_common(modbus_t *ctx)
 
     ctx->byte_timeout.tv_sec = 0;
     ctx->byte_timeout.tv_usec = _BYTE_TIMEOUT;
+
+    ctx->transaction_timeout.tv_sec = 0;
+    ctx->transaction_timeout.tv_usec = 0;
+    ctx->transaction_deadline = 0;
+
+    ctx->rto_floor = 0;
+    ctx->rto_ceiling = 0;
+    memset(ctx->rtt, 0, sizeof(ctx->rtt));
+
+    memset(&ctx->stats, 0, sizeof(modbus_stats_t));
+    ctx->stats_sent = 0;
+    ctx->stats_first_byte = 0;
+
+    ctx->rx_buffering = TRUE;
+    ctx->rx_start = 0;
+    ctx->rx_length = 0;
+
+    ctx->in_flight = NULL;
+    ctx->max_in_flight = 0;
+    ctx->nb_in_flight = 0;
+
+    /* -- BEGIN QMODBUS MODIFICATION -- */
+    ctx->monitor_add_item = NULL;
+    ctx->monitor_raw_data = NULL;
+    /* -- END QMODBUS MODIFICATION -- */
 }
 
 /* Define the slave number */
@@ -1739,6 +2825,8 @@ int modbus_set_socket(modbus_t *ctx, int s)
     }
 
     ctx->s = s;
+    /* Buffered bytes belong to the previous socket */
+    ctx->rx_start = ctx->rx_length = 0;
     return 0;
 }
 
@@ -1778,6 +2866,80 @@ int modbus_set_response_timeout(modbus_t *ctx, uint32_t to_sec, uint32_t to_usec
     return 0;
 }
 
+/* Get the timeout interval of a whole transaction */
+int modbus_get_transaction_timeout(modbus_t *ctx, uint32_t *to_sec,
+                                   uint32_t *to_usec)
+{
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    *to_sec = ctx->transaction_timeout.tv_sec;
+    *to_usec = ctx->transaction_timeout.tv_usec;
+    return 0;
+}
+
+int modbus_set_transaction_timeout(modbus_t *ctx, uint32_t to_sec,
+                                   uint32_t to_usec)
+{
+    /* Transaction timeout is disabled when both values are zero */
+    if (ctx == NULL || to_usec > 999999) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ctx->transaction_timeout.tv_sec = to_sec;
+    ctx->transaction_timeout.tv_usec = to_usec;
+    return 0;
+}
+
+/* Get the bounds of the response timeout learned per slave */
+int modbus_get_adaptive_timeout(modbus_t *ctx, uint32_t *floor_usec,
+                                uint32_t *ceiling_usec)
+{
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    *floor_usec = ctx->rto_floor;
+    *ceiling_usec = ctx->rto_ceiling;
+    return 0;
+}
+
+int modbus_set_adaptive_timeout(modbus_t *ctx, uint32_t floor_usec,
+                                uint32_t ceiling_usec)
+{
+    /* Adaptive timeout is disabled when both values are zero */
+    if (ctx == NULL || floor_usec > ceiling_usec ||
+        (floor_usec == 0 && ceiling_usec > 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ctx->rto_floor = floor_usec;
+    ctx->rto_ceiling = ceiling_usec;
+    return 0;
+}
+
+/* Get the response timeout currently applied to a slave */
+int modbus_get_slave_response_timeout(modbus_t *ctx, int slave,
+                                      uint32_t *to_sec, uint32_t *to_usec)
+{
+    uint64_t timeout;
+
+    if (ctx == NULL || slave < 0 || slave > 255) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    timeout = _modbus_response_timeout(ctx, slave);
+    *to_sec = (uint32_t)(timeout / 1000000);
+    *to_usec = (uint32_t)(timeout % 1000000);
+    return 0;
+}
+
 /* Get the timeout interval between two consecutive bytes of a message */
 int modbus_get_byte_timeout(modbus_t *ctx, uint32_t *to_sec, uint32_t *to_usec)
 {
@@ -1821,6 +2983,11 @@ int modbus_connect(modbus_t *ctx)
         return -1;
     }
 
+    ctx->rx_start = ctx->rx_length = 0;
+    if (ctx->in_flight != NULL) {
+        release_all_in_flight(ctx);
+    }
+
     return ctx->backend->connect(ctx);
 }
 
@@ -1829,6 +2996,11 @@ void modbus_close(modbus_t *ctx)
     if (ctx == NULL)
         return;
 
+    ctx->rx_start = ctx->rx_length = 0;
+    if (ctx->in_flight != NULL) {
+        /* No confirmation can be received anymore */
+        release_all_in_flight(ctx);
+    }
     ctx->backend->close(ctx);
 }
 
@@ -1837,6 +3009,7 @@ void modbus_free(modbus_t *ctx)
     if (ctx == NULL)
         return;
 
+    free(ctx->in_flight);
     ctx->backend->free(ctx);
 }
 
@@ -1851,6 +3024,23 @@ int modbus_set_debug(modbus_t *ctx, int flag)
     return 0;
 }
 
+/* Enables (default) or disables the read-ahead of confirmations in the
+   receive buffer. When disabled, each step of the message is read with its
+   own system call. */
+int modbus_set_rx_buffering(modbus_t *ctx, int flag)
+{
+    if (ctx == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ctx->rx_buffering = flag;
+    if (!flag) {
+        ctx->rx_start = ctx->rx_length = 0;
+    }
+    return 0;
+}
+
 /* Allocates 4 arrays to store bits, input bits, registers and inputs
    registers. The pointers are stored in modbus_mapping structure.
 
@@ -2019,21 +3209,46 @@ void modbus_register_monitor_raw_data_fnc(modbus_t *ctx,
 void modbus_poll(modbus_t* ctx)
 {
 	uint8_t msg[MAX_MESSAGE_LENGTH];
-	uint8_t msg_len = 0;
+	struct timeval tv;
+	int msg_len;
+	int ret;
 
     	if (ctx == NULL) {
         	return;
     	}
 
-	modbus_set_response_timeout( ctx, 0, 500);
-	const int ret = _modbus_receive_msg( ctx, &msg_len, MSG_CONFIRMATION );	/* wait for 0.5 ms */
-	modbus_set_response_timeout( ctx, 0, _RESPONSE_TIMEOUT);
-	if( ( ret < 0 && msg_len > 0 ) || ret >= 0 )
+	/* wait for 0.5 ms for the start of a frame, the response timeout set
+	   by the user is left untouched */
+	tv.tv_sec = 0;
+	tv.tv_usec = 500;
+	if( ctx->rx_length == 0 && ctx->backend->select( ctx, &tv, 1 ) == -1 )
+	{
+		return;
+	}
+
+	/* read without counting a confirmation, no request has been sent */
+	ret = receive_msg( ctx, msg, MSG_CONFIRMATION, &ctx->response_timeout, 0 );
+	if( ret > 0 )
+	{
+		msg_len = ret;
+	}
+	else if( ret == 0 || errno == EMBBADCRC )
+	{
+		/* frame for another slave or with a wrong CRC, its length is
+		   found again from its header */
+		msg_len = _modbus_frame_length( ctx->backend, msg, MAX_MESSAGE_LENGTH, MSG_CONFIRMATION );
+	}
+	else
+	{
+		msg_len = 0;
+	}
+	if( msg_len > 0 )
 	{
+		/* the slave is the last byte of the header, the PDU follows */
 		const int o = ctx->backend->header_length;
-		const int slave = msg[o+0];
-		const int func = msg[o+1];
-		const int datalen = msg_len - ctx->backend->header_length - ctx->backend->checksum_length - 2;
+		const int slave = msg[o-1];
+		const int func = msg[o];
+		const int datalen = msg_len - ctx->backend->header_length - ctx->backend->checksum_length - 1;
 		int addr = 0;
 		int nb = -1;
 		int isQuery = 1;
@@ -2041,7 +3256,7 @@ void modbus_poll(modbus_t* ctx)
 		{
 			case MODBUS_FC_READ_COILS:
 			case MODBUS_FC_READ_DISCRETE_INPUTS:
-				if( msg[o+2] == datalen-1 )
+				if( msg[o+1] == datalen-1 )
 				{
 					isQuery = 0;
 					nb = (datalen-1) * 8;
@@ -2049,7 +3264,7 @@ void modbus_poll(modbus_t* ctx)
 				break;
 			case MODBUS_FC_READ_HOLDING_REGISTERS:
 			case MODBUS_FC_READ_INPUT_REGISTERS:
-				if( msg[o+2] == datalen-1 )
+				if( msg[o+1] == datalen-1 )
 				{
 					isQuery = 0;
 					nb = (datalen-1) / 2;
@@ -2060,7 +3275,7 @@ void modbus_poll(modbus_t* ctx)
 				/* can't decide from message whether it is a query or response */
 				isQuery = 0;
 				nb = 1;
-				addr = ( msg[o+2] << 8 ) | msg[o+3];
+				addr = ( msg[o+1] << 8 ) | msg[o+2];
 				break;
 			case MODBUS_FC_REPORT_SLAVE_ID:
 				nb = 0;
@@ -2073,8 +3288,8 @@ void modbus_poll(modbus_t* ctx)
 		}
 		if( nb == -1 )	/* is query or a write-response? */
 		{
-			addr = ( msg[o+2] << 8 ) | msg[o+3];
-			nb = ( msg[o+4] << 8 ) | msg[o+5];
+			addr = ( msg[o+1] << 8 ) | msg[o+2];
+			nb = ( msg[o+3] << 8 ) | msg[o+4];
 		}
 		if (ctx->monitor_add_item) {
 			ctx->monitor_add_item(ctx, isQuery,				/* is query */
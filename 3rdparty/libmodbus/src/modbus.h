@@ -174,9 +174,46 @@ typedef enum
 {
     MODBUS_ERROR_RECOVERY_NONE          = 0,
     MODBUS_ERROR_RECOVERY_LINK          = (1<<1),
-    MODBUS_ERROR_RECOVERY_PROTOCOL      = (1<<2)
+    MODBUS_ERROR_RECOVERY_PROTOCOL      = (1<<2),
+    MODBUS_ERROR_RECOVERY_RESYNC        = (1<<3)
 } modbus_error_recovery_mode;
 
+/* Number of buckets of a latency histogram: one per microsecond below 8 us,
+   then 8 per power of two up to 2^32 us */
+#define MODBUS_LATENCY_BUCKETS 240
+
+typedef struct {
+    uint64_t count;
+    /* Sum, minimum and maximum in microseconds */
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[MODBUS_LATENCY_BUCKETS];
+} modbus_latency_t;
+
+typedef struct {
+    /* Requests sent and confirmations received by a client, indications
+       received and responses sent by a server */
+    uint64_t requests;
+    uint64_t responses;
+    uint64_t timeouts;
+    uint64_t crc_errors;
+    /* Bytes dropped to reach the next valid RTU frame after an invalid one
+       (MODBUS_ERROR_RECOVERY_RESYNC) */
+    uint64_t resync_bytes;
+    /* Exception responses received, by function code and by exception code
+       (index 0 for the unknown codes) */
+    uint64_t exceptions;
+    uint64_t exceptions_by_function[128];
+    uint64_t exceptions_by_code[MODBUS_EXCEPTION_MAX];
+    uint64_t bytes_out;
+    uint64_t bytes_in;
+    /* From the end of the sending of a request to the first byte and to the
+       last byte of its confirmation */
+    modbus_latency_t first_byte_latency;
+    modbus_latency_t response_latency;
+} modbus_stats_t;
+
 typedef void (*modbus_monitor_add_item_fnc_t)(modbus_t *ctx,
         uint8_t isOut, uint8_t slave, uint8_t func, uint16_t addr, uint16_t nb,
         uint16_t expectedCRC, uint16_t actualCRC );
@@ -194,6 +231,21 @@ MODBUS_API int modbus_set_response_timeout(modbus_t *ctx, uint32_t to_sec, uint3
 MODBUS_API int modbus_get_byte_timeout(modbus_t *ctx, uint32_t *to_sec, uint32_t *to_usec);
 MODBUS_API int modbus_set_byte_timeout(modbus_t *ctx, uint32_t to_sec, uint32_t to_usec);
 
+MODBUS_API int modbus_get_transaction_timeout(modbus_t *ctx, uint32_t *to_sec, uint32_t *to_usec);
+MODBUS_API int modbus_set_transaction_timeout(modbus_t *ctx, uint32_t to_sec, uint32_t to_usec);
+
+MODBUS_API int modbus_get_adaptive_timeout(modbus_t *ctx, uint32_t *floor_usec, uint32_t *ceiling_usec);
+MODBUS_API int modbus_set_adaptive_timeout(modbus_t *ctx, uint32_t floor_usec, uint32_t ceiling_usec);
+MODBUS_API int modbus_get_slave_response_timeout(modbus_t *ctx, int slave,
+                                                 uint32_t *to_sec, uint32_t *to_usec);
+
+MODBUS_API int modbus_get_stats(modbus_t *ctx, modbus_stats_t *stats);
+MODBUS_API int modbus_reset_stats(modbus_t *ctx);
+MODBUS_API uint64_t modbus_latency_percentile(const modbus_latency_t *latency, double percentile);
+MODBUS_API int modbus_measure_turnaround(modbus_t *ctx, int addr, int nb_samples,
+                                         modbus_latency_t *first_byte,
+                                         modbus_latency_t *response);
+
 MODBUS_API int modbus_get_header_length(modbus_t *ctx);
 
 MODBUS_API int modbus_connect(modbus_t *ctx);
@@ -203,13 +255,18 @@ MODBUS_API void modbus_free(modbus_t *ctx);
 
 MODBUS_API int modbus_flush(modbus_t *ctx);
 MODBUS_API int modbus_set_debug(modbus_t *ctx, int flag);
+MODBUS_API int modbus_set_rx_buffering(modbus_t *ctx, int flag);
 
 MODBUS_API const char *modbus_strerror(int errnum);
 
 MODBUS_API int modbus_read_bits(modbus_t *ctx, int addr, int nb, uint8_t *dest);
 MODBUS_API int modbus_read_input_bits(modbus_t *ctx, int addr, int nb, uint8_t *dest);
+MODBUS_API int modbus_read_bits_packed(modbus_t *ctx, int addr, int nb, uint8_t *dest);
+MODBUS_API int modbus_read_input_bits_packed(modbus_t *ctx, int addr, int nb, uint8_t *dest);
 MODBUS_API int modbus_read_registers(modbus_t *ctx, int addr, int nb, uint16_t *dest);
 MODBUS_API int modbus_read_input_registers(modbus_t *ctx, int addr, int nb, uint16_t *dest);
+MODBUS_API int modbus_read_registers_view(modbus_t *ctx, int addr, int nb, const uint8_t **data);
+MODBUS_API int modbus_read_input_registers_view(modbus_t *ctx, int addr, int nb, const uint8_t **data);
 MODBUS_API int modbus_write_bit(modbus_t *ctx, int coil_addr, int status);
 MODBUS_API int modbus_write_register(modbus_t *ctx, int reg_addr, int value);
 MODBUS_API int modbus_write_bits(modbus_t *ctx, int addr, int nb, const uint8_t *data);
@@ -221,6 +278,16 @@ MODBUS_API int modbus_write_and_read_registers(modbus_t *ctx, int write_addr, in
 MODBUS_API int modbus_report_slave_id(modbus_t *ctx, int max_dest, uint8_t *dest);
 MODBUS_API int modbus_read_file_record(modbus_t *ctx, int file, int record, int nb, uint16_t *dest);
 
+MODBUS_API int modbus_set_max_in_flight(modbus_t *ctx, int nb);
+MODBUS_API int modbus_get_in_flight(modbus_t *ctx);
+MODBUS_API int modbus_submit_read_bits(modbus_t *ctx, int addr, int nb, uint8_t *dest);
+MODBUS_API int modbus_submit_read_input_bits(modbus_t *ctx, int addr, int nb, uint8_t *dest);
+MODBUS_API int modbus_submit_read_registers(modbus_t *ctx, int addr, int nb, uint16_t *dest);
+MODBUS_API int modbus_submit_read_input_registers(modbus_t *ctx, int addr, int nb, uint16_t *dest);
+MODBUS_API int modbus_submit_write_register(modbus_t *ctx, int reg_addr, int value);
+MODBUS_API int modbus_submit_write_registers(modbus_t *ctx, int addr, int nb, const uint16_t *data);
+MODBUS_API int modbus_complete(modbus_t *ctx, int *t_id);
+
 MODBUS_API modbus_mapping_t* modbus_mapping_new_start_address(
     unsigned int start_bits, unsigned int nb_bits,
     unsigned int start_input_bits, unsigned int nb_input_bits,
@@ -286,6 +353,8 @@ MODBUS_API void modbus_set_bits_from_byte(uint8_t *dest, int idx, const uint8_t
 MODBUS_API void modbus_set_bits_from_bytes(uint8_t *dest, int idx, unsigned int nb_bits,
                                        const uint8_t *tab_byte);
 MODBUS_API uint8_t modbus_get_byte_from_bits(const uint8_t *src, int idx, unsigned int nb_bits);
+MODBUS_API void modbus_set_registers_from_bytes(uint16_t *dest, const uint8_t *src,
+                                                unsigned int nb_registers);
 MODBUS_API float modbus_get_float(const uint16_t *src);
 MODBUS_API float modbus_get_float_abcd(const uint16_t *src);
 MODBUS_API float modbus_get_float_dcba(const uint16_t *src);
@@ -300,6 +369,13 @@ MODBUS_API void modbus_set_float_cdab(float f, uint16_t *dest);
 
 #include "modbus-tcp.h"
 #include "modbus-rtu.h"
+#include "modbus-ascii.h"
+#include "modbus-reactor.h"
+#include "modbus-parser.h"
+#include "modbus-scheduler.h"
+#include "modbus-gateway.h"
+#include "modbus-server.h"
+#include "modbus-uring.h"
 
 MODBUS_END_DECLS
 
@@ -0,0 +1,219 @@
+/*
+ * Copyright © 2008-2014 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <modbus.h>
+
+#include "pty-fixture.h"
+
+#define SERVER_ID 1
+#define RUN_MS 1000
+
+enum {
+    RTU,
+    ASCII
+};
+
+/* 0 for the speed of the pseudo terminal */
+static const int bauds[] = { 9600, 19200, 38400, 57600, 115200, 0 };
+
+static uint64_t cputime_us(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+        usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static modbus_t *new_ctx(int mode, const char *device, int baud)
+{
+    /* The baud rate of a pseudo terminal is ignored */
+    if (baud == 0)
+        baud = 115200;
+
+    if (mode == RTU) {
+        return modbus_new_rtu(device, baud, 'E', 8, 1);
+    } else {
+        return modbus_new_ascii(device, baud, 'E', 7, 1);
+    }
+}
+
+/* Characters on the line for a binary frame of length bytes (with its CRC in
+   RTU, its LRC in ASCII), the t3.5 silence after a RTU frame included */
+static double line_chars(int mode, int length)
+{
+    return (mode == RTU) ? length + 3.5 : 1 + 2 * length + 2;
+}
+
+/* Time to send one character with a start bit, the data bits, the even
+   parity and a stop bit */
+static double char_time_us(int mode, int baud)
+{
+    return ((mode == RTU) ? 11 : 10) * 1000000.0 / baud;
+}
+
+/* Simulated slave answering on the master side of the pseudo terminal. At a
+   given baud rate, each response is held for the time the request and the
+   response would take on the line */
+static void run_slave(int mode, int pty, int baud, int nb)
+{
+    uint8_t query[MODBUS_RTU_MAX_ADU_LENGTH];
+    modbus_mapping_t *mb_mapping;
+    modbus_t *ctx;
+    /* Slave, function, byte count, the registers and the checksum */
+    int rsp_length = 3 + 2 * nb + ((mode == RTU) ? 2 : 1);
+    int i;
+
+    ctx = new_ctx(mode, "/dev/null", baud);
+    modbus_set_slave(ctx, SERVER_ID);
+    modbus_set_socket(ctx, pty);
+
+    mb_mapping = modbus_mapping_new(0, 0, MODBUS_MAX_READ_REGISTERS, 0);
+    if (mb_mapping == NULL) {
+        _exit(1);
+    }
+    for (i = 0; i < MODBUS_MAX_READ_REGISTERS; i++) {
+        mb_mapping->tab_registers[i] = i;
+    }
+
+    for (;;) {
+        int rc = pty_receive(ctx, query);
+
+        if (baud > 0) {
+            double line_us = (line_chars(mode, rc) + line_chars(mode, rsp_length)) *
+                char_time_us(mode, baud);
+            usleep((useconds_t)line_us);
+        }
+
+        modbus_reply(ctx, query, rc, mb_mapping);
+    }
+}
+
+typedef struct {
+    int transactions;
+    int errors;
+    double rate;
+    /* CPU time of the client for a transaction in microseconds */
+    double cpu_us;
+} run_result_t;
+
+/* Reads nb registers during RUN_MS from a new simulated slave */
+static int run(int mode, int baud, int nb, run_result_t *result)
+{
+    uint16_t tab_reg[MODBUS_MAX_READ_REGISTERS];
+    modbus_t *ctx;
+    uint64_t start;
+    uint64_t start_cpu;
+    uint64_t end;
+    pid_t pid;
+    int pty;
+
+    memset(result, 0, sizeof(run_result_t));
+
+    pid = pty_fork(&pty);
+    if (pid == -1) {
+        return -1;
+    }
+    if (pid == 0) {
+        run_slave(mode, pty, baud, nb);
+    }
+
+    ctx = new_ctx(mode, ptsname(pty), baud);
+    modbus_set_slave(ctx, SERVER_ID);
+    if (modbus_connect(ctx) == -1) {
+        fprintf(stderr, "Connection failed: %s\n", modbus_strerror(errno));
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+        modbus_free(ctx);
+        close(pty);
+        return -1;
+    }
+
+    start = gettime_us();
+    start_cpu = cputime_us();
+    end = start + RUN_MS * 1000;
+    while (gettime_us() < end) {
+        if (modbus_read_registers(ctx, 0, nb, tab_reg) == nb) {
+            result->transactions++;
+        } else {
+            result->errors++;
+        }
+    }
+
+    result->rate = result->transactions * 1000000.0 / (gettime_us() - start);
+    if (result->transactions > 0)
+        result->cpu_us = (double)(cputime_us() - start_cpu) / result->transactions;
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    modbus_close(ctx);
+    modbus_free(ctx);
+    close(pty);
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int nb = 10;
+    int i;
+
+    if (argc > 1) {
+        nb = atoi(argv[1]);
+        if (argc > 2 || nb <= 0 || nb > MODBUS_MAX_READ_REGISTERS) {
+            printf("Usage:\n  %s [nb registers] - Modbus ASCII and RTU clients "
+                   "and simulated slaves to compare the transactions on a line\n\n",
+                   argv[0]);
+            exit(1);
+        }
+    }
+
+    printf("Reads of %d registers during %d ms, paced at the baud rate (7E1 in "
+           "ASCII, 8E1 in RTU)\nthen at the speed of the pseudo terminal:\n\n",
+           nb, RUN_MS);
+    printf("%8s %9s %9s %6s %9s %9s\n", "Baud", "RTU t/s", "ASCII t/s",
+           "Ratio", "RTU cpu", "ASCII cpu");
+
+    for (i = 0; i < (int)(sizeof(bauds) / sizeof(bauds[0])); i++) {
+        run_result_t rtu;
+        run_result_t ascii;
+        char baud[16];
+
+        if (bauds[i] > 0) {
+            snprintf(baud, sizeof(baud), "%d", bauds[i]);
+        } else {
+            strcpy(baud, "pty");
+        }
+
+        if (run(RTU, bauds[i], nb, &rtu) == -1 || rtu.transactions == 0 ||
+            rtu.errors > 0 ||
+            run(ASCII, bauds[i], nb, &ascii) == -1 || ascii.transactions == 0 ||
+            ascii.errors > 0) {
+            printf("%8s FAILED\n", baud);
+            nb_fail++;
+            continue;
+        }
+
+        /* The CPU time of the client in microseconds for a transaction */
+        printf("%8s %9.1f %9.1f %6.2f %9.1f %9.1f\n", baud, rtu.rate, ascii.rate,
+               ascii.rate / rtu.rate, rtu.cpu_us, ascii.cpu_us);
+    }
+
+    if (nb_fail > 0) {
+        printf("\n%d RUNS FAILED\n", nb_fail);
+        return 1;
+    }
+
+    return 0;
+}
@@ -16,8 +16,78 @@
 
 #include <modbus.h>
 
+#if defined(__linux__) && defined(HAVE_DLFCN_H)
+#include <dlfcn.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#define COUNT_SYSCALLS
+#endif
+
 #define G_MSEC_PER_SEC 1000
 
+#ifdef COUNT_SYSCALLS
+/* The receive functions used by libmodbus are wrapped to count the system
+   calls issued per transaction */
+static unsigned long nb_waits;
+static unsigned long nb_reads;
+
+int select(int nfds, fd_set *rset, fd_set *wset, fd_set *eset,
+           struct timeval *tv)
+{
+    static int (*real_select)(int, fd_set *, fd_set *, fd_set *,
+                              struct timeval *) = NULL;
+
+    if (real_select == NULL)
+        real_select = dlsym(RTLD_NEXT, "select");
+    nb_waits++;
+    return real_select(nfds, rset, wset, eset, tv);
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    static int (*real_poll)(struct pollfd *, nfds_t, int) = NULL;
+
+    if (real_poll == NULL)
+        real_poll = dlsym(RTLD_NEXT, "poll");
+    nb_waits++;
+    return real_poll(fds, nfds, timeout);
+}
+
+int ppoll(struct pollfd *fds, nfds_t nfds, const struct timespec *ts,
+          const sigset_t *sigmask)
+{
+    static int (*real_ppoll)(struct pollfd *, nfds_t, const struct timespec *,
+                             const sigset_t *) = NULL;
+
+    if (real_ppoll == NULL)
+        real_ppoll = dlsym(RTLD_NEXT, "ppoll");
+    nb_waits++;
+    return real_ppoll(fds, nfds, ts, sigmask);
+}
+
+ssize_t recv(int s, void *buf, size_t len, int flags)
+{
+    static ssize_t (*real_recv)(int, void *, size_t, int) = NULL;
+
+    if (real_recv == NULL)
+        real_recv = dlsym(RTLD_NEXT, "recv");
+    nb_reads++;
+    return real_recv(s, buf, len, flags);
+}
+
+ssize_t read(int fd, void *buf, size_t count)
+{
+    static ssize_t (*real_read)(int, void *, size_t) = NULL;
+
+    if (real_read == NULL)
+        real_read = dlsym(RTLD_NEXT, "read");
+    nb_reads++;
+    return real_read(fd, buf, count);
+}
+#endif
+
 static uint32_t gettime_ms(void)
 {
     struct timeval tv;
@@ -50,6 +120,8 @@ int main(int argc, char *argv[])
     int rc;
     int n_loop;
     int use_backend;
+    int rx_buffering;
+    int window;
 
     if (argc > 1) {
         if (strcmp(argv[1], "tcp") == 0) {
@@ -200,7 +272,85 @@ int main(int argc, char *argv[])
     rate = bytes / 1024 * G_MSEC_PER_SEC / (end - start);
     printf("* %.3f ms for %d bytes\n", elapsed, bytes);
     printf("* %d KiB/s\n", rate);
-    printf("\n");
+    printf("\n\n");
+
+    printf("RECEIVE SYSTEM CALLS\n\n");
+
+    /* Short reads are typical of polling, the parsing cost is the same */
+    nb_points = 10;
+    for (rx_buffering = FALSE; rx_buffering <= TRUE; rx_buffering++) {
+        modbus_set_rx_buffering(ctx, rx_buffering);
+#ifdef COUNT_SYSCALLS
+        nb_waits = 0;
+        nb_reads = 0;
+#endif
+        start = gettime_ms();
+        for (i=0; i<n_loop; i++) {
+            rc = modbus_read_registers(ctx, 0, nb_points, tab_reg);
+            if (rc == -1) {
+                fprintf(stderr, "%s\n", modbus_strerror(errno));
+                return -1;
+            }
+        }
+        end = gettime_ms();
+        if (end == start)
+            end++;
+
+        printf("%s receive:\n", rx_buffering ? "Buffered" : "Step by step");
+#ifdef COUNT_SYSCALLS
+        printf("* %.2f waits and %.2f reads per transaction\n",
+               (double)nb_waits / n_loop, (double)nb_reads / n_loop);
+#else
+        printf("* system calls not counted on this platform\n");
+#endif
+        rate = n_loop * G_MSEC_PER_SEC / (end - start);
+        printf("* %d transactions/s\n", rate);
+        printf("\n");
+    }
+
+    printf("\nPIPELINED READ REGISTERS\n\n");
+
+    nb_points = 10;
+    for (window = 1; window <= 16; window *= 4) {
+        int nb_submitted = 0;
+        int nb_completed = 0;
+        int t_id;
+
+        if (modbus_set_max_in_flight(ctx, window) == -1) {
+            fprintf(stderr, "%s\n", modbus_strerror(errno));
+            return -1;
+        }
+
+        start = gettime_ms();
+        while (nb_completed < n_loop) {
+            /* Keep the window full */
+            while (nb_submitted < n_loop &&
+                   modbus_get_in_flight(ctx) < window) {
+                rc = modbus_submit_read_registers(ctx, 0, nb_points, tab_reg);
+                if (rc == -1) {
+                    fprintf(stderr, "%s\n", modbus_strerror(errno));
+                    return -1;
+                }
+                nb_submitted++;
+            }
+
+            rc = modbus_complete(ctx, &t_id);
+            if (rc == -1) {
+                fprintf(stderr, "%s\n", modbus_strerror(errno));
+                return -1;
+            }
+            nb_completed++;
+        }
+        end = gettime_ms();
+        if (end == start)
+            end++;
+
+        rate = n_loop * G_MSEC_PER_SEC / (end - start);
+        printf("Window of %d request(s):\n", window);
+        printf("* %d transactions/s\n", rate);
+        printf("* %d registers/s\n", rate * nb_points);
+        printf("\n");
+    }
 
     /* Free the memory */
     free(tab_bit);
@@ -0,0 +1,170 @@
+/*
+ * Copyright © 2008-2014 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <modbus.h>
+
+/* Listens without accepting, the connections stay in the backlog */
+#define OPEN_PORT 1507
+/* Nothing listens */
+#define CLOSED_PORT 1508
+/* Backlog full, the SYN are dropped as by a host which is down */
+#define FULL_PORT 1509
+
+#define NB_OPEN 4
+#define NB_FULL 3
+#define NB_CTXS (NB_OPEN + 1 + NB_FULL + 1)
+#define TIMEOUT_US 200000
+
+static int nb_fail;
+
+static void check(const char *name, int cond)
+{
+    printf("%s: %s\n", name, cond ? "OK" : "FAILED");
+    if (!cond) {
+        nb_fail++;
+    }
+}
+
+static double now_ms(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static int listen_on(int port, int backlog)
+{
+    struct sockaddr_in addr;
+    int enable = 1;
+    int s = socket(PF_INET, SOCK_STREAM, 0);
+
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (bind(s, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        listen(s, backlog) == -1) {
+        close(s);
+        return -1;
+    }
+
+    return s;
+}
+
+int main(void)
+{
+    modbus_t *ctxs[NB_CTXS];
+    modbus_tcp_connect_result_t results[NB_CTXS];
+    modbus_t *filler;
+    double elapsed;
+    int open_socket;
+    int full_socket;
+    int open_fd;
+    int nb_valid;
+    int rc;
+    int i;
+
+    open_socket = listen_on(OPEN_PORT, NB_OPEN);
+    full_socket = listen_on(FULL_PORT, 0);
+    if (open_socket == -1 || full_socket == -1) {
+        fprintf(stderr, "Unable to listen: %s\n", modbus_strerror(errno));
+        return -1;
+    }
+
+    /* Takes the only place of the backlog */
+    filler = modbus_new_tcp("127.0.0.1", FULL_PORT);
+    if (modbus_connect(filler) == -1) {
+        fprintf(stderr, "Backlog not filled: %s\n", modbus_strerror(errno));
+        return -1;
+    }
+
+    for (i = 0; i < NB_OPEN; i++) {
+        ctxs[i] = modbus_new_tcp("127.0.0.1", OPEN_PORT);
+    }
+    ctxs[NB_OPEN] = modbus_new_tcp("127.0.0.1", CLOSED_PORT);
+    for (i = NB_OPEN + 1; i < NB_OPEN + 1 + NB_FULL; i++) {
+        ctxs[i] = modbus_new_tcp("127.0.0.1", FULL_PORT);
+    }
+    ctxs[NB_CTXS - 1] = modbus_new_rtu("/dev/null", 9600, 'N', 8, 1);
+    for (i = 0; i < NB_CTXS; i++) {
+        modbus_set_response_timeout(ctxs[i], 0, TIMEOUT_US);
+    }
+
+    check("Invalid arguments",
+          modbus_tcp_connect_many(NULL, NB_CTXS, results) == -1 &&
+          errno == EINVAL);
+
+    elapsed = now_ms();
+    rc = modbus_tcp_connect_many(ctxs, NB_CTXS, results);
+    elapsed = now_ms() - elapsed;
+
+    check("Number of contexts connected", rc == NB_OPEN);
+
+    nb_valid = 0;
+    for (i = 0; i < NB_OPEN; i++) {
+        nb_valid += results[i].rc == 0 && results[i].error == 0 &&
+            modbus_get_socket(ctxs[i]) != -1 &&
+            results[i].latency_us < TIMEOUT_US;
+    }
+    check("Listening endpoints connected", nb_valid == NB_OPEN);
+
+    check("Closed endpoint refused",
+          results[NB_OPEN].rc == -1 && results[NB_OPEN].error == ECONNREFUSED &&
+          modbus_get_socket(ctxs[NB_OPEN]) == -1);
+
+    nb_valid = 0;
+    for (i = NB_OPEN + 1; i < NB_OPEN + 1 + NB_FULL; i++) {
+        nb_valid += results[i].rc == -1 && results[i].error == ETIMEDOUT &&
+            modbus_get_socket(ctxs[i]) == -1 &&
+            results[i].latency_us >= TIMEOUT_US;
+    }
+    check("Unanswered endpoints timed out", nb_valid == NB_FULL);
+
+    check("Serial context rejected",
+          results[NB_CTXS - 1].rc == -1 && results[NB_CTXS - 1].error == EINVAL);
+
+    /* The timeouts run together, not one after another */
+    printf("Connected in %.0f ms\n", elapsed);
+    check("Parallel timeouts",
+          elapsed >= TIMEOUT_US / 1000 && elapsed < 2 * TIMEOUT_US / 1000);
+
+    /* The socket is closed first, its descriptor may be reused */
+    open_fd = modbus_get_socket(ctxs[0]);
+    rc = modbus_tcp_connect_many(ctxs, 1, results);
+    check("Connected context reconnected",
+          rc == 1 && modbus_get_socket(ctxs[0]) != -1 &&
+          (modbus_get_socket(ctxs[0]) == open_fd ||
+           fcntl(open_fd, F_GETFD) == -1));
+
+    for (i = 0; i < NB_CTXS; i++) {
+        modbus_close(ctxs[i]);
+        modbus_free(ctxs[i]);
+    }
+    modbus_close(filler);
+    modbus_free(filler);
+    close(open_socket);
+    close(full_socket);
+
+    if (nb_fail > 0) {
+        printf("\n%d TESTS FAILED\n", nb_fail);
+        return 1;
+    }
+
+    printf("\nALL TESTS PASS WITH SUCCESS.\n");
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright © 2008-2014 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#ifndef _MSC_VER
+#include <sys/time.h>
+#else
+#include <windows.h>
+#endif
+#include <stdlib.h>
+#include <modbus.h>
+
+#include "crc16-reference.h"
+
+/* Size of a bulk capture of traffic */
+#define CAPTURE_LENGTH (4 * 1024 * 1024)
+/* Bytes processed by each measure */
+#define BYTES_PER_MEASURE (256 * 1024 * 1024)
+
+typedef uint16_t (*crc16_fnc_t)(const uint8_t *buffer, size_t length);
+
+static uint64_t gettime_us(void)
+{
+#if !defined(_MSC_VER)
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+#else
+    return (uint64_t) GetTickCount() * 1000;
+#endif
+}
+
+/* The CRCs are summed so the calls can't be optimized out */
+static uint16_t crc_sum;
+
+/* Returns the throughput in GB/s of the CRC on buffers of length bytes */
+static double measure(crc16_fnc_t crc16, const uint8_t *buffer, size_t length)
+{
+    size_t nb_loops = BYTES_PER_MEASURE / length;
+    size_t offset = 0;
+    size_t i;
+    uint64_t start;
+    uint64_t elapsed;
+
+    start = gettime_us();
+    for (i = 0; i < nb_loops; i++) {
+        /* Frames are taken one after the other in the capture */
+        crc_sum += crc16(buffer + offset, length);
+        offset += length;
+        if (offset + length > CAPTURE_LENGTH) {
+            offset = 0;
+        }
+    }
+    elapsed = gettime_us() - start;
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+
+    return (double)nb_loops * length / elapsed / 1000;
+}
+
+int main(void)
+{
+    const size_t frame_lengths[] = { 8, 16, 32, 64, 128, 256 };
+    uint8_t *capture;
+    size_t i;
+
+    capture = malloc(CAPTURE_LENGTH);
+    if (capture == NULL) {
+        return -1;
+    }
+
+    srand(5);
+    for (i = 0; i < CAPTURE_LENGTH; i++) {
+        capture[i] = (uint8_t)rand();
+    }
+
+    printf("CRC-16/MODBUS throughput in GB/s\n\n");
+    printf("%10s %12s %18s\n", "Length", "Bytewise", "modbus_rtu_crc16");
+    for (i = 0; i < sizeof(frame_lengths) / sizeof(frame_lengths[0]); i++) {
+        printf("%10u %12.3f %18.3f\n", (unsigned int)frame_lengths[i],
+               measure(crc16_reference, capture, frame_lengths[i]),
+               measure(modbus_rtu_crc16, capture, frame_lengths[i]));
+    }
+    printf("%10s %12.3f %18.3f\n", "Capture",
+           measure(crc16_reference, capture, CAPTURE_LENGTH),
+           measure(modbus_rtu_crc16, capture, CAPTURE_LENGTH));
+    printf("\n(sum 0x%04X)\n", crc_sum);
+
+    free(capture);
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright © 2008-2014 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <modbus.h>
+
+#include "crc16-reference.h"
+
+/* Long enough to go through every kernel of modbus_rtu_crc16 */
+#define MAX_LENGTH 2048
+/* Every alignment of the unaligned loads */
+#define NB_OFFSETS 16
+
+int main(void)
+{
+    uint8_t *buffer;
+    const uint8_t check[] = "123456789";
+    uint16_t crc;
+    uint16_t crc_ref;
+    int nb_fail = 0;
+    int offset;
+    int length;
+    int i;
+
+    buffer = malloc(MAX_LENGTH + NB_OFFSETS);
+    srand(5);
+    for (i = 0; i < MAX_LENGTH + NB_OFFSETS; i++) {
+        buffer[i] = (uint8_t)rand();
+    }
+
+    /* Check value of the CRC-16/MODBUS catalogue, the low byte is sent
+       first so it's returned in the high byte */
+    crc = modbus_rtu_crc16(check, 9);
+    printf("Check value 0x%04X: ", crc);
+    if (crc == 0x374B && crc16_reference(check, 9) == crc) {
+        printf("OK\n");
+    } else {
+        printf("FAILED\n");
+        nb_fail++;
+    }
+
+    printf("Random data of 0 to %d bytes: ", MAX_LENGTH);
+    for (offset = 0; offset < NB_OFFSETS; offset++) {
+        for (length = 0; length <= MAX_LENGTH; length++) {
+            crc = modbus_rtu_crc16(buffer + offset, length);
+            crc_ref = crc16_reference(buffer + offset, length);
+            if (crc != crc_ref) {
+                printf("\nFAILED (offset %d, length %d: 0x%04X instead of 0x%04X)",
+                       offset, length, crc, crc_ref);
+                nb_fail++;
+            }
+        }
+    }
+    if (nb_fail == 0) {
+        printf("OK\n");
+    } else {
+        printf("\n");
+    }
+
+    /* A frame followed by its CRC has a null remainder */
+    printf("Frames with their CRC: ");
+    for (length = 2; length < MODBUS_RTU_MAX_ADU_LENGTH; length++) {
+        crc = modbus_rtu_crc16(buffer, length - 2);
+        buffer[length - 2] = crc >> 8;
+        buffer[length - 1] = crc & 0x00FF;
+        if (modbus_rtu_crc16(buffer, length) != 0) {
+            printf("\nFAILED (length %d)", length);
+            nb_fail++;
+            break;
+        }
+    }
+    if (length == MODBUS_RTU_MAX_ADU_LENGTH) {
+        printf("OK\n");
+    } else {
+        printf("\n");
+    }
+
+    free(buffer);
+
+    if (nb_fail == 0) {
+        printf("\nALL TESTS PASS WITH SUCCESS.\n");
+        return 0;
+    }
+
+    return 1;
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright © 2008-2014 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <modbus.h>
+
+#include "pty-fixture.h"
+
+/* The second slave of the line never answers, the third one answers after
+   the response timeout of the gateway */
+#define LIVE_SLAVE 1
+#define DEAD_SLAVE 2
+#define SLOW_SLAVE 3
+#define NB_MASTERS 8
+#define PORT 1503
+
+/* Answers the reads of one holding register with the number of reads served
+   so far and echoes the writes of one register, after 20 ms so the requests
+   of the masters pile up in the gateway (150 ms for the slow slave) */
+static void run_server(int pty)
+{
+    uint8_t req[8];
+    uint8_t rsp[8];
+    uint16_t nb_reads = 0;
+
+    for (;;) {
+        int rsp_length;
+        uint16_t crc;
+
+        pty_read(pty, req, sizeof(req));
+
+        if (req[0] != LIVE_SLAVE && req[0] != SLOW_SLAVE)
+            continue;
+
+        if (req[1] == MODBUS_FC_READ_HOLDING_REGISTERS) {
+            nb_reads++;
+            rsp[0] = req[0];
+            rsp[1] = req[1];
+            rsp[2] = 2;
+            rsp[3] = nb_reads >> 8;
+            rsp[4] = nb_reads & 0xFF;
+            rsp_length = 5;
+        } else {
+            memcpy(rsp, req, 6);
+            rsp_length = 6;
+        }
+        crc = modbus_rtu_crc16(rsp, rsp_length);
+        rsp[rsp_length++] = crc >> 8;
+        rsp[rsp_length++] = crc & 0xFF;
+
+        usleep(req[0] == SLOW_SLAVE ? 150000 : 20000);
+        if (write(pty, rsp, rsp_length) != rsp_length) {
+            _exit(1);
+        }
+    }
+}
+
+/* Sends a request with the given transaction identifier through the socket of
+   the master */
+static void send_request(modbus_t *master, int t_id, int unit, int function,
+                         int addr, int value)
+{
+    uint8_t req[] = { t_id >> 8, t_id & 0xFF, 0x00, 0x00, 0x00, 0x06, unit,
+                      function, addr >> 8, addr & 0xFF, value >> 8,
+                      value & 0xFF };
+
+    if (write(modbus_get_socket(master), req, sizeof(req)) != sizeof(req)) {
+        fprintf(stderr, "Request not sent: %s\n", modbus_strerror(errno));
+    }
+}
+
+/* Returns the transaction identifier of the response received by the master,
+   -1 if none */
+static int receive_response(modbus_t *master, uint8_t *rsp)
+{
+    if (modbus_receive_confirmation(master, rsp) <= 0)
+        return -1;
+
+    return (rsp[0] << 8) | rsp[1];
+}
+
+int main(void)
+{
+    modbus_t *ctx_tcp;
+    modbus_t *ctx_rtu;
+    modbus_t *masters[NB_MASTERS];
+    modbus_gateway_t *gateway;
+    modbus_gateway_stats_t stats;
+    uint8_t rsp[MODBUS_TCP_MAX_ADU_LENGTH];
+    int server_socket;
+    int nb_valid;
+    int value = -1;
+    pid_t pid;
+    int pty;
+    int rc;
+    int i;
+
+    pid = pty_fork(&pty);
+    if (pid == -1) {
+        return -1;
+    }
+    if (pid == 0) {
+        run_server(pty);
+    }
+
+    ctx_rtu = modbus_new_rtu(ptsname(pty), 115200, 'N', 8, 1);
+    ctx_tcp = modbus_new_tcp("127.0.0.1", PORT);
+    server_socket = modbus_tcp_listen(ctx_tcp, NB_MASTERS);
+    if (modbus_connect(ctx_rtu) == -1 || server_socket == -1) {
+        fprintf(stderr, "Gateway not started: %s\n", modbus_strerror(errno));
+        kill(pid, SIGTERM);
+        modbus_free(ctx_rtu);
+        modbus_free(ctx_tcp);
+        return -1;
+    }
+    modbus_set_response_timeout(ctx_rtu, 0, 100000);
+
+    check("Serial context required",
+          modbus_gateway_new(ctx_tcp, server_socket, ctx_tcp) == NULL &&
+          errno == EINVAL);
+    gateway = modbus_gateway_new(ctx_tcp, server_socket, ctx_rtu);
+
+    /* One connection is accepted per run */
+    for (i = 0; i < NB_MASTERS; i++) {
+        masters[i] = modbus_new_tcp("127.0.0.1", PORT);
+        if (modbus_connect(masters[i]) == -1) {
+            fprintf(stderr, "Connection failed: %s\n", modbus_strerror(errno));
+            return -1;
+        }
+        modbus_gateway_run(gateway, 1000);
+    }
+    modbus_gateway_get_stats(gateway, &stats);
+    check("Masters connected", stats.clients == NB_MASTERS);
+
+    /* The same read from every master, received at once */
+    for (i = 0; i < NB_MASTERS; i++) {
+        send_request(masters[i], 100 + i, LIVE_SLAVE,
+                     MODBUS_FC_READ_HOLDING_REGISTERS, 0, 1);
+    }
+    rc = modbus_gateway_run(gateway, 1000);
+    nb_valid = 0;
+    for (i = 0; i < NB_MASTERS; i++) {
+        if (receive_response(masters[i], rsp) == 100 + i &&
+            rsp[6] == LIVE_SLAVE && rsp[7] == MODBUS_FC_READ_HOLDING_REGISTERS) {
+            if (value == -1)
+                value = (rsp[9] << 8) | rsp[10];
+            if (value == ((rsp[9] << 8) | rsp[10]))
+                nb_valid++;
+        }
+    }
+    modbus_gateway_get_stats(gateway, &stats);
+    check("Identical reads merged in one transaction",
+          rc == 1 && stats.transactions == 1 &&
+          stats.coalesced == NB_MASTERS - 1);
+    check("Same response to each master with its transaction identifier",
+          nb_valid == NB_MASTERS && value == 1);
+
+    /* Written twice as the writes aren't merged */
+    send_request(masters[0], 200, LIVE_SLAVE, MODBUS_FC_WRITE_SINGLE_REGISTER,
+                 0, 0x1234);
+    send_request(masters[1], 201, LIVE_SLAVE, MODBUS_FC_WRITE_SINGLE_REGISTER,
+                 0, 0x1234);
+    rc = modbus_gateway_run(gateway, 1000);
+    check("Identical writes not merged",
+          rc == 2 && receive_response(masters[0], rsp) == 200 &&
+          receive_response(masters[1], rsp) == 201 &&
+          rsp[10] == 0x12 && rsp[11] == 0x34);
+
+    /* The second read follows a write, the first one can't answer it */
+    send_request(masters[0], 300, LIVE_SLAVE, MODBUS_FC_READ_HOLDING_REGISTERS,
+                 0, 1);
+    send_request(masters[1], 301, LIVE_SLAVE, MODBUS_FC_WRITE_SINGLE_REGISTER,
+                 0, 0x1234);
+    send_request(masters[2], 302, LIVE_SLAVE, MODBUS_FC_READ_HOLDING_REGISTERS,
+                 0, 1);
+    rc = modbus_gateway_run(gateway, 1000);
+    check("Read not merged across a write",
+          rc == 3 && receive_response(masters[0], rsp) == 300 &&
+          receive_response(masters[1], rsp) == 301 &&
+          receive_response(masters[2], rsp) == 302 &&
+          ((rsp[9] << 8) | rsp[10]) == 3);
+
+    send_request(masters[3], 400, DEAD_SLAVE, MODBUS_FC_READ_HOLDING_REGISTERS,
+                 0, 1);
+    modbus_gateway_run(gateway, 1000);
+    check("Gateway target failed to respond",
+          receive_response(masters[3], rsp) == 400 && rsp[6] == DEAD_SLAVE &&
+          rsp[7] == (MODBUS_FC_READ_HOLDING_REGISTERS | 0x80) &&
+          rsp[8] == MODBUS_EXCEPTION_GATEWAY_TARGET);
+
+    /* No serial address above 247 */
+    send_request(masters[4], 500, 250, MODBUS_FC_READ_HOLDING_REGISTERS, 0, 1);
+    modbus_gateway_run(gateway, 1000);
+    check("Gateway path unavailable",
+          receive_response(masters[4], rsp) == 500 &&
+          rsp[8] == MODBUS_EXCEPTION_GATEWAY_PATH);
+
+    modbus_close(masters[5]);
+    modbus_gateway_run(gateway, 1000);
+    modbus_gateway_get_stats(gateway, &stats);
+    check("Statistics",
+          stats.clients == NB_MASTERS - 1 && stats.requests == 15 &&
+          stats.transactions == 7 && stats.coalesced == 7 &&
+          stats.exceptions == 2);
+
+    /* The response of the slow slave is awaited and discarded, the read of
+       the live slave sent next gets its own response */
+    send_request(masters[6], 600, SLOW_SLAVE, MODBUS_FC_READ_HOLDING_REGISTERS,
+                 0, 1);
+    modbus_gateway_run(gateway, 1000);
+    send_request(masters[7], 601, LIVE_SLAVE, MODBUS_FC_READ_HOLDING_REGISTERS,
+                 0, 1);
+    modbus_gateway_run(gateway, 1000);
+    check("Late response not taken for the next one",
+          receive_response(masters[6], rsp) == 600 &&
+          rsp[8] == MODBUS_EXCEPTION_GATEWAY_TARGET &&
+          receive_response(masters[7], rsp) == 601 && rsp[6] == LIVE_SLAVE &&
+          rsp[7] == MODBUS_FC_READ_HOLDING_REGISTERS &&
+          ((rsp[9] << 8) | rsp[10]) == 5);
+
+    for (i = 0; i < NB_MASTERS; i++) {
+        modbus_close(masters[i]);
+        modbus_free(masters[i]);
+    }
+    modbus_gateway_free(gateway);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    close(server_socket);
+    modbus_free(ctx_tcp);
+    modbus_close(ctx_rtu);
+    modbus_free(ctx_rtu);
+    close(pty);
+
+    if (nb_fail > 0) {
+        printf("\n%d TESTS FAILED\n", nb_fail);
+        return 1;
+    }
+
+    printf("\nALL TESTS PASS WITH SUCCESS.\n");
+    return 0;
+}
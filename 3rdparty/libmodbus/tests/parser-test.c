@@ -0,0 +1,258 @@
+/*
+ * Copyright © 2008-2014 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <modbus.h>
+
+#define MAX_FRAMES 64
+#define STREAM_LENGTH 4096
+
+typedef struct {
+    int nb_frames;
+    int offsets[MAX_FRAMES];
+    int lengths[MAX_FRAMES];
+    /* Frames passed in place in the chunk fed */
+    int nb_in_place;
+    const uint8_t *chunk;
+    int chunk_length;
+    uint8_t stream[STREAM_LENGTH];
+    int stream_length;
+    /* Frames received */
+    int nb_received;
+    int nb_mismatch;
+} frames_t;
+
+static frames_t frames;
+
+/* Appends a frame to the expected stream, with its CRC in RTU */
+static void add_frame(const uint8_t *frame, int length, int rtu)
+{
+    frames.offsets[frames.nb_frames] = frames.stream_length;
+    memcpy(frames.stream + frames.stream_length, frame, length);
+    frames.stream_length += length;
+    if (rtu) {
+        uint16_t crc = modbus_rtu_crc16(frame, length);
+        frames.stream[frames.stream_length++] = crc >> 8;
+        frames.stream[frames.stream_length++] = crc & 0xFF;
+        length += 2;
+    }
+    frames.lengths[frames.nb_frames++] = length;
+}
+
+static void add_garbage(const uint8_t *garbage, int length)
+{
+    memcpy(frames.stream + frames.stream_length, garbage, length);
+    frames.stream_length += length;
+}
+
+static void reset_frames(void)
+{
+    memset(&frames, 0, sizeof(frames));
+}
+
+static void on_adu(modbus_parser_t *parser, const uint8_t *adu, int adu_length,
+                   void *user_data)
+{
+    int i = frames.nb_received++;
+
+    (void)parser;
+    (void)user_data;
+    if (i >= frames.nb_frames || adu_length != frames.lengths[i] ||
+        memcmp(adu, frames.stream + frames.offsets[i], adu_length) != 0) {
+        frames.nb_mismatch++;
+    }
+    if (adu >= frames.chunk && adu + adu_length <= frames.chunk + frames.chunk_length) {
+        frames.nb_in_place++;
+    }
+}
+
+/* Feeds the stream by chunks of chunk_size bytes and checks every frame is
+   received once and in order */
+static int feed_stream(modbus_parser_t *parser, int chunk_size)
+{
+    int offset;
+
+    frames.nb_received = 0;
+    frames.nb_mismatch = 0;
+    frames.nb_in_place = 0;
+    modbus_parser_reset(parser);
+
+    for (offset = 0; offset < frames.stream_length; offset += chunk_size) {
+        int length = frames.stream_length - offset;
+
+        if (length > chunk_size)
+            length = chunk_size;
+        frames.chunk = frames.stream + offset;
+        frames.chunk_length = length;
+        if (modbus_parser_feed(parser, frames.chunk, length) == -1)
+            return -1;
+    }
+
+    return (frames.nb_received == frames.nb_frames && frames.nb_mismatch == 0) ? 0 : -1;
+}
+
+static int check_chunks(const char *name, modbus_parser_t *parser,
+                        int in_place)
+{
+    int chunk_size;
+    int rc = 0;
+
+    printf("%s: ", name);
+    for (chunk_size = 1; chunk_size <= frames.stream_length; chunk_size++) {
+        if (feed_stream(parser, chunk_size) == -1) {
+            printf("FAILED (chunks of %d bytes, %d/%d frames, %d mismatch)\n",
+                   chunk_size, frames.nb_received, frames.nb_frames,
+                   frames.nb_mismatch);
+            return -1;
+        }
+    }
+
+    /* The whole stream in one chunk is parsed in place */
+    rc = feed_stream(parser, frames.stream_length);
+    if (rc == -1 || (in_place && frames.nb_in_place != frames.nb_frames)) {
+        printf("FAILED (%d/%d frames in place)\n", frames.nb_in_place,
+               frames.nb_frames);
+        return -1;
+    }
+
+    printf("OK (%d frames)\n", frames.nb_frames);
+    return 0;
+}
+
+static const uint8_t rtu_read_req[] = { 0x01, 0x03, 0x00, 0x6B, 0x00, 0x03 };
+static const uint8_t rtu_read_rsp[] = { 0x01, 0x03, 0x06, 0x02, 0x2B, 0x00, 0x00, 0x00, 0x64 };
+static const uint8_t rtu_exception_rsp[] = { 0x01, 0x83, 0x02 };
+static const uint8_t rtu_write_req[] = { 0x11, 0x10, 0x00, 0x01, 0x00, 0x02, 0x04,
+                                         0x00, 0x0A, 0x01, 0x02 };
+static const uint8_t rtu_write_rsp[] = { 0x11, 0x10, 0x00, 0x01, 0x00, 0x02 };
+static const uint8_t rtu_coils_req[] = { 0x04, 0x01, 0x00, 0x13, 0x00, 0x25 };
+static const uint8_t rtu_coils_rsp[] = { 0x04, 0x01, 0x05, 0xCD, 0x6B, 0xB2, 0x0E, 0x1B };
+/* Invalid exception responses and a too short read response */
+static const uint8_t garbage[] = { 0xFF, 0xFF, 0x7F };
+/* Start of a report slave ID response of 21 bytes */
+static const uint8_t long_garbage[] = { 0x7F, 0x11 };
+
+static const uint8_t tcp_read_req[] = { 0x00, 0x01, 0x00, 0x00, 0x00, 0x06, 0xFF,
+                                        0x03, 0x01, 0x60, 0x00, 0x03 };
+static const uint8_t tcp_read_rsp[] = { 0x00, 0x01, 0x00, 0x00, 0x00, 0x09, 0xFF,
+                                        0x03, 0x06, 0x02, 0x2B, 0x00, 0x01, 0x00, 0x64 };
+static const uint8_t tcp_exception_rsp[] = { 0x00, 0x02, 0x00, 0x00, 0x00, 0x03, 0xFF,
+                                             0x83, 0x02 };
+static const uint8_t tcp_bad_protocol[] = { 0x00, 0x03, 0x00, 0x01, 0x00, 0x03 };
+
+int main(void)
+{
+    modbus_t *ctx_rtu;
+    modbus_t *ctx_tcp;
+    modbus_parser_t *parser;
+    int nb_fail = 0;
+    int i;
+
+    /* The contexts only select the backend, they aren't connected */
+    ctx_rtu = modbus_new_rtu("/dev/null", 19200, 'N', 8, 1);
+    ctx_tcp = modbus_new_tcp("127.0.0.1", 1502);
+    if (ctx_rtu == NULL || ctx_tcp == NULL) {
+        fprintf(stderr, "Unable to allocate the contexts\n");
+        return -1;
+    }
+
+    /* RTU confirmations */
+    parser = modbus_parser_new(ctx_rtu, MODBUS_PARSER_CONFIRMATION, on_adu, NULL);
+    reset_frames();
+    for (i = 0; i < 4; i++) {
+        add_frame(rtu_read_rsp, sizeof(rtu_read_rsp), TRUE);
+        add_frame(rtu_exception_rsp, sizeof(rtu_exception_rsp), TRUE);
+        add_frame(rtu_write_rsp, sizeof(rtu_write_rsp), TRUE);
+        add_frame(rtu_coils_rsp, sizeof(rtu_coils_rsp), TRUE);
+    }
+    nb_fail += check_chunks("RTU confirmations", parser, TRUE) == -1;
+
+    /* The invalid bytes are dropped */
+    reset_frames();
+    add_garbage(garbage, sizeof(garbage));
+    add_frame(rtu_read_rsp, sizeof(rtu_read_rsp), TRUE);
+    add_frame(rtu_write_rsp, sizeof(rtu_write_rsp), TRUE);
+    nb_fail += check_chunks("RTU confirmations after garbage", parser, TRUE) == -1;
+
+    /* The frames read while waiting for the end of a long invalid frame are
+       found in the buffer */
+    reset_frames();
+    add_garbage(long_garbage, sizeof(long_garbage));
+    for (i = 0; i < 4; i++) {
+        add_frame(rtu_read_rsp, sizeof(rtu_read_rsp), TRUE);
+        add_frame(rtu_write_rsp, sizeof(rtu_write_rsp), TRUE);
+    }
+    nb_fail += check_chunks("RTU confirmations after a long invalid frame",
+                            parser, FALSE) == -1;
+    modbus_parser_free(parser);
+
+    /* RTU indications */
+    parser = modbus_parser_new(ctx_rtu, MODBUS_PARSER_INDICATION, on_adu, NULL);
+    reset_frames();
+    for (i = 0; i < 4; i++) {
+        add_frame(rtu_read_req, sizeof(rtu_read_req), TRUE);
+        add_frame(rtu_write_req, sizeof(rtu_write_req), TRUE);
+        add_frame(rtu_coils_req, sizeof(rtu_coils_req), TRUE);
+    }
+    nb_fail += check_chunks("RTU indications", parser, TRUE) == -1;
+    modbus_parser_free(parser);
+
+    /* Both directions of a line */
+    parser = modbus_parser_new(ctx_rtu, MODBUS_PARSER_ANY, on_adu, NULL);
+    reset_frames();
+    for (i = 0; i < 4; i++) {
+        add_frame(rtu_read_req, sizeof(rtu_read_req), TRUE);
+        add_frame(rtu_read_rsp, sizeof(rtu_read_rsp), TRUE);
+        add_frame(rtu_write_req, sizeof(rtu_write_req), TRUE);
+        add_frame(rtu_write_rsp, sizeof(rtu_write_rsp), TRUE);
+        add_frame(rtu_coils_req, sizeof(rtu_coils_req), TRUE);
+        add_frame(rtu_exception_rsp, sizeof(rtu_exception_rsp), TRUE);
+    }
+    nb_fail += check_chunks("RTU capture", parser, TRUE) == -1;
+    modbus_parser_free(parser);
+
+    /* TCP, delimited by the MBAP header in both directions */
+    parser = modbus_parser_new(ctx_tcp, MODBUS_PARSER_ANY, on_adu, NULL);
+    reset_frames();
+    for (i = 0; i < 4; i++) {
+        add_frame(tcp_read_req, sizeof(tcp_read_req), FALSE);
+        add_frame(tcp_read_rsp, sizeof(tcp_read_rsp), FALSE);
+        add_garbage(tcp_bad_protocol, sizeof(tcp_bad_protocol));
+        add_frame(tcp_exception_rsp, sizeof(tcp_exception_rsp), FALSE);
+    }
+    nb_fail += check_chunks("TCP capture", parser, TRUE) == -1;
+
+    printf("Dropped bytes counted: ");
+    if (modbus_parser_get_dropped(parser) > 0) {
+        printf("OK\n");
+    } else {
+        printf("FAILED\n");
+        nb_fail++;
+    }
+    modbus_parser_free(parser);
+
+    printf("Invalid arguments: ");
+    if (modbus_parser_new(ctx_tcp, MODBUS_PARSER_ANY, NULL, NULL) == NULL &&
+        modbus_parser_feed(NULL, frames.stream, 1) == -1) {
+        printf("OK\n");
+    } else {
+        printf("FAILED\n");
+        nb_fail++;
+    }
+
+    modbus_free(ctx_rtu);
+    modbus_free(ctx_tcp);
+
+    if (nb_fail > 0) {
+        printf("\n%d TESTS FAILED\n", nb_fail);
+        return 1;
+    }
+
+    printf("\nALL TESTS PASS WITH SUCCESS.\n");
+    return 0;
+}
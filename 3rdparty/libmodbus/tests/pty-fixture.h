@@ -0,0 +1,93 @@
+/*
+ * Copyright © 2008-2014 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PTY_FIXTURE_H_
+#define _PTY_FIXTURE_H_
+
+/* Serial line simulated by a pseudo terminal: the client opens the slave side
+   with ptsname(pty), a forked process answers on the master side */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <modbus.h>
+
+static int nb_fail;
+
+static inline void check(const char *name, int cond)
+{
+    printf("%s: %s\n", name, cond ? "OK" : "FAILED");
+    if (!cond) {
+        nb_fail++;
+    }
+}
+
+static inline uint64_t gettime_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/* Opens a pseudo terminal and forks like fork(), the child returns 0 and
+   answers on pty */
+static inline pid_t pty_fork(int *pty)
+{
+    pid_t pid;
+
+    *pty = posix_openpt(O_RDWR | O_NOCTTY);
+    if (*pty == -1 || grantpt(*pty) == -1 || unlockpt(*pty) == -1) {
+        fprintf(stderr, "Unable to open a pseudo terminal: %s\n",
+                modbus_strerror(errno));
+        return -1;
+    }
+
+    pid = fork();
+    if (pid == -1) {
+        close(*pty);
+    }
+
+    return pid;
+}
+
+/* Reads length bytes on the master side. The reads fail with EIO as long as
+   the slave side is not open, the client may not have opened it yet */
+static inline void pty_read(int pty, uint8_t *buf, int length)
+{
+    int offset = 0;
+
+    while (offset < length) {
+        ssize_t rc = read(pty, buf + offset, length - offset);
+
+        if (rc <= 0) {
+            usleep(1000);
+            continue;
+        }
+        offset += rc;
+    }
+}
+
+/* Same as modbus_receive() on a context set on the master side, waits for
+   the client to open the terminal and skips the requests to other slaves */
+static inline int pty_receive(modbus_t *ctx, uint8_t *req)
+{
+    for (;;) {
+        int rc = modbus_receive(ctx, req);
+
+        if (rc > 0) {
+            return rc;
+        }
+        if (rc == -1 && errno == EIO) {
+            usleep(1000);
+        }
+    }
+}
+
+#endif /* _PTY_FIXTURE_H_ */
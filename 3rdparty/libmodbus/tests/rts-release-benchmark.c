@@ -0,0 +1,138 @@
+/*
+ * Copyright © 2008-2014 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <modbus.h>
+
+#include "pty-fixture.h"
+
+/* Low speed so the time to send a request is far above the scheduling
+   jitter */
+#define BAUD 9600
+#define NB_LOOPS 100
+#define SERVER_ID 17
+
+/* A pseudo terminal has no RTS line, the requests to toggle it are only
+   counted */
+static int nb_rts_releases;
+
+static void set_rts(modbus_t *ctx, int on)
+{
+    (void)ctx;
+    if (!on) {
+        nb_rts_releases++;
+    }
+}
+
+/* Answers each read of one holding register as soon as the request is read,
+   the turnaround measured by the client is then the time spent by libmodbus
+   around the write of the request */
+static void run_server(int pty)
+{
+    uint8_t rsp[] = { SERVER_ID, 0x03, 0x02, 0x00, 0x2A, 0x00, 0x00 };
+    uint16_t crc = modbus_rtu_crc16(rsp, 5);
+    uint8_t req[8];
+
+    rsp[5] = crc >> 8;
+    rsp[6] = crc & 0xFF;
+
+    for (;;) {
+        pty_read(pty, req, sizeof(req));
+
+        if (write(pty, rsp, sizeof(rsp)) != sizeof(rsp)) {
+            _exit(1);
+        }
+    }
+}
+
+/* Returns the mean transaction time in microseconds or 0 on error */
+static uint64_t measure(modbus_t *ctx, int mode)
+{
+    uint16_t value;
+    uint64_t start;
+    int i;
+
+    if (modbus_rtu_set_rts_release(ctx, mode) == -1) {
+        return 0;
+    }
+
+    start = gettime_us();
+    for (i = 0; i < NB_LOOPS; i++) {
+        if (modbus_read_registers(ctx, 0, 1, &value) != 1) {
+            fprintf(stderr, "Read failed: %s\n", modbus_strerror(errno));
+            return 0;
+        }
+    }
+
+    return (gettime_us() - start) / NB_LOOPS;
+}
+
+int main(void)
+{
+    modbus_t *ctx;
+    uint64_t delay_us;
+    uint64_t drain_us;
+    pid_t pid;
+    int pty;
+    int rc;
+
+    pid = pty_fork(&pty);
+    if (pid == -1) {
+        return -1;
+    }
+    if (pid == 0) {
+        run_server(pty);
+    }
+
+    ctx = modbus_new_rtu(ptsname(pty), BAUD, 'N', 8, 1);
+    modbus_set_slave(ctx, SERVER_ID);
+    if (modbus_connect(ctx) == -1) {
+        fprintf(stderr, "Connection failed: %s\n", modbus_strerror(errno));
+        kill(pid, SIGTERM);
+        modbus_free(ctx);
+        return -1;
+    }
+    modbus_rtu_set_custom_rts(ctx, set_rts);
+    modbus_rtu_set_rts(ctx, MODBUS_RTU_RTS_UP);
+
+    printf("Turnaround of %d reads of one register at %d bauds:\n", NB_LOOPS, BAUD);
+
+    delay_us = measure(ctx, MODBUS_RTU_RTS_RELEASE_DELAY);
+    printf("* RTS released after the estimated time: %d us\n", (int)delay_us);
+
+    drain_us = measure(ctx, MODBUS_RTU_RTS_RELEASE_DRAIN);
+    printf("* RTS released once the transmitter is empty: %d us\n", (int)drain_us);
+
+    rc = modbus_rtu_set_rts_release(ctx, MODBUS_RTU_RTS_RELEASE_KERNEL);
+    printf("* RTS released by the driver: %s\n",
+           (rc == -1) ? "not supported by a pseudo terminal" : "enabled");
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    modbus_close(ctx);
+    modbus_free(ctx);
+    close(pty);
+
+    if (delay_us == 0 || drain_us == 0 || nb_rts_releases < 2 * NB_LOOPS) {
+        printf("\nFAILED\n");
+        return 1;
+    }
+
+    /* The request of 8 bytes takes 8.3 ms to send at 9600 bauds */
+    printf("\nGain: %d us per transaction\n", (int)(delay_us - drain_us));
+    if (drain_us >= delay_us) {
+        printf("FAILED\n");
+        return 1;
+    }
+
+    return 0;
+}
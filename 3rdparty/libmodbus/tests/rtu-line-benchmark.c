@@ -0,0 +1,279 @@
+/*
+ * Copyright © 2008-2014 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <modbus.h>
+
+#include "pty-fixture.h"
+
+#define SERVER_ID 1
+#define RUN_MS 1000
+/* One response in CORRUPT_EVERY has a wrong CRC during the second run */
+#define CORRUPT_EVERY 10
+
+static const int bauds[] = { 9600, 19200, 38400, 57600, 115200, 230400,
+                             460800, 921600 };
+
+/* Time to send one character with a start bit, 8 data bits, the even parity
+   and a stop bit */
+static double char_time_us(int baud)
+{
+    return 11 * 1000000.0 / baud;
+}
+
+/* Length of the response to a read request of the simulated slave */
+static int response_length(const uint8_t *req)
+{
+    int nb = (req[4] << 8) + req[5];
+
+    switch (req[1]) {
+    case MODBUS_FC_READ_COILS:
+    case MODBUS_FC_READ_DISCRETE_INPUTS:
+        return 5 + (nb / 8) + ((nb % 8) ? 1 : 0);
+    case MODBUS_FC_READ_HOLDING_REGISTERS:
+    case MODBUS_FC_READ_INPUT_REGISTERS:
+        return 5 + 2 * nb;
+    default:
+        /* Echo of the start of the write requests */
+        return 8;
+    }
+}
+
+/* Sends the values of the registers asked by a read request with a wrong
+   CRC */
+static void send_corrupted_response(int fd, const uint8_t *req,
+                                    modbus_mapping_t *mb_mapping)
+{
+    uint8_t rsp[MODBUS_RTU_MAX_ADU_LENGTH];
+    int addr = (req[2] << 8) + req[3];
+    int nb = (req[4] << 8) + req[5];
+    int length = 0;
+    uint16_t crc;
+    int i;
+
+    rsp[length++] = req[0];
+    rsp[length++] = req[1];
+    rsp[length++] = nb * 2;
+    for (i = addr; i < addr + nb; i++) {
+        rsp[length++] = mb_mapping->tab_registers[i] >> 8;
+        rsp[length++] = mb_mapping->tab_registers[i] & 0xFF;
+    }
+    crc = modbus_rtu_crc16(rsp, length) ^ 0xFFFF;
+    rsp[length++] = crc >> 8;
+    rsp[length++] = crc & 0xFF;
+
+    if (write(fd, rsp, length) != length) {
+        _exit(1);
+    }
+}
+
+/* Simulated slave answering on the master side of the pseudo terminal. With
+   pacing, each response is held for the time the request and the response
+   would take on a line at this baud rate, with the t3.5 silence in between */
+static void run_slave(int pty, int baud, int pacing, int corrupt_every)
+{
+    uint8_t query[MODBUS_RTU_MAX_ADU_LENGTH];
+    modbus_mapping_t *mb_mapping;
+    modbus_t *ctx;
+    int nb_indications = 0;
+    int i;
+
+    ctx = modbus_new_rtu("/dev/null", baud, 'E', 8, 1);
+    modbus_set_slave(ctx, SERVER_ID);
+    modbus_set_socket(ctx, pty);
+
+    mb_mapping = modbus_mapping_new(0, 0, MODBUS_MAX_READ_REGISTERS, 0);
+    if (mb_mapping == NULL) {
+        _exit(1);
+    }
+    for (i = 0; i < MODBUS_MAX_READ_REGISTERS; i++) {
+        mb_mapping->tab_registers[i] = i;
+    }
+
+    for (;;) {
+        int rc = pty_receive(ctx, query);
+
+        if (pacing) {
+            double line_us = (rc + 3.5 + response_length(query)) *
+                char_time_us(baud);
+            usleep((useconds_t)line_us);
+        }
+
+        nb_indications++;
+        if (corrupt_every > 0 && nb_indications % corrupt_every == 0 &&
+            query[1] == MODBUS_FC_READ_HOLDING_REGISTERS) {
+            send_corrupted_response(pty, query, mb_mapping);
+        } else {
+            modbus_reply(ctx, query, rc, mb_mapping);
+        }
+    }
+}
+
+typedef struct {
+    int transactions;
+    int crc_errors;
+    int other_errors;
+    double rate;
+    /* Mean time of the successful transactions and of the ones ended by a
+       CRC error, in microseconds */
+    double mean_ok_us;
+    double mean_crc_us;
+    modbus_stats_t stats;
+} run_result_t;
+
+/* Reads nb registers during RUN_MS from a new simulated slave */
+static int run(int baud, int nb, int pacing, int corrupt_every,
+               run_result_t *result)
+{
+    uint16_t tab_reg[MODBUS_MAX_READ_REGISTERS];
+    modbus_t *ctx;
+    uint64_t ok_us = 0;
+    uint64_t crc_us = 0;
+    uint64_t start;
+    uint64_t end;
+    pid_t pid;
+    int pty;
+
+    memset(result, 0, sizeof(run_result_t));
+
+    pid = pty_fork(&pty);
+    if (pid == -1) {
+        return -1;
+    }
+    if (pid == 0) {
+        run_slave(pty, baud, pacing, corrupt_every);
+    }
+
+    ctx = modbus_new_rtu(ptsname(pty), baud, 'E', 8, 1);
+    modbus_set_slave(ctx, SERVER_ID);
+    if (modbus_connect(ctx) == -1) {
+        fprintf(stderr, "Connection failed: %s\n", modbus_strerror(errno));
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+        modbus_free(ctx);
+        close(pty);
+        return -1;
+    }
+    /* The flush on an invalid CRC is part of the measured cost */
+    modbus_set_error_recovery(ctx, MODBUS_ERROR_RECOVERY_PROTOCOL);
+
+    start = gettime_us();
+    end = start + RUN_MS * 1000;
+    for (;;) {
+        uint64_t before = gettime_us();
+        uint64_t after;
+        int rc;
+
+        if (before >= end)
+            break;
+
+        rc = modbus_read_registers(ctx, 0, nb, tab_reg);
+        after = gettime_us();
+        if (rc == nb) {
+            result->transactions++;
+            ok_us += after - before;
+        } else if (errno == EMBBADCRC) {
+            result->crc_errors++;
+            crc_us += after - before;
+        } else {
+            result->other_errors++;
+        }
+    }
+
+    result->rate = result->transactions * 1000000.0 / (gettime_us() - start);
+    if (result->transactions > 0)
+        result->mean_ok_us = (double)ok_us / result->transactions;
+    if (result->crc_errors > 0)
+        result->mean_crc_us = (double)crc_us / result->crc_errors;
+    modbus_get_stats(ctx, &result->stats);
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    modbus_close(ctx);
+    modbus_free(ctx);
+    close(pty);
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int nb = 10;
+    int pacing = 1;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "nopacing") == 0) {
+            pacing = 0;
+        } else if (atoi(argv[i]) > 0 && atoi(argv[i]) <= MODBUS_MAX_READ_REGISTERS) {
+            nb = atoi(argv[i]);
+        } else {
+            printf("Usage:\n  %s [nopacing] [nb registers] - Modbus RTU client "
+                   "and simulated slave to measure the transactions on a line\n\n",
+                   argv[0]);
+            exit(1);
+        }
+    }
+
+    printf("Reads of %d registers during %d ms, %s:\n\n", nb, RUN_MS,
+           pacing ? "paced at the baud rate" : "at the speed of the pseudo terminal");
+    printf("%8s %9s %6s %8s %8s %8s\n", "Baud", "Trans/s", "Line",
+           "p50 us", "p90 us", "p99 us");
+
+    for (i = 0; i < (int)(sizeof(bauds) / sizeof(bauds[0])); i++) {
+        run_result_t result;
+        /* Request, t3.5 silence and response, as held by the paced slave */
+        double line_us = (8 + 3.5 + 5 + 2 * nb) * char_time_us(bauds[i]);
+
+        if (run(bauds[i], nb, pacing, 0, &result) == -1 ||
+            result.transactions == 0 || result.other_errors > 0 ||
+            result.crc_errors > 0) {
+            printf("%8d FAILED\n", bauds[i]);
+            nb_fail++;
+            continue;
+        }
+
+        /* Share of the time the line carries the transactions, meaningless
+           without pacing */
+        printf("%8d %9.1f %5.0f%% %8d %8d %8d\n", bauds[i], result.rate,
+               pacing ? 100.0 * result.rate * line_us / 1000000.0 : 0.0,
+               (int)modbus_latency_percentile(&result.stats.response_latency, 50),
+               (int)modbus_latency_percentile(&result.stats.response_latency, 90),
+               (int)modbus_latency_percentile(&result.stats.response_latency, 99));
+    }
+
+    printf("\nWith 1 response in %d corrupted:\n\n", CORRUPT_EVERY);
+    printf("%8s %9s %8s %11s %11s\n", "Baud", "Trans/s", "CRC err",
+           "Good us", "CRC err us");
+
+    for (i = 0; i < (int)(sizeof(bauds) / sizeof(bauds[0])); i++) {
+        run_result_t result;
+
+        if (run(bauds[i], nb, pacing, CORRUPT_EVERY, &result) == -1 ||
+            result.crc_errors == 0 || result.other_errors > 0 ||
+            result.stats.crc_errors != (uint64_t)result.crc_errors) {
+            printf("%8d FAILED\n", bauds[i]);
+            nb_fail++;
+            continue;
+        }
+
+        printf("%8d %9.1f %8d %11.0f %11.0f\n", bauds[i], result.rate,
+               result.crc_errors, result.mean_ok_us, result.mean_crc_us);
+    }
+
+    if (nb_fail > 0) {
+        printf("\n%d RUNS FAILED\n", nb_fail);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright © 2008-2014 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <modbus.h>
+
+#include "pty-fixture.h"
+
+/* Only the first slave of the line answers */
+#define LIVE_SLAVE 1
+#define DEAD_SLAVE 2
+#define RUN_MS 1000
+
+/* Answers the reads of one holding register sent to LIVE_SLAVE */
+static void run_server(int pty)
+{
+    uint8_t rsp[] = { LIVE_SLAVE, 0x03, 0x02, 0x00, 0x2A, 0x00, 0x00 };
+    uint16_t crc = modbus_rtu_crc16(rsp, 5);
+    uint8_t req[8];
+
+    rsp[5] = crc >> 8;
+    rsp[6] = crc & 0xFF;
+
+    for (;;) {
+        pty_read(pty, req, sizeof(req));
+
+        if (req[0] == LIVE_SLAVE && write(pty, rsp, sizeof(rsp)) != sizeof(rsp)) {
+            _exit(1);
+        }
+    }
+}
+
+/* Removes the job after its third poll */
+static void remove_callback(modbus_scheduler_t *scheduler, int job, int rc,
+                            void *user_data)
+{
+    int *nb_calls = (int *)user_data;
+
+    (void)rc;
+    if (++(*nb_calls) == 3) {
+        modbus_scheduler_remove(scheduler, job);
+    }
+}
+
+int main(void)
+{
+    modbus_t *ctx;
+    modbus_scheduler_t *scheduler;
+    modbus_scheduler_stats_t fast;
+    modbus_scheduler_stats_t slow;
+    modbus_scheduler_stats_t dead;
+    uint16_t fast_value = 0;
+    uint16_t slow_value = 0;
+    uint16_t dead_value = 0;
+    uint16_t removed_value = 0;
+    int job_fast, job_slow, job_dead, job_removed;
+    int nb_calls = 0;
+    pid_t pid;
+    int pty;
+
+    pid = pty_fork(&pty);
+    if (pid == -1) {
+        return -1;
+    }
+    if (pid == 0) {
+        run_server(pty);
+    }
+
+    ctx = modbus_new_rtu(ptsname(pty), 115200, 'N', 8, 1);
+    if (modbus_connect(ctx) == -1) {
+        fprintf(stderr, "Connection failed: %s\n", modbus_strerror(errno));
+        kill(pid, SIGTERM);
+        modbus_free(ctx);
+        return -1;
+    }
+    /* Each poll of the dead slave holds the line for 100 ms */
+    modbus_set_response_timeout(ctx, 0, 100000);
+
+    scheduler = modbus_scheduler_new(ctx);
+    modbus_scheduler_set_backoff(scheduler, 200, 1000);
+
+    check("Invalid function",
+          modbus_scheduler_add(scheduler, LIVE_SLAVE, MODBUS_FC_WRITE_SINGLE_COIL,
+                               0, 1, &fast_value, 20, NULL, NULL) == -1 &&
+          errno == EINVAL);
+    check("Invalid number of registers",
+          modbus_scheduler_add(scheduler, LIVE_SLAVE, MODBUS_FC_READ_HOLDING_REGISTERS,
+                               0, MODBUS_MAX_READ_REGISTERS + 1, &fast_value, 20,
+                               NULL, NULL) == -1 && errno == EINVAL);
+
+    job_fast = modbus_scheduler_add(scheduler, LIVE_SLAVE,
+                                    MODBUS_FC_READ_HOLDING_REGISTERS, 0, 1,
+                                    &fast_value, 20, NULL, NULL);
+    job_dead = modbus_scheduler_add(scheduler, DEAD_SLAVE,
+                                    MODBUS_FC_READ_HOLDING_REGISTERS, 0, 1,
+                                    &dead_value, 20, NULL, NULL);
+    job_slow = modbus_scheduler_add(scheduler, LIVE_SLAVE,
+                                    MODBUS_FC_READ_HOLDING_REGISTERS, 0, 1,
+                                    &slow_value, 100, NULL, NULL);
+    job_removed = modbus_scheduler_add(scheduler, LIVE_SLAVE,
+                                       MODBUS_FC_READ_HOLDING_REGISTERS, 0, 1,
+                                       &removed_value, 50, remove_callback,
+                                       &nb_calls);
+    check("Jobs added", job_fast >= 0 && job_dead >= 0 && job_slow >= 0 &&
+          job_removed >= 0);
+
+    modbus_scheduler_run(scheduler, RUN_MS);
+
+    modbus_scheduler_get_stats(scheduler, job_fast, &fast);
+    modbus_scheduler_get_stats(scheduler, job_slow, &slow);
+    modbus_scheduler_get_stats(scheduler, job_dead, &dead);
+    printf("\nRequested and achieved rates (Hz), polls, failures, skipped:\n");
+    printf("* fast: %.1f %.1f %d %d %d\n", fast.requested_rate, fast.achieved_rate,
+           (int)fast.polls, (int)fast.failures, (int)fast.skipped);
+    printf("* slow: %.1f %.1f %d %d %d\n", slow.requested_rate, slow.achieved_rate,
+           (int)slow.polls, (int)slow.failures, (int)slow.skipped);
+    printf("* dead: %.1f %.1f %d %d %d (backoff %u ms)\n\n", dead.requested_rate,
+           dead.achieved_rate, (int)dead.polls, (int)dead.failures,
+           (int)dead.skipped, dead.backoff_ms);
+
+    check("Values read", fast_value == 0x2A && slow_value == 0x2A);
+    /* Without backoff, the dead slave would take 100 ms every 20 ms */
+    check("Fast job not starved", fast.failures == 0 &&
+          fast.achieved_rate >= fast.requested_rate / 2);
+    check("Slow job not starved", slow.failures == 0 &&
+          slow.achieved_rate >= slow.requested_rate / 2);
+    check("Dead slave backed off", dead.polls == dead.failures &&
+          dead.polls <= 5 && dead.skipped > 0 && dead.backoff_ms >= 400);
+    check("Job removed from its callback", nb_calls == 3 &&
+          modbus_scheduler_get_stats(scheduler, job_removed, &fast) == -1);
+
+    modbus_scheduler_free(scheduler);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    modbus_close(ctx);
+    modbus_free(ctx);
+    close(pty);
+
+    if (nb_fail > 0) {
+        printf("\n%d TESTS FAILED\n", nb_fail);
+        return 1;
+    }
+
+    printf("\nALL TESTS PASS WITH SUCCESS.\n");
+    return 0;
+}
@@ -0,0 +1,293 @@
+/*
+ * Copyright © 2008-2014 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <modbus.h>
+
+#define PORT 1504
+#define NB_REGISTERS 10
+#define RUN_MS 3000
+/* Descriptors kept for the standard streams, the epoll instances and the
+   listening sockets */
+#define RESERVED_FDS 64
+
+#define REQ_LENGTH 12
+#define RSP_LENGTH (9 + 2 * NB_REGISTERS)
+
+typedef struct {
+    int s;
+    uint16_t t_id;
+    int length;
+    uint8_t rsp[RSP_LENGTH];
+} master_t;
+
+typedef struct {
+    int connected;
+    uint64_t transactions;
+    uint64_t errors;
+} run_result_t;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Reads NB_REGISTERS holding registers from address 0 */
+static int send_request(master_t *master)
+{
+    uint8_t req[REQ_LENGTH] = { 0, 0, 0, 0, 0, 6, 0xFF,
+                                MODBUS_FC_READ_HOLDING_REGISTERS,
+                                0, 0, 0, NB_REGISTERS };
+
+    master->t_id++;
+    req[0] = master->t_id >> 8;
+    req[1] = master->t_id & 0xFF;
+    master->length = 0;
+
+    return send(master->s, req, sizeof(req), MSG_NOSIGNAL) == sizeof(req) ? 0 : -1;
+}
+
+static int connect_master(master_t *master)
+{
+    struct sockaddr_in addr;
+    struct linger linger = { 1, 0 };
+    int enable = 1;
+
+    master->s = socket(PF_INET, SOCK_STREAM, 0);
+    if (master->s == -1)
+        return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (connect(master->s, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        close(master->s);
+        return -1;
+    }
+
+    setsockopt(master->s, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    /* Reset on close, the ephemeral ports of the masters would otherwise
+       stay in TIME_WAIT over the runs */
+    setsockopt(master->s, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+    fcntl(master->s, F_SETFL, O_NONBLOCK);
+    master->t_id = 0;
+
+    return 0;
+}
+
+/* Returns -1 if the master can't go on */
+static int read_master(master_t *master, run_result_t *result)
+{
+    for (;;) {
+        ssize_t rc = recv(master->s, master->rsp + master->length,
+                          RSP_LENGTH - master->length, 0);
+
+        if (rc == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        if (rc <= 0)
+            return -1;
+
+        master->length += rc;
+        if (master->length < RSP_LENGTH)
+            continue;
+
+        if (((master->rsp[0] << 8) | master->rsp[1]) != master->t_id ||
+            master->rsp[7] != MODBUS_FC_READ_HOLDING_REGISTERS ||
+            master->rsp[8] != 2 * NB_REGISTERS) {
+            result->errors++;
+            return -1;
+        }
+        result->transactions++;
+        if (send_request(master) == -1)
+            return -1;
+    }
+}
+
+/* Connects the masters, then each of them sends a request as soon as it gets
+   the response to the previous one during RUN_MS */
+static void run_masters(int nb_masters, run_result_t *result)
+{
+    struct epoll_event events[256];
+    master_t *masters;
+    double end;
+    int epfd;
+    int i;
+
+    memset(result, 0, sizeof(run_result_t));
+    masters = (master_t *)calloc(nb_masters, sizeof(master_t));
+    epfd = epoll_create1(0);
+
+    for (i = 0; i < nb_masters; i++) {
+        struct epoll_event event;
+
+        if (connect_master(&masters[i]) == -1)
+            break;
+        event.events = EPOLLIN | EPOLLET;
+        event.data.ptr = &masters[i];
+        epoll_ctl(epfd, EPOLL_CTL_ADD, masters[i].s, &event);
+    }
+    result->connected = i;
+
+    for (i = 0; i < result->connected; i++) {
+        if (send_request(&masters[i]) == -1)
+            result->errors++;
+    }
+
+    end = now_ms() + RUN_MS;
+    while (now_ms() < end) {
+        int nb_events = epoll_wait(epfd, events, 256, 100);
+
+        for (i = 0; i < nb_events; i++) {
+            master_t *master = events[i].data.ptr;
+
+            if (read_master(master, result) == -1) {
+                epoll_ctl(epfd, EPOLL_CTL_DEL, master->s, NULL);
+                result->errors++;
+            }
+        }
+    }
+
+    for (i = 0; i < result->connected; i++)
+        close(masters[i].s);
+    close(epfd);
+    free(masters);
+}
+
+static int run(modbus_mapping_t *mb_mapping, int nb_workers, int nb_masters,
+               run_result_t *result, modbus_server_stats_t *stats)
+{
+    modbus_server_t *server;
+    int fds[2];
+    pid_t pid;
+    int rc = 0;
+
+    server = modbus_server_new("127.0.0.1", PORT, mb_mapping);
+    if (server == NULL || modbus_server_start(server, nb_workers) == -1) {
+        fprintf(stderr, "Unable to start the server: %s\n",
+                modbus_strerror(errno));
+        modbus_server_free(server);
+        return -1;
+    }
+
+    /* The masters run in their own process, the descriptors of both ends
+       of the connections wouldn't fit in one */
+    if (pipe(fds) == -1 || (pid = fork()) == -1) {
+        modbus_server_free(server);
+        return -1;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        run_masters(nb_masters, result);
+        rc = write(fds[1], result, sizeof(run_result_t)) == sizeof(run_result_t);
+        _exit(rc ? 0 : 1);
+    }
+
+    close(fds[1]);
+    if (read(fds[0], result, sizeof(run_result_t)) != sizeof(run_result_t))
+        rc = -1;
+    close(fds[0]);
+    waitpid(pid, NULL, 0);
+
+    modbus_server_stop(server);
+    modbus_server_get_stats(server, stats);
+    modbus_server_free(server);
+
+    return rc;
+}
+
+int main(int argc, char *argv[])
+{
+    modbus_mapping_t *mb_mapping;
+    struct rlimit limit;
+    int nb_masters = 10000;
+    int max_workers = sysconf(_SC_NPROCESSORS_ONLN);
+    int nb_fail = 0;
+    int nb_workers;
+
+    if (argc > 3 || (argc > 1 && atoi(argv[1]) <= 0) ||
+        (argc > 2 && atoi(argv[2]) <= 0)) {
+        printf("Usage:\n  %s [nb masters [nb workers]] - Modbus TCP masters "
+               "reading the registers of a modbus_server_t on the loopback\n\n",
+               argv[0]);
+        exit(1);
+    }
+    if (argc > 1)
+        nb_masters = atoi(argv[1]);
+    if (argc > 2)
+        max_workers = atoi(argv[2]);
+    if (max_workers < 1)
+        max_workers = 1;
+
+    /* Each side of the loopback holds one descriptor per master */
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+        if (limit.rlim_cur != RLIM_INFINITY &&
+            (rlim_t)nb_masters + RESERVED_FDS > limit.rlim_cur) {
+            nb_masters = limit.rlim_cur - RESERVED_FDS;
+            printf("Limited to %d masters by the number of descriptors\n",
+                   nb_masters);
+        }
+    }
+
+    mb_mapping = modbus_mapping_new(0, 0, NB_REGISTERS, 0);
+    if (mb_mapping == NULL) {
+        fprintf(stderr, "Failed to allocate the mapping: %s\n",
+                modbus_strerror(errno));
+        return -1;
+    }
+
+    printf("%d masters reading %d registers during %d ms:\n\n", nb_masters,
+           NB_REGISTERS, RUN_MS);
+    printf("%8s %10s %10s %10s %8s\n", "Workers", "Connected", "Trans/s",
+           "Answered", "Errors");
+
+    /* Doubles the workers up to the maximum */
+    for (nb_workers = 1; ; nb_workers *= 2) {
+        run_result_t result;
+        modbus_server_stats_t stats;
+
+        if (nb_workers > max_workers)
+            nb_workers = max_workers;
+
+        if (run(mb_mapping, nb_workers, nb_masters, &result, &stats) == -1 ||
+            result.connected < nb_masters || result.errors > 0 ||
+            stats.connections != (uint64_t)result.connected ||
+            stats.requests < result.transactions) {
+            printf("%8d FAILED\n", nb_workers);
+            nb_fail++;
+        } else {
+            printf("%8d %10d %10.0f %10llu %8llu\n", nb_workers,
+                   result.connected, result.transactions * 1000.0 / RUN_MS,
+                   (unsigned long long)stats.requests,
+                   (unsigned long long)result.errors);
+        }
+
+        if (nb_workers == max_workers)
+            break;
+    }
+
+    modbus_mapping_free(mb_mapping);
+
+    return nb_fail == 0 ? 0 : -1;
+}
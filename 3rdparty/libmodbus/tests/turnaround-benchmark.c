@@ -0,0 +1,97 @@
+/*
+ * Copyright © 2008-2014 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <modbus.h>
+
+#define NB_SAMPLES 200
+
+static void print_latency(const char *name, const modbus_latency_t *latency)
+{
+    printf("  %-10s min %6u us, p50 %6u us, p99 %6u us, max %6u us\n", name,
+           (unsigned int)latency->min,
+           (unsigned int)modbus_latency_percentile(latency, 50),
+           (unsigned int)modbus_latency_percentile(latency, 99),
+           (unsigned int)latency->max);
+}
+
+/* Measures the turnaround of a slave through a serial port without and with
+   the low latency profile */
+static int measure(const char *device, int baud, int slave, int addr,
+                   int low_latency)
+{
+    modbus_latency_t first_byte;
+    modbus_latency_t response;
+    modbus_t *ctx;
+    int rc;
+
+    ctx = modbus_new_rtu(device, baud, 'N', 8, 1);
+    if (ctx == NULL) {
+        fprintf(stderr, "Unable to allocate libmodbus context\n");
+        return -1;
+    }
+    modbus_set_slave(ctx, slave);
+    if (modbus_rtu_set_low_latency(ctx, low_latency) == -1 && low_latency) {
+        fprintf(stderr, "Low latency profile: %s\n", modbus_strerror(errno));
+        modbus_free(ctx);
+        return -1;
+    }
+    if (modbus_connect(ctx) == -1) {
+        fprintf(stderr, "Connection failed: %s\n", modbus_strerror(errno));
+        modbus_free(ctx);
+        return -1;
+    }
+
+    rc = modbus_measure_turnaround(ctx, addr, NB_SAMPLES, &first_byte,
+                                   &response);
+    if (rc == -1) {
+        fprintf(stderr, "No response: %s\n", modbus_strerror(errno));
+    } else {
+        printf("Low latency profile %s, %d/%d samples:\n",
+               low_latency ? "on" : "off", rc, NB_SAMPLES);
+        print_latency("first byte", &first_byte);
+        print_latency("response", &response);
+    }
+
+    modbus_close(ctx);
+    modbus_free(ctx);
+
+    return rc;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *device;
+    int baud = 115200;
+    int slave = 1;
+    int addr = 0;
+
+    if (argc < 2) {
+        printf("Usage:\n  %s DEVICE [BAUD [SLAVE [ADDRESS]]]\n"
+               "Reads a holding register of the slave (1 and 0 by default) "
+               "at 115200 bauds, 8N1, with the low latency profile of the "
+               "serial port off then on\n", argv[0]);
+        return -1;
+    }
+
+    device = argv[1];
+    if (argc > 2)
+        baud = atoi(argv[2]);
+    if (argc > 3)
+        slave = atoi(argv[3]);
+    if (argc > 4)
+        addr = atoi(argv[4]);
+
+    if (measure(device, baud, slave, addr, FALSE) == -1 ||
+        measure(device, baud, slave, addr, TRUE) == -1) {
+        return -1;
+    }
+
+    return 0;
+}
@@ -9,6 +9,11 @@
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#ifndef _WIN32
+# include <fcntl.h>
+# include <sys/select.h>
+# include <sys/time.h>
+#endif
 #include <modbus.h>
 
 #include "unit-test.h"
@@ -27,6 +32,10 @@ int send_crafted_request(modbus_t *ctx, int function,
                          uint16_t max_value, uint16_t bytes,
                          int backend_length, int backend_offset);
 int equal_dword(uint16_t *tab_reg, const uint32_t value);
+#ifndef _WIN32
+void reactor_callback(modbus_reactor_t *reactor, modbus_t *ctx, int rc,
+                      void *user_data);
+#endif
 
 #define BUG_REPORT(_cond, _format, _args ...) \
     printf("\nLine %d: assertion error for '%s': " _format "\n", __LINE__, # _cond, ## _args)
@@ -44,12 +53,26 @@ int equal_dword(uint16_t *tab_reg, const uint32_t value) {
     return ((tab_reg[0] == (value >> 16)) && (tab_reg[1] == (value & 0xFFFF)));
 }
 
+#ifndef _WIN32
+/* Stores the result of the transaction in the int given as user data */
+void reactor_callback(modbus_reactor_t *reactor, modbus_t *ctx, int rc,
+                      void *user_data)
+{
+    (void)reactor;
+    (void)ctx;
+    *(int *)user_data = rc;
+}
+#endif
+
 int main(int argc, char *argv[])
 {
     const int NB_REPORT_SLAVE_ID = 10;
     uint8_t *tab_rp_bits = NULL;
     uint16_t *tab_rp_registers = NULL;
     uint16_t *tab_rp_registers_bad = NULL;
+    const uint8_t *tab_rp_view;
+    uint8_t tab_bytes[2 * 19];
+    uint16_t tab_swapped[19];
     modbus_t *ctx = NULL;
     int i;
     uint8_t value;
@@ -63,18 +86,29 @@ int main(int argc, char *argv[])
     uint32_t old_byte_to_sec;
     uint32_t old_byte_to_usec;
     int use_backend;
+    modbus_uring_t *ring = NULL;
     int success = FALSE;
     int old_slave;
+    modbus_stats_t stats;
 
     if (argc > 1) {
         if (strcmp(argv[1], "tcp") == 0) {
             use_backend = TCP;
+        } else if (strcmp(argv[1], "tcpuring") == 0) {
+            /* TCP through the io_uring backend */
+            use_backend = TCP;
+            ring = modbus_uring_new(1);
+            if (ring == NULL) {
+                fprintf(stderr, "Unable to create the ring: %s\n",
+                        modbus_strerror(errno));
+                return -1;
+            }
         } else if (strcmp(argv[1], "tcppi") == 0) {
             use_backend = TCP_PI;
         } else if (strcmp(argv[1], "rtu") == 0) {
             use_backend = RTU;
         } else {
-            printf("Usage:\n  %s [tcp|tcppi|rtu] - Modbus client for unit testing\n\n", argv[0]);
+            printf("Usage:\n  %s [tcp|tcpuring|tcppi|rtu] - Modbus client for unit testing\n\n", argv[0]);
             exit(1);
         }
     } else {
@@ -82,7 +116,9 @@ int main(int argc, char *argv[])
         use_backend = TCP;
     }
 
-    if (use_backend == TCP) {
+    if (ring != NULL) {
+        ctx = modbus_new_tcp_uring(ring, "127.0.0.1", 1502);
+    } else if (use_backend == TCP) {
         ctx = modbus_new_tcp("127.0.0.1", 1502);
     } else if (use_backend == TCP_PI) {
         ctx = modbus_new_tcp_pi("::1", "1502");
@@ -150,12 +186,12 @@ int main(int argc, char *argv[])
 
         modbus_set_bits_from_bytes(tab_value, 0, UT_BITS_NB, UT_BITS_TAB);
         rc = modbus_write_bits(ctx, UT_BITS_ADDRESS, UT_BITS_NB, tab_value);
-        printf("1/2 modbus_write_bits: ");
+        printf("1/3 modbus_write_bits: ");
         ASSERT_TRUE(rc == UT_BITS_NB, "");
     }
 
     rc = modbus_read_bits(ctx, UT_BITS_ADDRESS, UT_BITS_NB, tab_rp_bits);
-    printf("2/2 modbus_read_bits: ");
+    printf("2/3 modbus_read_bits: ");
     ASSERT_TRUE(rc == UT_BITS_NB, "FAILED (nb points %d)\n", rc);
 
     i = 0;
@@ -171,12 +207,24 @@ int main(int argc, char *argv[])
         i++;
     }
     printf("OK\n");
+
+    {
+        uint8_t tab_packed[sizeof(UT_BITS_TAB)];
+
+        rc = modbus_read_bits_packed(ctx, UT_BITS_ADDRESS, UT_BITS_NB,
+                                     tab_packed);
+        printf("3/3 modbus_read_bits_packed: ");
+        ASSERT_TRUE(rc == UT_BITS_NB, "FAILED (nb points %d)\n", rc);
+        ASSERT_TRUE(memcmp(tab_packed, UT_BITS_TAB, sizeof(UT_BITS_TAB)) == 0,
+                    "FAILED (%0X %0X %0X %0X %0X)\n", tab_packed[0],
+                    tab_packed[1], tab_packed[2], tab_packed[3], tab_packed[4]);
+    }
     /* End of multiple bits */
 
     /** DISCRETE INPUTS **/
     rc = modbus_read_input_bits(ctx, UT_INPUT_BITS_ADDRESS,
                                 UT_INPUT_BITS_NB, tab_rp_bits);
-    printf("1/1 modbus_read_input_bits: ");
+    printf("1/2 modbus_read_input_bits: ");
     ASSERT_TRUE(rc == UT_INPUT_BITS_NB, "FAILED (nb points %d)\n", rc);
 
     i = 0;
@@ -192,6 +240,19 @@ int main(int argc, char *argv[])
     }
     printf("OK\n");
 
+    {
+        uint8_t tab_packed[sizeof(UT_INPUT_BITS_TAB)];
+
+        rc = modbus_read_input_bits_packed(ctx, UT_INPUT_BITS_ADDRESS,
+                                           UT_INPUT_BITS_NB, tab_packed);
+        printf("2/2 modbus_read_input_bits_packed: ");
+        ASSERT_TRUE(rc == UT_INPUT_BITS_NB, "FAILED (nb points %d)\n", rc);
+        ASSERT_TRUE(memcmp(tab_packed, UT_INPUT_BITS_TAB,
+                           sizeof(UT_INPUT_BITS_TAB)) == 0,
+                    "FAILED (%0X %0X %0X)\n", tab_packed[0], tab_packed[1],
+                    tab_packed[2]);
+    }
+
     /** HOLDING REGISTERS **/
 
     /* Single register */
@@ -257,6 +318,19 @@ int main(int argc, char *argv[])
                     tab_rp_registers[i], 0);
     }
 
+    /* Big-endian values in the response buffer of the context */
+    rc = modbus_read_registers_view(ctx, UT_REGISTERS_ADDRESS,
+                                    UT_REGISTERS_NB, &tab_rp_view);
+    printf("5/5 modbus_read_registers_view: ");
+    ASSERT_TRUE(rc == UT_REGISTERS_NB, "FAILED (nb points %d)\n", rc);
+
+    for (i=0; i < UT_REGISTERS_NB; i++) {
+        ASSERT_TRUE(((tab_rp_view[2 * i] << 8) | tab_rp_view[2 * i + 1]) ==
+                    tab_rp_registers[i], "FAILED (%0X != %0X)\n",
+                    (tab_rp_view[2 * i] << 8) | tab_rp_view[2 * i + 1],
+                    tab_rp_registers[i]);
+    }
+
     /* End of many registers */
 
 
@@ -264,7 +338,7 @@ int main(int argc, char *argv[])
     rc = modbus_read_input_registers(ctx, UT_INPUT_REGISTERS_ADDRESS,
                                      UT_INPUT_REGISTERS_NB,
                                      tab_rp_registers);
-    printf("1/1 modbus_read_input_registers: ");
+    printf("1/2 modbus_read_input_registers: ");
     ASSERT_TRUE(rc == UT_INPUT_REGISTERS_NB, "FAILED (nb points %d)\n", rc);
 
     for (i=0; i < UT_INPUT_REGISTERS_NB; i++) {
@@ -273,6 +347,18 @@ int main(int argc, char *argv[])
                     tab_rp_registers[i], UT_INPUT_REGISTERS_TAB[i]);
     }
 
+    rc = modbus_read_input_registers_view(ctx, UT_INPUT_REGISTERS_ADDRESS,
+                                          UT_INPUT_REGISTERS_NB, &tab_rp_view);
+    printf("2/2 modbus_read_input_registers_view: ");
+    ASSERT_TRUE(rc == UT_INPUT_REGISTERS_NB, "FAILED (nb points %d)\n", rc);
+
+    for (i=0; i < UT_INPUT_REGISTERS_NB; i++) {
+        ASSERT_TRUE(((tab_rp_view[2 * i] << 8) | tab_rp_view[2 * i + 1]) ==
+                    UT_INPUT_REGISTERS_TAB[i], "FAILED (%0X != %0X)\n",
+                    (tab_rp_view[2 * i] << 8) | tab_rp_view[2 * i + 1],
+                    UT_INPUT_REGISTERS_TAB[i]);
+    }
+
     /* MASKS */
     printf("1/1 Write mask: ");
     rc = modbus_write_register(ctx, UT_REGISTERS_ADDRESS, 0x12);
@@ -283,6 +369,144 @@ int main(int argc, char *argv[])
                 "FAILED (%0X != %0X)\n",
                 tab_rp_registers[0], 0x17);
 
+    /** PIPELINED REQUESTS **/
+    if (use_backend != RTU) {
+        int t_id;
+        int t_id_write;
+        int t_id_read;
+        int t_id_input;
+        uint16_t tab_input_registers[1];
+
+        printf("\nTEST PIPELINED REQUESTS:\n");
+
+        rc = modbus_set_max_in_flight(ctx, 3);
+        printf("1/4 modbus_set_max_in_flight: ");
+        ASSERT_TRUE(rc == 0, "");
+
+        /* The registers are read back after the write in the same window */
+        memset(tab_rp_registers, 0, UT_REGISTERS_NB * sizeof(uint16_t));
+        t_id_write = modbus_submit_write_registers(ctx, UT_REGISTERS_ADDRESS,
+                                                   UT_REGISTERS_NB,
+                                                   UT_REGISTERS_TAB);
+        t_id_read = modbus_submit_read_registers(ctx, UT_REGISTERS_ADDRESS,
+                                                 UT_REGISTERS_NB,
+                                                 tab_rp_registers);
+        t_id_input = modbus_submit_read_input_registers(ctx,
+                                                        UT_INPUT_REGISTERS_ADDRESS,
+                                                        UT_INPUT_REGISTERS_NB,
+                                                        tab_input_registers);
+        printf("2/4 modbus_submit_*: ");
+        ASSERT_TRUE(t_id_write != -1 && t_id_read != -1 && t_id_input != -1 &&
+                    modbus_get_in_flight(ctx) == 3, "FAILED (%d in flight)\n",
+                    modbus_get_in_flight(ctx));
+
+        rc = modbus_submit_read_registers(ctx, UT_REGISTERS_ADDRESS,
+                                          UT_REGISTERS_NB, tab_rp_registers);
+        printf("3/4 No submit when the window is full: ");
+        ASSERT_TRUE(rc == -1 && errno == EAGAIN, "");
+
+        printf("4/4 modbus_complete: ");
+        for (i = 0; i < 3; i++) {
+            rc = modbus_complete(ctx, &t_id);
+            if (t_id == t_id_write) {
+                ASSERT_TRUE(rc == UT_REGISTERS_NB, "FAILED (write %d)\n", rc);
+            } else if (t_id == t_id_read) {
+                ASSERT_TRUE(rc == UT_REGISTERS_NB &&
+                            tab_rp_registers[0] == UT_REGISTERS_TAB[0] &&
+                            tab_rp_registers[2] == UT_REGISTERS_TAB[2],
+                            "FAILED (read %d)\n", rc);
+            } else if (t_id == t_id_input) {
+                ASSERT_TRUE(rc == UT_INPUT_REGISTERS_NB &&
+                            tab_input_registers[0] == UT_INPUT_REGISTERS_TAB[0],
+                            "FAILED (read input %d)\n", rc);
+            } else {
+                ASSERT_TRUE(FALSE, "FAILED (unknown transaction ID %d)\n", t_id);
+            }
+        }
+        ASSERT_TRUE(modbus_get_in_flight(ctx) == 0, "");
+        modbus_set_max_in_flight(ctx, 1);
+    }
+
+    /** REACTOR **/
+#ifndef _WIN32
+    {
+        modbus_reactor_t *reactor;
+        uint16_t tab_input_registers[1];
+        int rc_write = 0;
+        int rc_read = 0;
+        int rc_input = 0;
+        int nb_completed = 0;
+
+        printf("\nTEST REACTOR:\n");
+
+        reactor = modbus_reactor_new();
+        rc = modbus_reactor_add(reactor, ctx);
+        printf("1/4 modbus_reactor_add: ");
+        ASSERT_TRUE(reactor != NULL && rc == 0, "");
+
+        memset(tab_rp_registers, 0, UT_REGISTERS_NB * sizeof(uint16_t));
+        modbus_reactor_write_registers(reactor, ctx, UT_REGISTERS_ADDRESS,
+                                       UT_REGISTERS_NB, UT_REGISTERS_TAB,
+                                       reactor_callback, &rc_write);
+        modbus_reactor_read_registers(reactor, ctx, UT_REGISTERS_ADDRESS,
+                                      UT_REGISTERS_NB, tab_rp_registers,
+                                      reactor_callback, &rc_read);
+        modbus_reactor_read_input_registers(reactor, ctx,
+                                            UT_INPUT_REGISTERS_ADDRESS,
+                                            UT_INPUT_REGISTERS_NB,
+                                            tab_input_registers,
+                                            reactor_callback, &rc_input);
+        printf("2/4 modbus_reactor_get_pending: ");
+        ASSERT_TRUE(modbus_reactor_get_pending(reactor) == 3, "");
+
+        rc = modbus_reactor_remove(reactor, ctx);
+        printf("3/4 No removal with pending requests: ");
+        ASSERT_TRUE(rc == -1 && errno == EBUSY, "");
+
+        while (modbus_reactor_get_pending(reactor) > 0) {
+            rc = modbus_reactor_run(reactor, 1000);
+            if (rc <= 0)
+                break;
+            nb_completed += rc;
+        }
+        printf("4/4 modbus_reactor_run: ");
+        ASSERT_TRUE(nb_completed == 3 &&
+                    rc_write == UT_REGISTERS_NB &&
+                    rc_read == UT_REGISTERS_NB &&
+                    tab_rp_registers[0] == UT_REGISTERS_TAB[0] &&
+                    tab_rp_registers[2] == UT_REGISTERS_TAB[2] &&
+                    rc_input == UT_INPUT_REGISTERS_NB &&
+                    tab_input_registers[0] == UT_INPUT_REGISTERS_TAB[0],
+                    "FAILED (%d completed, %d %d %d)\n", nb_completed,
+                    rc_write, rc_read, rc_input);
+
+        modbus_reactor_remove(reactor, ctx);
+        modbus_reactor_free(reactor);
+    }
+#endif
+
+    /** DESCRIPTOR ABOVE FD_SETSIZE **/
+#ifndef _WIN32
+    if (use_backend != RTU) {
+        /* select() can't wait on such a descriptor */
+        int old_s = modbus_get_socket(ctx);
+        int high_s = fcntl(old_s, F_DUPFD, FD_SETSIZE + 1);
+
+        printf("\nTEST DESCRIPTOR ABOVE FD_SETSIZE:\n");
+        if (high_s == -1) {
+            printf("1/1 Skipped (%s)\n", modbus_strerror(errno));
+        } else {
+            modbus_set_socket(ctx, high_s);
+            rc = modbus_read_registers(ctx, UT_REGISTERS_ADDRESS,
+                                       UT_REGISTERS_NB, tab_rp_registers);
+            modbus_set_socket(ctx, old_s);
+            close(high_s);
+            printf("1/1 modbus_read_registers: ");
+            ASSERT_TRUE(rc == UT_REGISTERS_NB, "FAILED (nb points %d)\n", rc);
+        }
+    }
+#endif
+
     printf("\nTEST FLOATS\n");
     /** FLOAT **/
     printf("1/4 Set/get float ABCD: ");
@@ -309,6 +533,43 @@ int main(int argc, char *argv[])
     real = modbus_get_float_cdab(tab_rp_registers);
     ASSERT_TRUE(real == UT_REAL, "FAILED (%f != %f)\n", real, UT_REAL);
 
+    /** REGISTERS FROM BYTES **/
+    /* 19 registers go through the blocks of 8 and the remaining ones */
+    printf("\nTEST REGISTERS FROM BYTES\n");
+    for (i=0; i < 2 * 19; i++) {
+        tab_bytes[i] = i * 7 + 1;
+    }
+    printf("1/2 modbus_set_registers_from_bytes: ");
+    modbus_set_registers_from_bytes(tab_swapped, tab_bytes, 19);
+    for (i=0; i < 19; i++) {
+        ASSERT_TRUE(tab_swapped[i] ==
+                    ((tab_bytes[2 * i] << 8) | tab_bytes[2 * i + 1]),
+                    "FAILED (%0X at %d)\n", tab_swapped[i], i);
+    }
+
+    printf("2/2 modbus_set_registers_from_bytes in place: ");
+    memcpy(tab_swapped, tab_bytes, sizeof(tab_bytes));
+    modbus_set_registers_from_bytes(tab_swapped, (uint8_t *)tab_swapped, 19);
+    for (i=0; i < 19; i++) {
+        ASSERT_TRUE(tab_swapped[i] ==
+                    ((tab_bytes[2 * i] << 8) | tab_bytes[2 * i + 1]),
+                    "FAILED (%0X at %d)\n", tab_swapped[i], i);
+    }
+
+    /** BITS FROM BYTES **/
+    printf("\nTEST BITS FROM BYTES\n");
+    printf("1/1 modbus_set_bits_from_bytes at an index: ");
+    memset(tab_bytes, 0xFF, sizeof(tab_bytes));
+    /* 2 full bytes and 5 bits, the bits around are left untouched */
+    modbus_set_bits_from_bytes(tab_bytes, 3, UT_BITS_NB - 16, UT_BITS_TAB);
+    ASSERT_TRUE(tab_bytes[0] == 0xFF && tab_bytes[2] == 0xFF &&
+                tab_bytes[3 + UT_BITS_NB - 16] == 0xFF, "FAILED (overflow)\n");
+    for (i=0; i < UT_BITS_NB - 16; i++) {
+        ASSERT_TRUE(tab_bytes[3 + i] ==
+                    ((UT_BITS_TAB[i / 8] >> (i % 8)) & 1),
+                    "FAILED (%0X at %d)\n", tab_bytes[3 + i], i);
+    }
+
     printf("\nAt this point, error messages doesn't mean the test has failed\n");
 
     /** ILLEGAL DATA ADDRESS **/
@@ -611,7 +872,7 @@ int main(int argc, char *argv[])
         modbus_set_byte_timeout(ctx, 0, 3000);
         rc = modbus_read_registers(ctx, UT_REGISTERS_ADDRESS_BYTE_SLEEP_5_MS,
                                    1, tab_rp_registers);
-        printf("1/2 Too small byte timeout (3ms < 5ms): ");
+        printf("1/4 Too small byte timeout (3ms < 5ms): ");
         ASSERT_TRUE(rc == -1 && errno == ETIMEDOUT, "");
 
         /* Wait remaing bytes before flushing */
@@ -622,13 +883,78 @@ int main(int argc, char *argv[])
         modbus_set_byte_timeout(ctx, 0, 7000);
         rc = modbus_read_registers(ctx, UT_REGISTERS_ADDRESS_BYTE_SLEEP_5_MS,
                                    1, tab_rp_registers);
-        printf("2/2 Adapted byte timeout (7ms > 5ms): ");
+        printf("2/4 Adapted byte timeout (7ms > 5ms): ");
         ASSERT_TRUE(rc == 1, "");
+
+        /* The 11 bytes of the response take 55ms, each one in time for the
+           byte timeout but not for the transaction timeout */
+        modbus_set_transaction_timeout(ctx, 0, 30000);
+        rc = modbus_read_registers(ctx, UT_REGISTERS_ADDRESS_BYTE_SLEEP_5_MS,
+                                   1, tab_rp_registers);
+        printf("3/4 Too small transaction timeout (30ms < 55ms): ");
+        ASSERT_TRUE(rc == -1 && errno == ETIMEDOUT, "");
+
+        /* Wait remaing bytes before flushing, the server is still in the
+           middle of the previous response */
+        usleep(2 * 11 * 5000);
+        modbus_flush(ctx);
+
+        modbus_set_transaction_timeout(ctx, 0, 200000);
+        rc = modbus_read_registers(ctx, UT_REGISTERS_ADDRESS_BYTE_SLEEP_5_MS,
+                                   1, tab_rp_registers);
+        printf("4/4 Adapted transaction timeout (200ms > 55ms): ");
+        ASSERT_TRUE(rc == 1, "");
+
+        modbus_set_transaction_timeout(ctx, 0, 0);
     }
 
     /* Restore original byte timeout */
     modbus_set_byte_timeout(ctx, old_byte_to_sec, old_byte_to_usec);
 
+    /** ADAPTIVE RESPONSE TIMEOUT **/
+    printf("\nTEST ADAPTIVE RESPONSE TIMEOUT:\n");
+    {
+        const int rtt_slave = (use_backend == RTU) ? SERVER_ID : MODBUS_TCP_SLAVE;
+        uint32_t learned_sec;
+        uint32_t learned_usec;
+        uint32_t doubled_sec;
+        uint32_t doubled_usec;
+
+        modbus_get_slave_response_timeout(ctx, rtt_slave, &learned_sec, &learned_usec);
+        printf("1/5 Response timeout of the context until enabled: ");
+        ASSERT_TRUE(learned_sec == old_response_to_sec &&
+                    learned_usec == old_response_to_usec, "");
+
+        rc = modbus_set_adaptive_timeout(ctx, 2000, 1000);
+        printf("2/5 Invalid bounds: ");
+        ASSERT_TRUE(rc == -1 && errno == EINVAL, "");
+
+        /* The latencies of the previous tests are already known */
+        modbus_set_adaptive_timeout(ctx, 20000, 2000000);
+        for (i = 0; i < 50; i++) {
+            modbus_read_registers(ctx, UT_REGISTERS_ADDRESS, 1, tab_rp_registers);
+        }
+        modbus_get_slave_response_timeout(ctx, rtt_slave, &learned_sec, &learned_usec);
+        printf("3/5 Timeout learned from a fast slave (%d us): ",
+               learned_sec * 1000000 + learned_usec);
+        ASSERT_TRUE(learned_sec == 0 && learned_usec >= 20000 &&
+                    learned_usec < old_response_to_usec, "");
+
+        rc = modbus_read_registers(ctx, UT_REGISTERS_ADDRESS_SLEEP_500_MS,
+                                   1, tab_rp_registers);
+        printf("4/5 Late response timed out: ");
+        ASSERT_TRUE(rc == -1 && errno == ETIMEDOUT, "");
+
+        modbus_get_slave_response_timeout(ctx, rtt_slave, &doubled_sec, &doubled_usec);
+        printf("5/5 Timeout doubled after a timeout: ");
+        ASSERT_TRUE(doubled_sec == 0 && doubled_usec == 2 * learned_usec, "");
+
+        /* Wait for the late response before flushing */
+        usleep(600000);
+        modbus_flush(ctx);
+        modbus_set_adaptive_timeout(ctx, 0, 0);
+    }
+
     /** BAD RESPONSE **/
     printf("\nTEST BAD RESPONSE ERROR:\n");
 
@@ -650,6 +976,59 @@ int main(int argc, char *argv[])
     printf("* modbus_read_registers at special address: ");
     ASSERT_TRUE(rc == -1 && errno == EMBXSBUSY, "");
 
+    /** STATISTICS **/
+    printf("\nTEST STATISTICS:\n");
+    modbus_reset_stats(ctx);
+    rc = modbus_read_registers(ctx, UT_REGISTERS_ADDRESS,
+                               UT_REGISTERS_NB, tab_rp_registers);
+    modbus_get_stats(ctx, &stats);
+    printf("1/5 modbus_get_stats after a read: ");
+    ASSERT_TRUE(rc == UT_REGISTERS_NB &&
+                stats.requests == 1 && stats.responses == 1 &&
+                stats.bytes_out == (uint64_t)(modbus_get_header_length(ctx) + 5 +
+                                              (use_backend == RTU ? 2 : 0)) &&
+                stats.bytes_in == (uint64_t)(modbus_get_header_length(ctx) + 2 +
+                                             UT_REGISTERS_NB * 2 +
+                                             (use_backend == RTU ? 2 : 0)) &&
+                stats.first_byte_latency.count == 1 &&
+                stats.response_latency.count == 1 &&
+                stats.first_byte_latency.max <= stats.response_latency.max,
+                "requests %d, responses %d, bytes %d/%d\n",
+                (int)stats.requests, (int)stats.responses,
+                (int)stats.bytes_out, (int)stats.bytes_in);
+
+    rc = modbus_read_registers(ctx, UT_REGISTERS_ADDRESS_SPECIAL,
+                               UT_REGISTERS_NB, tab_rp_registers);
+    modbus_get_stats(ctx, &stats);
+    printf("2/5 modbus_get_stats after an exception: ");
+    ASSERT_TRUE(rc == -1 && stats.responses == 2 && stats.exceptions == 1 &&
+                stats.exceptions_by_function[MODBUS_FC_READ_HOLDING_REGISTERS] == 1 &&
+                stats.exceptions_by_code[MODBUS_EXCEPTION_SLAVE_OR_SERVER_BUSY] == 1 &&
+                stats.timeouts == 0 && stats.crc_errors == 0, "");
+
+    printf("3/5 modbus_latency_percentile: ");
+    ASSERT_TRUE(modbus_latency_percentile(&stats.response_latency, 100) ==
+                stats.response_latency.max &&
+                modbus_latency_percentile(&stats.response_latency, 50) >=
+                stats.response_latency.min &&
+                modbus_latency_percentile(&stats.response_latency, 50) <=
+                stats.response_latency.max, "");
+
+    rc = modbus_measure_turnaround(ctx, UT_REGISTERS_ADDRESS, 10,
+                                   &stats.first_byte_latency,
+                                   &stats.response_latency);
+    printf("4/5 modbus_measure_turnaround: ");
+    ASSERT_TRUE(rc == 10 && stats.first_byte_latency.count == 10 &&
+                stats.response_latency.count == 10 &&
+                stats.first_byte_latency.max <= stats.response_latency.max,
+                "rc %d", rc);
+
+    /* Exception responses measure the turnaround as well */
+    rc = modbus_measure_turnaround(ctx, UT_REGISTERS_ADDRESS_SPECIAL, 2,
+                                   NULL, &stats.response_latency);
+    printf("5/5 modbus_measure_turnaround with exceptions: ");
+    ASSERT_TRUE(rc == 2 && stats.response_latency.count == 2, "rc %d", rc);
+
     /** Run a few tests to challenge the server code **/
     if (test_server(ctx, use_backend) == -1) {
         goto close;
@@ -670,6 +1049,222 @@ int main(int argc, char *argv[])
     ctx = modbus_new_tcp_pi(NULL, NULL);
     ASSERT_TRUE(ctx == NULL && errno == EINVAL, "");
 
+#ifndef _WIN32
+    /** RTU FRAME GAP **/
+    printf("\nTEST RTU FRAME GAP:\n");
+    {
+        /* Response to a read of 3 registers cut after its byte count */
+        const uint8_t truncated_rsp[] = { SERVER_ID, 0x03, 0x06, 0x02, 0x2B };
+        int pty = posix_openpt(O_RDWR | O_NOCTTY);
+
+        ASSERT_TRUE(pty != -1 && grantpt(pty) == 0 && unlockpt(pty) == 0,
+                    "Unable to open a pseudo terminal (%s)", modbus_strerror(errno));
+        ctx = modbus_new_rtu(ptsname(pty), 19200, 'N', 8, 1);
+
+        rc = modbus_rtu_get_frame_gap(ctx);
+        printf("1/4 Disabled by default: ");
+        ASSERT_TRUE(rc == 0, "%d", rc);
+
+        /* 3.5 characters of 10 bits at 19200 bauds */
+        modbus_rtu_set_frame_gap(ctx, MODBUS_RTU_FRAME_GAP_AUTO);
+        rc = modbus_rtu_get_frame_gap(ctx);
+        printf("2/4 Computed from the baud rate: ");
+        ASSERT_TRUE(rc == 1823, "%d", rc);
+
+        rc = modbus_rtu_set_frame_gap(ctx, -2);
+        printf("3/4 Invalid frame gap: ");
+        ASSERT_TRUE(rc == -1 && errno == EINVAL, "");
+
+        /* Without the frame gap, the transaction timeout would expire while
+           waiting for the missing bytes */
+        modbus_set_slave(ctx, SERVER_ID);
+        modbus_set_byte_timeout(ctx, 5, 0);
+        modbus_set_transaction_timeout(ctx, 0, 500000);
+        rc = modbus_connect(ctx);
+        ASSERT_TRUE(rc == 0, "Unable to connect to %s", ptsname(pty));
+        rc = write(pty, truncated_rsp, sizeof(truncated_rsp));
+        ASSERT_TRUE(rc == sizeof(truncated_rsp), "");
+        rc = modbus_read_registers(ctx, 0, 3, tab_rp_registers);
+        printf("4/4 Truncated frame ended by the silence: ");
+        ASSERT_TRUE(rc == -1 && errno == EMBBADDATA, "%s", modbus_strerror(errno));
+
+        close(pty);
+        modbus_close(ctx);
+        modbus_free(ctx);
+        ctx = NULL;
+    }
+
+    /** RTU LOW LATENCY **/
+    printf("\nTEST RTU LOW LATENCY:\n");
+    {
+        int pty = posix_openpt(O_RDWR | O_NOCTTY);
+
+        ASSERT_TRUE(pty != -1 && grantpt(pty) == 0 && unlockpt(pty) == 0,
+                    "Unable to open a pseudo terminal (%s)", modbus_strerror(errno));
+        ctx = modbus_new_rtu(ptsname(pty), 115200, 'N', 8, 1);
+
+        rc = modbus_rtu_get_low_latency(ctx);
+        printf("1/3 Disabled by default: ");
+        ASSERT_TRUE(rc == 0, "%d", rc);
+
+        /* A pseudo terminal has neither ASYNC_LOW_LATENCY nor a latency
+           timer, the profile is best effort */
+        rc = modbus_rtu_set_low_latency(ctx, TRUE);
+        ASSERT_TRUE(rc == 0 || errno == ENOTSUP, "%s", modbus_strerror(errno));
+        rc = modbus_connect(ctx);
+        printf("2/3 Connection with the profile: ");
+        ASSERT_TRUE(rc == 0, "Unable to connect to %s", ptsname(pty));
+
+        rc = modbus_rtu_set_low_latency(ctx, FALSE);
+        printf("3/3 Profile removed while connected: ");
+        ASSERT_TRUE((rc == 0 && modbus_rtu_get_low_latency(ctx) == 0) ||
+                    errno == ENOTSUP, "");
+
+        close(pty);
+        modbus_close(ctx);
+        modbus_free(ctx);
+        ctx = NULL;
+    }
+
+    /** RTU RESYNC **/
+    printf("\nTEST RTU RESYNC:\n");
+    {
+        /* Response to a read of one register preceded by a noise byte */
+        uint8_t noisy_rsp[] = { 0x00, SERVER_ID, 0x03, 0x02, 0x00, 0x2A, 0x00, 0x00 };
+        uint16_t crc = modbus_rtu_crc16(noisy_rsp + 1, 5);
+        int pty = posix_openpt(O_RDWR | O_NOCTTY);
+
+        noisy_rsp[6] = crc >> 8;
+        noisy_rsp[7] = crc & 0xFF;
+
+        ASSERT_TRUE(pty != -1 && grantpt(pty) == 0 && unlockpt(pty) == 0,
+                    "Unable to open a pseudo terminal (%s)", modbus_strerror(errno));
+        ctx = modbus_new_rtu(ptsname(pty), 115200, 'N', 8, 1);
+        modbus_set_slave(ctx, SERVER_ID);
+        modbus_set_response_timeout(ctx, 0, 200000);
+        modbus_set_byte_timeout(ctx, 0, 50000);
+        rc = modbus_connect(ctx);
+        ASSERT_TRUE(rc == 0, "Unable to connect to %s", ptsname(pty));
+
+        /* The noise byte is taken as the address, the CRC is then read in
+           the middle of the frame */
+        modbus_set_error_recovery(ctx, MODBUS_ERROR_RECOVERY_PROTOCOL);
+        rc = write(pty, noisy_rsp, sizeof(noisy_rsp));
+        ASSERT_TRUE(rc == sizeof(noisy_rsp), "");
+        rc = modbus_read_registers(ctx, 0, 1, tab_rp_registers);
+        printf("1/3 Frame lost without resync: ");
+        ASSERT_TRUE(rc == -1 && errno == EMBBADCRC, "%s", modbus_strerror(errno));
+
+        modbus_set_error_recovery(ctx, MODBUS_ERROR_RECOVERY_PROTOCOL |
+                                  MODBUS_ERROR_RECOVERY_RESYNC);
+        modbus_reset_stats(ctx);
+        rc = write(pty, noisy_rsp, sizeof(noisy_rsp));
+        ASSERT_TRUE(rc == sizeof(noisy_rsp), "");
+        rc = modbus_read_registers(ctx, 0, 1, tab_rp_registers);
+        modbus_get_stats(ctx, &stats);
+        printf("2/3 Frame found after the noise byte: ");
+        ASSERT_TRUE(rc == 1 && tab_rp_registers[0] == 0x2A &&
+                    stats.crc_errors == 1 && stats.resync_bytes == 1,
+                    "%d %s, %d bytes dropped", rc, modbus_strerror(errno),
+                    (int)stats.resync_bytes);
+
+        /* Without any valid frame, every byte is dropped */
+        noisy_rsp[7] ^= 0xFF;
+        modbus_reset_stats(ctx);
+        rc = write(pty, noisy_rsp + 1, sizeof(noisy_rsp) - 1);
+        ASSERT_TRUE(rc == sizeof(noisy_rsp) - 1, "");
+        rc = modbus_read_registers(ctx, 0, 1, tab_rp_registers);
+        modbus_get_stats(ctx, &stats);
+        printf("3/3 Invalid frame dropped: ");
+        ASSERT_TRUE(rc == -1 && errno == EMBBADCRC &&
+                    stats.resync_bytes == sizeof(noisy_rsp) - 1,
+                    "%d %s, %d bytes dropped", rc, modbus_strerror(errno),
+                    (int)stats.resync_bytes);
+
+        close(pty);
+        modbus_close(ctx);
+        modbus_free(ctx);
+        ctx = NULL;
+    }
+
+    /** ASCII **/
+    printf("\nTEST ASCII:\n");
+    {
+        /* Read of one register of SERVER_ID (0x11) at address 0 and its
+           response, the digits in lower case after some noise */
+        const char ascii_req[] = ":110300000001EB\r\n";
+        const char ascii_rsp[] = "\n\r:110302002ac0\r\n";
+        const char bad_lrc_rsp[] = ":110302002AC1\r\n";
+        const char cut_rsp[] = ":110302:110302002AC0\r\n";
+        char line[64];
+        int pty = posix_openpt(O_RDWR | O_NOCTTY);
+
+        ASSERT_TRUE(pty != -1 && grantpt(pty) == 0 && unlockpt(pty) == 0,
+                    "Unable to open a pseudo terminal (%s)", modbus_strerror(errno));
+        ctx = modbus_new_ascii(ptsname(pty), 115200, 'N', 8, 1);
+        modbus_set_slave(ctx, SERVER_ID);
+        modbus_set_response_timeout(ctx, 0, 200000);
+        modbus_set_byte_timeout(ctx, 0, 50000);
+        rc = modbus_connect(ctx);
+        ASSERT_TRUE(rc == 0, "Unable to connect to %s", ptsname(pty));
+
+        rc = write(pty, ascii_rsp, strlen(ascii_rsp));
+        ASSERT_TRUE(rc == (int)strlen(ascii_rsp), "");
+        rc = modbus_read_registers(ctx, 0, 1, tab_rp_registers);
+        printf("1/6 Response decoded: ");
+        ASSERT_TRUE(rc == 1 && tab_rp_registers[0] == 0x2A, "%d %s", rc,
+                    modbus_strerror(errno));
+
+        rc = read(pty, line, sizeof(line) - 1);
+        line[rc > 0 ? rc : 0] = '\0';
+        printf("2/6 Request encoded: ");
+        ASSERT_TRUE(strcmp(line, ascii_req) == 0, "%s", line);
+
+        rc = write(pty, bad_lrc_rsp, strlen(bad_lrc_rsp));
+        ASSERT_TRUE(rc == (int)strlen(bad_lrc_rsp), "");
+        rc = modbus_read_registers(ctx, 0, 1, tab_rp_registers);
+        printf("3/6 Wrong LRC: ");
+        ASSERT_TRUE(rc == -1 && errno == EMBBADCRC, "%s", modbus_strerror(errno));
+
+        /* The ':' of the second frame is kept for the next response */
+        rc = write(pty, cut_rsp, strlen(cut_rsp));
+        ASSERT_TRUE(rc == (int)strlen(cut_rsp), "");
+        rc = modbus_read_registers(ctx, 0, 1, tab_rp_registers);
+        printf("4/6 Frame cut by the next one: ");
+        ASSERT_TRUE(rc == -1 && errno == EMBBADDATA, "%s", modbus_strerror(errno));
+
+        tab_rp_registers[0] = 0;
+        rc = modbus_read_registers(ctx, 0, 1, tab_rp_registers);
+        printf("5/6 Next frame read: ");
+        ASSERT_TRUE(rc == 1 && tab_rp_registers[0] == 0x2A, "%d %s", rc,
+                    modbus_strerror(errno));
+
+        /* The characters of a frame are awaited no longer than the
+           transaction deadline, even with a longer byte timeout */
+        {
+            struct timeval start, end;
+
+            modbus_set_byte_timeout(ctx, 2, 0);
+            modbus_set_transaction_timeout(ctx, 0, 100000);
+            rc = write(pty, ":", 1);
+            ASSERT_TRUE(rc == 1, "");
+            gettimeofday(&start, NULL);
+            rc = modbus_read_registers(ctx, 0, 1, tab_rp_registers);
+            gettimeofday(&end, NULL);
+            printf("6/6 Transaction timeout within a frame: ");
+            ASSERT_TRUE(rc == -1 && errno == ETIMEDOUT &&
+                        (end.tv_sec - start.tv_sec) * 1000000 +
+                        (end.tv_usec - start.tv_usec) < 1000000,
+                        "%s", modbus_strerror(errno));
+        }
+
+        close(pty);
+        modbus_close(ctx);
+        modbus_free(ctx);
+        ctx = NULL;
+    }
+#endif
+
     printf("\nALL TESTS PASS WITH SUCCESS.\n");
     success = TRUE;
 
@@ -681,6 +1276,7 @@ close:
     /* Close the connection */
     modbus_close(ctx);
     modbus_free(ctx);
+    modbus_uring_free(ring);
 
     return (success) ? 0 : -1;
 }
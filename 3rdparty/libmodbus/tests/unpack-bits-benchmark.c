@@ -0,0 +1,101 @@
+/*
+ * Copyright © 2008-2014 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#ifndef _MSC_VER
+#include <sys/time.h>
+#else
+#include <windows.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <modbus.h>
+
+/* Bits unpacked by each measure */
+#define BITS_PER_MEASURE (512 * 1024 * 1024)
+
+typedef void (*unpack_fnc_t)(uint8_t *dest, int idx, unsigned int nb_bits,
+                             const uint8_t *tab_byte);
+
+static uint64_t gettime_us(void)
+{
+#if !defined(_MSC_VER)
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+#else
+    return (uint64_t) GetTickCount() * 1000;
+#endif
+}
+
+/* Per-bit loop of libmodbus 3.1 (modbus_set_bits_from_bytes and the unpacking
+   of read_io_status) */
+static void unpack_loop(uint8_t *dest, int idx, unsigned int nb_bits,
+                        const uint8_t *tab_byte)
+{
+    unsigned int i;
+    int shift = 0;
+
+    for (i = idx; i < idx + nb_bits; i++) {
+        dest[i] = tab_byte[(i - idx) / 8] & (1 << shift) ? 1 : 0;
+        shift++;
+        shift %= 8;
+    }
+}
+
+/* Returns the throughput in millions of bits per second */
+static double measure(unpack_fnc_t unpack, uint8_t *dest,
+                      const uint8_t *packed, unsigned int nb_bits)
+{
+    unsigned int nb_loops = BITS_PER_MEASURE / nb_bits;
+    unsigned int i;
+    uint64_t start;
+    uint64_t elapsed;
+
+    start = gettime_us();
+    for (i = 0; i < nb_loops; i++) {
+        unpack(dest, 0, nb_bits, packed + (i & 0x3F));
+    }
+    elapsed = gettime_us() - start;
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+
+    return (double)nb_loops * nb_bits / elapsed;
+}
+
+int main(void)
+{
+    const unsigned int nb_bits[] = { 16, 37, 256, MODBUS_MAX_READ_BITS };
+    uint8_t packed[MODBUS_MAX_READ_BITS / 8 + 64 + 1];
+    uint8_t dest_loop[MODBUS_MAX_READ_BITS];
+    uint8_t dest[MODBUS_MAX_READ_BITS];
+    size_t i;
+
+    srand(5);
+    for (i = 0; i < sizeof(packed); i++) {
+        packed[i] = (uint8_t)rand();
+    }
+
+    unpack_loop(dest_loop, 0, MODBUS_MAX_READ_BITS, packed);
+    modbus_set_bits_from_bytes(dest, 0, MODBUS_MAX_READ_BITS, packed);
+    if (memcmp(dest_loop, dest, sizeof(dest)) != 0) {
+        printf("modbus_set_bits_from_bytes doesn't give the same bits\n");
+        return 1;
+    }
+
+    printf("Unpacking of bits in Mbits/s\n\n");
+    printf("%10s %12s %28s\n", "Bits", "Per-bit loop",
+           "modbus_set_bits_from_bytes");
+    for (i = 0; i < sizeof(nb_bits) / sizeof(nb_bits[0]); i++) {
+        printf("%10u %12.0f %28.0f\n", nb_bits[i],
+               measure(unpack_loop, dest_loop, packed, nb_bits[i]),
+               measure(modbus_set_bits_from_bytes, dest, packed, nb_bits[i]));
+    }
+
+    return 0;
+}
@@ -0,0 +1,289 @@
+/*
+ * Copyright © 2008-2014 Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <modbus.h>
+
+#define PORT 1510
+#define NB_REGISTERS 10
+#define RUN_MS 2000
+
+typedef struct {
+    modbus_t *ctx;
+    uint16_t dest[NB_REGISTERS];
+} master_t;
+
+typedef struct {
+    uint64_t transactions;
+    uint64_t errors;
+    int running;
+} run_result_t;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static int check_registers(const uint16_t *dest)
+{
+    int i;
+
+    for (i = 0; i < NB_REGISTERS; i++) {
+        if (dest[i] != 0x1000 + i)
+            return -1;
+    }
+    return 0;
+}
+
+/* Classic TCP context if ring is NULL */
+static modbus_t *new_master(modbus_uring_t *ring)
+{
+    modbus_t *ctx;
+
+    if (ring == NULL) {
+        ctx = modbus_new_tcp("127.0.0.1", PORT);
+    } else {
+        ctx = modbus_new_tcp_uring(ring, "127.0.0.1", PORT);
+    }
+    if (ctx == NULL)
+        return NULL;
+
+    if (modbus_connect(ctx) == -1) {
+        modbus_free(ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+/* One master reading the registers in a loop with the blocking functions */
+static int run_blocking(modbus_uring_t *ring, run_result_t *result)
+{
+    uint16_t dest[NB_REGISTERS];
+    modbus_t *ctx;
+    double end;
+
+    memset(result, 0, sizeof(run_result_t));
+    ctx = new_master(ring);
+    if (ctx == NULL)
+        return -1;
+
+    end = now_ms() + RUN_MS;
+    while (now_ms() < end) {
+        if (modbus_read_registers(ctx, 0, NB_REGISTERS, dest) != NB_REGISTERS ||
+            check_registers(dest) == -1) {
+            result->errors++;
+        } else {
+            result->transactions++;
+        }
+    }
+
+    modbus_close(ctx);
+    modbus_free(ctx);
+
+    return 0;
+}
+
+static void read_done(modbus_reactor_t *reactor, modbus_t *ctx, int rc,
+                      void *user_data);
+
+static int submit_read(modbus_reactor_t *reactor, master_t *master)
+{
+    return modbus_reactor_read_registers(reactor, master->ctx, 0, NB_REGISTERS,
+                                         master->dest, read_done, master);
+}
+
+static run_result_t *reactor_result;
+
+/* Each master sends a request as soon as it gets the response to the
+   previous one */
+static void read_done(modbus_reactor_t *reactor, modbus_t *ctx, int rc,
+                      void *user_data)
+{
+    master_t *master = (master_t *)user_data;
+
+    (void)ctx;
+    if (rc != NB_REGISTERS || check_registers(master->dest) == -1) {
+        reactor_result->errors++;
+    } else {
+        reactor_result->transactions++;
+    }
+
+    if (reactor_result->running &&
+        submit_read(reactor, master) == -1) {
+        reactor_result->errors++;
+    }
+}
+
+/* nb_masters contexts driven by a reactor during RUN_MS */
+static int run_reactor(modbus_uring_t *ring, int nb_masters,
+                       run_result_t *result)
+{
+    modbus_reactor_t *reactor;
+    master_t *masters;
+    double end;
+    int rc = 0;
+    int i;
+
+    memset(result, 0, sizeof(run_result_t));
+    reactor_result = result;
+    reactor = modbus_reactor_new();
+    masters = (master_t *)calloc(nb_masters, sizeof(master_t));
+    if (reactor == NULL || masters == NULL) {
+        modbus_reactor_free(reactor);
+        free(masters);
+        return -1;
+    }
+
+    for (i = 0; i < nb_masters; i++) {
+        masters[i].ctx = new_master(ring);
+        if (masters[i].ctx == NULL || modbus_reactor_add(reactor, masters[i].ctx) == -1) {
+            rc = -1;
+            goto close;
+        }
+    }
+
+    result->running = 1;
+    for (i = 0; i < nb_masters; i++) {
+        if (submit_read(reactor, &masters[i]) == -1)
+            result->errors++;
+    }
+
+    end = now_ms() + RUN_MS;
+    while (now_ms() < end) {
+        if (modbus_reactor_run(reactor, 100) == -1) {
+            rc = -1;
+            break;
+        }
+    }
+
+    /* The requests in flight complete without being sent again */
+    result->running = 0;
+    while (modbus_reactor_get_pending(reactor) > 0) {
+        if (modbus_reactor_run(reactor, 1000) <= 0) {
+            rc = -1;
+            break;
+        }
+    }
+
+close:
+    modbus_reactor_free(reactor);
+    for (i = 0; i < nb_masters; i++) {
+        if (masters[i].ctx != NULL) {
+            modbus_close(masters[i].ctx);
+            modbus_free(masters[i].ctx);
+        }
+    }
+    free(masters);
+
+    return rc;
+}
+
+static void print_result(const char *name, int rc, run_result_t *result,
+                         modbus_uring_t *ring, modbus_uring_stats_t *before,
+                         int *nb_fail)
+{
+    modbus_uring_stats_t stats;
+
+    if (rc == -1 || result->errors > 0 || result->transactions == 0) {
+        printf("%-10s FAILED (%llu errors)\n", name,
+               (unsigned long long)result->errors);
+        (*nb_fail)++;
+        return;
+    }
+
+    printf("%-10s %10.0f", name, result->transactions * 1000.0 / RUN_MS);
+    if (ring != NULL && modbus_uring_get_stats(ring, &stats) == 0 &&
+        stats.enters > before->enters) {
+        printf(" %12.1f", (double)result->transactions /
+               (stats.enters - before->enters));
+    }
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    modbus_mapping_t *mb_mapping;
+    modbus_server_t *server;
+    modbus_uring_t *ring;
+    modbus_uring_stats_t before;
+    run_result_t result;
+    int nb_masters = 256;
+    int nb_fail = 0;
+    int rc;
+    int i;
+
+    if (argc > 2 || (argc > 1 && atoi(argv[1]) <= 0)) {
+        printf("Usage:\n  %s [nb contexts] - Compares the TCP backend with the "
+               "io_uring backend on the loopback\n\n", argv[0]);
+        exit(1);
+    }
+    if (argc > 1)
+        nb_masters = atoi(argv[1]);
+
+    ring = modbus_uring_new(nb_masters);
+    if (ring == NULL) {
+        printf("io_uring unavailable: %s\n", modbus_strerror(errno));
+        return 0;
+    }
+    modbus_uring_get_stats(ring, &before);
+    printf("io_uring with%s registered buffers\n\n",
+           before.registered ? "" : "out");
+
+    mb_mapping = modbus_mapping_new(0, 0, NB_REGISTERS, 0);
+    if (mb_mapping == NULL) {
+        fprintf(stderr, "Failed to allocate the mapping: %s\n",
+                modbus_strerror(errno));
+        modbus_uring_free(ring);
+        return -1;
+    }
+    for (i = 0; i < NB_REGISTERS; i++) {
+        mb_mapping->tab_registers[i] = 0x1000 + i;
+    }
+
+    server = modbus_server_new("127.0.0.1", PORT, mb_mapping);
+    if (server == NULL ||
+        modbus_server_start(server, sysconf(_SC_NPROCESSORS_ONLN)) == -1) {
+        fprintf(stderr, "Unable to start the server: %s\n",
+                modbus_strerror(errno));
+        modbus_server_free(server);
+        modbus_mapping_free(mb_mapping);
+        modbus_uring_free(ring);
+        return -1;
+    }
+
+    printf("Reading %d registers during %d ms:\n\n", NB_REGISTERS, RUN_MS);
+    printf("%-10s %10s %12s\n", "Backend", "Trans/s", "Trans/enter");
+
+    printf("1 context, blocking\n");
+    rc = run_blocking(NULL, &result);
+    print_result("tcp", rc, &result, NULL, NULL, &nb_fail);
+    modbus_uring_get_stats(ring, &before);
+    rc = run_blocking(ring, &result);
+    print_result("io_uring", rc, &result, ring, &before, &nb_fail);
+
+    printf("%d contexts, reactor\n", nb_masters);
+    rc = run_reactor(NULL, nb_masters, &result);
+    print_result("tcp", rc, &result, NULL, NULL, &nb_fail);
+    modbus_uring_get_stats(ring, &before);
+    rc = run_reactor(ring, nb_masters, &result);
+    print_result("io_uring", rc, &result, ring, &before, &nb_fail);
+
+    modbus_server_stop(server);
+    modbus_server_free(server);
+    modbus_mapping_free(mb_mapping);
+    modbus_uring_free(ring);
+
+    return nb_fail == 0 ? 0 : -1;
+}
@@ -23,6 +23,8 @@
     #include <IOKit/usb/IOUSBLib.h>
 #endif
 
+class QSocketNotifier;
+
 /*!
  * Structure containing port information.
  */
@@ -73,7 +75,10 @@ class QextSerialRegistrationWidget : public QWidget
 
   To enable event-driven notification of device connection events, first call
   setUpNotifications() and then connect to the deviceDiscovered() and deviceRemoved()
-  signals.  Event-driven behavior is currently available only on Windows and OS X.
+  signals.  Event-driven behavior is currently available on Windows, OS X and Linux.
+
+  On Linux, while an enumerator has notifications enabled, getPorts() returns a list
+  kept up to date from the changes of /dev instead of scanning it again.
 
   \b Example
   \code
@@ -163,6 +168,21 @@ Q_OBJECT
                *    \param infoList list with result.
                */
               static void scanPortsNix(QList<QextPortInfo> & infoList);
+              /*!
+               * Fill the details of a port from its name in /dev.
+               *    \param name name of the device node, without /dev.
+               *    \param portInfo structure to fill.
+               *    \return false if the name isn't the one of a serial port.
+               */
+              static bool getPortDetailsNix( const QString & name, QextPortInfo* portInfo );
+
+              #ifdef Q_OS_LINUX
+              int inotifyFd;
+              QSocketNotifier* inotifyNotifier;
+
+            private slots:
+              void onDevChangedNix( );
+              #endif // Q_OS_LINUX
             #endif // Q_OS_MAC
         #endif /* Q_OS_UNIX */
 
@@ -182,7 +202,7 @@ Q_OBJECT
           A new device has been connected to the system.
 
           setUpNotifications() must be called first to enable event-driven device notifications.
-          Currently only implemented on Windows and OS X.
+          Currently only implemented on Windows, OS X and Linux.
           \param info The device that has been discovered.
         */
         void deviceDiscovered( const QextPortInfo & info );
@@ -190,7 +210,7 @@ Q_OBJECT
           A device has been disconnected from the system.
 
           setUpNotifications() must be called first to enable event-driven device notifications.
-          Currently only implemented on Windows and OS X.
+          Currently only implemented on Windows, OS X and Linux.
           \param info The device that was disconnected.
         */
         void deviceRemoved( const QextPortInfo & info );
@@ -1,44 +1,85 @@
-
-
-
 #include "qextserialenumerator.h"
 #include <QDebug>
 #include <QMetaType>
 #include <QStringList>
 #include <QDir>
 
+#ifdef Q_OS_LINUX
+#include <QSocketNotifier>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#endif
+
+#ifdef Q_OS_LINUX
+// Ports of the last scan of /dev, kept up to date by the enumerators with
+// notifications enabled. getPorts() returns it while one of them is alive.
+static QList<QextPortInfo> cachedPorts;
+static int watchingEnumerators = 0;
+#endif
+
 QextSerialEnumerator::QextSerialEnumerator( )
 {
     if( !QMetaType::isRegistered( QMetaType::type("QextPortInfo") ) )
         qRegisterMetaType<QextPortInfo>("QextPortInfo");
+#ifdef Q_OS_LINUX
+    inotifyFd = -1;
+    inotifyNotifier = 0;
+#endif
 }
 
 QextSerialEnumerator::~QextSerialEnumerator( )
 {
+#ifdef Q_OS_LINUX
+    if( inotifyFd != -1 ) {
+        delete inotifyNotifier;
+        close( inotifyFd );
+        if( --watchingEnumerators == 0 )
+            cachedPorts.clear();
+    }
+#endif
 }
 
-QList<QextPortInfo> QextSerialEnumerator::getPorts()
+//static
+bool QextSerialEnumerator::getPortDetailsNix( const QString & name, QextPortInfo* portInfo )
+{
+    QString str = name;
+
+    if (str.startsWith("ttyS")) {
+        // reject the values which are not serial ports for e.g.  /dev/ttysa
+        bool ok;
+        str.mid(4).toInt(&ok, 10);
+        if (!ok)
+            return false;
+        portInfo->friendName = "Serial port "+str.remove(0, 4);
+    }
+    else if (str.startsWith("ttyUSB")) {
+        portInfo->friendName = "USB-serial adapter "+str.remove(0, 6);
+    }
+    else if (str.startsWith("rfcomm")) {
+        portInfo->friendName = "Bluetooth-serial adapter "+str.remove(0, 6);
+    }
+    else if (!str.startsWith("ttyACM")) {
+        return false;
+    }
+
+    portInfo->physName = "/dev/"+name;
+    portInfo->portName = name;
+    portInfo->enumName = "/dev"; // is there a more helpful name for this?
+    portInfo->vendorID = portInfo->productID = 0;
+    return true;
+}
+
+//static
+void QextSerialEnumerator::scanPortsNix(QList<QextPortInfo> & infoList)
 {
-    QList<QextPortInfo> infoList;
-#ifdef Q_OS_LINUX
     QStringList portNamePrefixes, portNameList;
     portNamePrefixes << "ttyS*"; // list normal serial ports first
 
     QDir dir("/dev");
     portNameList = dir.entryList(portNamePrefixes, (QDir::System | QDir::Files), QDir::Name);
 
-    // remove the values which are not serial ports for e.g.  /dev/ttysa
-    for (int i = 0; i < portNameList.size(); i++) {
-        bool ok;
-        QString current = portNameList.at(i);
-        // remove the ttyS part, and check, if the other part is a number
-        current.remove(0,4).toInt(&ok, 10);
-        if (!ok) {
-            portNameList.removeAt(i);
-            i--;
-        }
-    }
-
     // get the non standard serial ports names
     // (USB-serial, bluetooth-serial, 18F PICs, and so on)
     // if you know an other name prefix for serial ports please let us know
@@ -48,21 +89,18 @@ QList<QextPortInfo> QextSerialEnumerator::getPorts()
 
     foreach (QString str , portNameList) {
         QextPortInfo inf;
-        inf.physName = "/dev/"+str;
-        inf.portName = str;
-
-        if (str.contains("ttyS")) {
-            inf.friendName = "Serial port "+str.remove(0, 4);
-        }
-        else if (str.contains("ttyUSB")) {
-            inf.friendName = "USB-serial adapter "+str.remove(0, 6);
-        }
-        else if (str.contains("rfcomm")) {
-            inf.friendName = "Bluetooth-serial adapter "+str.remove(0, 6);
-        }
-        inf.enumName = "/dev"; // is there a more helpful name for this?
-        infoList.append(inf);
+        if (getPortDetailsNix(str, &inf))
+            infoList.append(inf);
     }
+}
+
+QList<QextPortInfo> QextSerialEnumerator::getPorts()
+{
+    QList<QextPortInfo> infoList;
+#ifdef Q_OS_LINUX
+    if (watchingEnumerators > 0)
+        return cachedPorts;
+    scanPortsNix(infoList);
 #else
     qCritical("Enumeration for POSIX systems (except Linux) is not implemented yet.");
 #endif
@@ -71,5 +109,97 @@ QList<QextPortInfo> QextSerialEnumerator::getPorts()
 
 void QextSerialEnumerator::setUpNotifications( )
 {
+#ifdef Q_OS_LINUX
+    if( inotifyFd != -1 )
+        return;
+
+    inotifyFd = inotify_init();
+    if( inotifyFd == -1 ) {
+        qWarning() << "inotify_init failed:" << strerror(errno);
+        return;
+    }
+    // udev creates and removes the device nodes of the hot-plugged adapters
+    if( inotify_add_watch( inotifyFd, "/dev", IN_CREATE | IN_DELETE |
+                           IN_MOVED_FROM | IN_MOVED_TO ) == -1 ) {
+        qWarning() << "inotify_add_watch failed:" << strerror(errno);
+        close( inotifyFd );
+        inotifyFd = -1;
+        return;
+    }
+    inotifyNotifier = new QSocketNotifier( inotifyFd, QSocketNotifier::Read, this );
+    connect( inotifyNotifier, SIGNAL(activated(int)), this, SLOT(onDevChangedNix()) );
+
+    // scanned after the watch is added, so no change is missed
+    if( watchingEnumerators++ == 0 ) {
+        cachedPorts.clear();
+        scanPortsNix( cachedPorts );
+    }
+
+    // setting up notifications doesn't tell us about devices already connected
+    // so report those as the other platforms do
+    foreach( QextPortInfo port, cachedPorts )
+      emit deviceDiscovered( port );
+#else
     qCritical("Notifications for *Nix/FreeBSD are not implemented yet");
+#endif
+}
+
+#ifdef Q_OS_LINUX
+void QextSerialEnumerator::onDevChangedNix( )
+{
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t length = read( inotifyFd, buf, sizeof(buf) );
+
+    for( char* p = buf; length > 0 && p < buf + length; ) {
+        const struct inotify_event* event = (const struct inotify_event*) p;
+        p += sizeof(struct inotify_event) + event->len;
+
+        if( event->mask & IN_Q_OVERFLOW ) {
+            // events were lost, compare with a new scan
+            QList<QextPortInfo> ports;
+            scanPortsNix( ports );
+            foreach( QextPortInfo port, cachedPorts ) {
+                bool found = false;
+                foreach( QextPortInfo newPort, ports )
+                    found = found || newPort.physName == port.physName;
+                if( !found )
+                    emit deviceRemoved( port );
+            }
+            foreach( QextPortInfo port, ports ) {
+                bool found = false;
+                foreach( QextPortInfo oldPort, cachedPorts )
+                    found = found || oldPort.physName == port.physName;
+                if( !found )
+                    emit deviceDiscovered( port );
+            }
+            cachedPorts = ports;
+            continue;
+        }
+
+        QextPortInfo info;
+        if( event->len == 0 || !getPortDetailsNix( QString::fromLocal8Bit( event->name ), &info ) )
+            continue;
+
+        // the cache is shared by the enumerators, each of them gets the
+        // same events
+        int index = -1;
+        for( int i = 0; i < cachedPorts.size(); i++ ) {
+            if( cachedPorts[i].physName == info.physName ) {
+                index = i;
+                break;
+            }
+        }
+
+        if( event->mask & (IN_CREATE | IN_MOVED_TO) ) {
+            if( index == -1 )
+                cachedPorts.append( info );
+            emit deviceDiscovered( info );
+        }
+        else if( event->mask & (IN_DELETE | IN_MOVED_FROM) ) {
+            if( index != -1 )
+                cachedPorts.removeAt( index );
+            emit deviceRemoved( info );
+        }
+    }
 }
+#endif
@@ -16,11 +16,21 @@ greaterThan(QT_MAJOR_VERSION, 4) {
 SOURCES += src/main.cpp \
     src/mainwindow.cpp \
     src/BatchProcessor.cpp \
+    src/BusSniffer.cpp \
+    src/ModbusTcpPool.cpp \
     3rdparty/qextserialport/qextserialport.cpp	\
     3rdparty/libmodbus/src/modbus.c \
+    3rdparty/libmodbus/src/modbus-crc.c \
     3rdparty/libmodbus/src/modbus-data.c \
+    3rdparty/libmodbus/src/modbus-gateway.c \
+    3rdparty/libmodbus/src/modbus-parser.c \
+    3rdparty/libmodbus/src/modbus-reactor.c \
     3rdparty/libmodbus/src/modbus-rtu.c \
+    3rdparty/libmodbus/src/modbus-scheduler.c \
+    3rdparty/libmodbus/src/modbus-server.c \
+    3rdparty/libmodbus/src/modbus-stats.c \
     3rdparty/libmodbus/src/modbus-tcp.c \
+    3rdparty/libmodbus/src/modbus-uring.c \
     3rdparty/libmodbus/src/modbus-ascii.c \
     src/asciisettingswidget.cpp \
     src/rtusettingswidget.cpp \
@@ -31,10 +41,14 @@ SOURCES += src/main.cpp \
 
 HEADERS += src/mainwindow.h \
     src/BatchProcessor.h \
+    src/BusSniffer.h \
+    src/ModbusTcpPool.h \
+    src/SpscQueue.h \
     3rdparty/qextserialport/qextserialport.h \
     3rdparty/qextserialport/qextserialenumerator.h \
     3rdparty/libmodbus/src/modbus.h \
     src/serialsettingswidget.h \
+    src/asciisettingswidget.h \
     src/imodbus.h \
     src/tcpipsettingswidget.h \
     src/ipaddressctrl.h \
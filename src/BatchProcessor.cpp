@@ -401,8 +401,19 @@ void BatchProcessor::execRequest(int            iSlaveId,
         .arg(QString::number(iFuncId, 16).toUpper());
 
   try {
+    const uint8_t * au8View = NULL;
     QVector<uint16_t> qau16Result =
-        sendModbusRequest(iSlaveId, iFuncId, iAddr, iVal, iNum);
+        sendModbusRequest(iSlaveId, iFuncId, iAddr, iVal, iNum, &au8View);
+
+    if (au8View != NULL)
+    {
+      // register reads are decoded straight from the big-endian response
+      for (int i = 0; i < iVal; ++i)
+      {
+        uint16_t u16Val = (au8View[2*i] << 8) | au8View[2*i + 1];
+        logWrite(qStrCommon + QString::number(iAddr++) + ", " + QString::number(u16Val));
+      }
+    }
 
     foreach (uint16_t u16Val, qau16Result)
     {
@@ -420,18 +431,24 @@ QVector<uint16_t> BatchProcessor::sendModbusRequest(int iSlaveID,
                                                     int iFuncId,
                                                     int iAddr,
                                                     int iNum,
-                                                    int iParam)
+                                                    int iParam,
+                                                    const uint8_t ** pau8View)
 {
   if ((m_modbus == NULL) || (iNum < 1))
   {
     return QVector<uint16_t>();
   }
 
-  QVector<uint16_t>   qau16Result(iNum);
+  // register reads leave the values in the response buffer of the context
+  const bool bView    = (iFuncId == MODBUS_FC_READ_HOLDING_REGISTERS) ||
+                        (iFuncId == MODBUS_FC_READ_INPUT_REGISTERS);
+
+  QVector<uint16_t>   qau16Result(bView ? 0 : iNum);
 
   uint16_t * au16Data = qau16Result.data();
   uint8_t  * au8Data  = (uint8_t*)au16Data;
   bool       b8Bit    = false;
+  bool       bPacked  = false;
   int        ret      = -1;
 
   modbus_set_slave(m_modbus, iSlaveID);
@@ -439,21 +456,21 @@ QVector<uint16_t> BatchProcessor::sendModbusRequest(int iSlaveID,
   switch (iFuncId)
   {
     case MODBUS_FC_READ_COILS:
-      ret = modbus_read_bits(m_modbus, iAddr, iNum, au8Data);
-      b8Bit = true;
+      ret = modbus_read_bits_packed(m_modbus, iAddr, iNum, au8Data);
+      bPacked = true;
       break;
 
     case MODBUS_FC_READ_DISCRETE_INPUTS:
-      ret = modbus_read_input_bits(m_modbus, iAddr, iNum, au8Data);
-      b8Bit = true;
+      ret = modbus_read_input_bits_packed(m_modbus, iAddr, iNum, au8Data);
+      bPacked = true;
       break;
 
     case MODBUS_FC_READ_HOLDING_REGISTERS:
-      ret = modbus_read_registers(m_modbus, iAddr, iNum, au16Data);
+      ret = modbus_read_registers_view(m_modbus, iAddr, iNum, pau8View);
       break;
 
     case MODBUS_FC_READ_INPUT_REGISTERS:
-      ret = modbus_read_input_registers(m_modbus, iAddr, iNum, au16Data);
+      ret = modbus_read_input_registers_view(m_modbus, iAddr, iNum, pau8View);
       break;
 
     case MODBUS_FC_READ_FILE_RECORD:
@@ -507,6 +524,15 @@ QVector<uint16_t> BatchProcessor::sendModbusRequest(int iSlaveID,
         au16Data[i] = au8Data[i];
       }
     }
+    else if (bPacked)
+    {
+      // widen the packed bits to 16bit array (from the back, the packed
+      // bytes are overwritten after their last use)
+      for (int i = iNum-1; i >= 0; --i)
+      {
+        au16Data[i] = (au8Data[i / 8] >> (i % 8)) & 1;
+      }
+    }
 
     return qau16Result;
   }
@@ -105,7 +105,8 @@ private:
                                       int iFuncId,
                                       int iAddr,
                                       int iNum,
-                                      int iParam);
+                                      int iParam,
+                                      const uint8_t ** pau8View);
 
   Ui::BatchProcessor *ui;
   modbus_t *m_modbus;
@@ -0,0 +1,308 @@
+/*
+ * BusSniffer.cpp - implementation of BusSniffer class
+ *
+ * Copyright (c) 2009-2014 Tobias Doerffel / Electronic Design Chemnitz
+ *
+ * This file is part of QModBus - http://qmodbus.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <QMutexLocker>
+
+#include <errno.h>
+#include <string.h>
+
+#include "BusSniffer.h"
+#include "modbus-private.h"
+
+
+// longest wait for the first byte of a frame, bounds the time needed to
+// stop or suspend the thread
+const int IdleWaitUsec = 10000;
+
+
+BusSniffer::BusSniffer( modbus_t * modbus, QObject * parent ) :
+	QThread( parent ),
+	m_modbus( modbus ),
+	m_parser( NULL ),
+	m_ownerFrameGap( modbus_rtu_get_frame_gap( modbus ) ),
+	m_stop( 0 ),
+	m_suspended( 0 ),
+	m_dropped( 0 ),
+	m_droppedBytes( 0 ),
+	m_parserDropped( 0 ),
+	m_chunkLength( 0 ),
+	m_chunkOverflow( false ),
+	m_chunkFrames( 0 ),
+	m_chunkEnd( 0 ),
+	m_pending( false ),
+	m_pendingSlave( 0 ),
+	m_pendingFunc( 0 ),
+	m_pendingAddr( 0 ),
+	m_pendingEnd( 0 )
+{
+	// the direction of a frame isn't known from the line
+	m_parser = modbus_parser_new( m_modbus, MODBUS_PARSER_ANY,
+					BusSniffer::parserCallback, this );
+}
+
+
+BusSniffer::~BusSniffer()
+{
+	stop();
+	wait();
+	modbus_parser_free( m_parser );
+}
+
+
+void BusSniffer::stop()
+{
+	m_stop.fetchAndStoreOrdered( 1 );
+}
+
+
+void BusSniffer::suspend()
+{
+	// the thread doesn't take the line again while suspended, so the
+	// lock is granted after its current wait at most
+	m_suspended.fetchAndStoreOrdered( 1 );
+	m_lineMutex.lock();
+	modbus_rtu_set_frame_gap( m_modbus, m_ownerFrameGap );
+}
+
+
+void BusSniffer::resume()
+{
+	modbus_rtu_set_frame_gap( m_modbus, MODBUS_RTU_FRAME_GAP_AUTO );
+	m_lineMutex.unlock();
+	m_suspended.fetchAndStoreOrdered( 0 );
+}
+
+
+bool BusSniffer::takeRecord( BusSnifferRecord & record )
+{
+	return m_records.pop( record );
+}
+
+
+int BusSniffer::droppedRecords()
+{
+	return m_dropped.fetchAndAddRelaxed( 0 );
+}
+
+
+int BusSniffer::droppedBytes()
+{
+	return m_droppedBytes.fetchAndAddRelaxed( 0 );
+}
+
+
+void BusSniffer::run()
+{
+	if( m_modbus == NULL || m_parser == NULL )
+	{
+		return;
+	}
+
+	// once a frame has started, the RTU backend ends the wait after the
+	// t3.5 silence with EMBBADDATA
+	m_lineMutex.lock();
+	modbus_rtu_set_frame_gap( m_modbus, MODBUS_RTU_FRAME_GAP_AUTO );
+	m_lineMutex.unlock();
+
+	while( !m_stop.fetchAndAddAcquire( 0 ) )
+	{
+		if( m_suspended.fetchAndAddAcquire( 0 ) )
+		{
+			// the bytes read so far belong to the transactions of
+			// the owner of the line
+			resetParser();
+			m_pending = false;
+			msleep( 1 );
+			continue;
+		}
+
+		QMutexLocker lineLock( &m_lineMutex );
+		struct timeval tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = IdleWaitUsec;
+
+		if( m_modbus->backend->select( m_modbus, &tv, 1 ) > 0 )
+		{
+			quint8 buf[MODBUS_RTU_MAX_ADU_LENGTH];
+			const int rc = m_modbus->backend->recv( m_modbus, buf,
+								sizeof( buf ) );
+			if( rc > 0 )
+			{
+				const int n = qMin( rc, (int) sizeof( m_chunk ) -
+								m_chunkLength );
+				memcpy( m_chunk + m_chunkLength, buf, n );
+				m_chunkLength += n;
+				m_chunkOverflow = m_chunkOverflow || n < rc;
+				m_chunkEnd = _modbus_time_us();
+
+				// frames not separated by a long enough silence,
+				// on a busy line or behind the latency of a USB
+				// adapter, are split on their CRC, a frame cut by
+				// the end of this read is completed by the next one
+				modbus_parser_feed( m_parser, buf, rc );
+			}
+		}
+		else if( errno == EMBBADDATA || errno == ETIMEDOUT )
+		{
+			if( m_chunkLength > 0 )
+			{
+				endOfChunk();
+			}
+		}
+		else
+		{
+			// port closed or in error, don't spin on it
+			lineLock.unlock();
+			msleep( IdleWaitUsec / 1000 );
+		}
+	}
+
+	m_lineMutex.lock();
+	modbus_rtu_set_frame_gap( m_modbus, m_ownerFrameGap );
+	m_lineMutex.unlock();
+}
+
+
+void BusSniffer::endOfChunk()
+{
+	// the t3.5 silence ends any frame, the bytes of an incomplete one
+	// are dropped
+	modbus_parser_reset( m_parser );
+
+	const quint64 dropped = modbus_parser_get_dropped( m_parser );
+	if( dropped > m_parserDropped )
+	{
+		m_droppedBytes.fetchAndAddRelaxed( dropped - m_parserDropped );
+		m_parserDropped = dropped;
+
+		// usually a single frame with a wrong CRC, shown as it is
+		if( m_chunkFrames == 0 && !m_chunkOverflow )
+		{
+			addFrame( m_chunk, m_chunkLength, false );
+		}
+	}
+
+	m_chunkLength = 0;
+	m_chunkOverflow = false;
+	m_chunkFrames = 0;
+}
+
+
+// drops the bytes of the owner of the line without counting them
+void BusSniffer::resetParser()
+{
+	modbus_parser_reset( m_parser );
+	m_parserDropped = modbus_parser_get_dropped( m_parser );
+	m_chunkLength = 0;
+	m_chunkOverflow = false;
+	m_chunkFrames = 0;
+}
+
+
+// static
+void BusSniffer::parserCallback( modbus_parser_t * parser,
+					const uint8_t * adu, int length,
+					void * userData )
+{
+	Q_UNUSED( parser );
+	BusSniffer * sniffer = static_cast<BusSniffer *>( userData );
+	sniffer->m_chunkFrames++;
+	sniffer->addFrame( adu, length, true );
+}
+
+
+void BusSniffer::addFrame( const quint8 * adu, int length, bool crcValid )
+{
+	BusSnifferRecord r;
+
+	memset( &r, 0, sizeof( r ) );
+	r.timestamp = m_chunkEnd;
+	r.crcValid = crcValid;
+	r.length = qMin( length, (int) sizeof( r.data ) );
+	memcpy( r.data, adu, r.length );
+	r.slave = length > 0 ? adu[0] : 0;
+	r.func = length > 1 ? adu[1] : 0;
+	if( length >= 3 )
+	{
+		r.expectedCRC = modbus_rtu_crc16( (uint8_t *) adu, length - 2 );
+		r.actualCRC = ( adu[length-2] << 8 ) | adu[length-1];
+	}
+
+	// a valid frame of the polled slave with the polled function (or its
+	// exception) answers the pending request, anything else is a request
+	r.isRequest = !( m_pending && crcValid && r.slave == m_pendingSlave &&
+				( r.func & 0x7f ) == m_pendingFunc );
+
+	if( r.isRequest )
+	{
+		if( length >= 6 )
+		{
+			r.addr = ( adu[2] << 8 ) | adu[3];
+			r.nb = ( adu[4] << 8 ) | adu[5];
+		}
+		if( r.func == MODBUS_FC_WRITE_SINGLE_COIL ||
+			r.func == MODBUS_FC_WRITE_SINGLE_REGISTER )
+		{
+			r.nb = 1;
+		}
+		// no response follows a broadcast
+		m_pending = crcValid && r.slave != MODBUS_BROADCAST_ADDRESS;
+		m_pendingSlave = r.slave;
+		m_pendingFunc = r.func;
+		m_pendingAddr = r.addr;
+		m_pendingEnd = m_chunkEnd;
+	}
+	else
+	{
+		r.turnaround = m_chunkEnd - m_pendingEnd;
+		r.addr = m_pendingAddr;
+		switch( r.func )
+		{
+			case MODBUS_FC_READ_COILS:
+			case MODBUS_FC_READ_DISCRETE_INPUTS:
+				r.nb = adu[2] * 8;
+				break;
+			case MODBUS_FC_READ_HOLDING_REGISTERS:
+			case MODBUS_FC_READ_INPUT_REGISTERS:
+				r.nb = adu[2] / 2;
+				break;
+			case MODBUS_FC_WRITE_SINGLE_COIL:
+			case MODBUS_FC_WRITE_SINGLE_REGISTER:
+				r.nb = 1;
+				break;
+			case MODBUS_FC_WRITE_MULTIPLE_COILS:
+			case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+				r.nb = ( adu[4] << 8 ) | adu[5];
+				break;
+			default:
+				break;
+		}
+		m_pending = false;
+	}
+
+	if( !m_records.push( r ) )
+	{
+		m_dropped.fetchAndAddRelaxed( 1 );
+	}
+}
@@ -0,0 +1,130 @@
+/*
+ * BusSniffer.h - header file for BusSniffer class
+ *
+ * Copyright (c) 2009-2014 Tobias Doerffel / Electronic Design Chemnitz
+ *
+ * This file is part of QModBus - http://qmodbus.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef BUS_SNIFFER_H
+#define BUS_SNIFFER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QAtomicInt>
+
+#include "modbus.h"
+#include "modbus-parser.h"
+#include "SpscQueue.h"
+
+
+// one frame seen on the line
+struct BusSnifferRecord
+{
+	// monotonic time of the end of the frame in microseconds
+	quint64 timestamp;
+	bool isRequest;
+	bool crcValid;
+	// time from the end of the request to the end of this response in
+	// microseconds, 0 for a request or a response without request
+	quint32 turnaround;
+	quint8 slave;
+	quint8 func;
+	quint16 addr;
+	quint16 nb;
+	quint16 expectedCRC;
+	quint16 actualCRC;
+	int length;
+	quint8 data[MODBUS_RTU_MAX_ADU_LENGTH];
+} ;
+
+
+// Reads a RTU line on its own thread, splits the frames on the inter-frame
+// silence and on their CRC, pairs the requests with their responses and
+// queues the records for the GUI thread.
+class BusSniffer : public QThread
+{
+public:
+	BusSniffer( modbus_t * modbus, QObject * parent = 0 );
+	~BusSniffer();
+
+	// asks the thread to end, wait() for it afterwards
+	void stop();
+
+	// give the line to the caller until resume(), for example to send
+	// a request with the same context
+	void suspend();
+	void resume();
+
+	// called from the GUI thread, returns false once the queue is empty
+	bool takeRecord( BusSnifferRecord & record );
+
+	// records lost because the GUI thread didn't take them in time
+	int droppedRecords();
+
+	// bytes of the line that were not part of a valid frame
+	int droppedBytes();
+
+protected:
+	virtual void run();
+
+private:
+	void endOfChunk();
+	void resetParser();
+	void addFrame( const quint8 * adu, int length, bool crcValid );
+
+	static void parserCallback( modbus_parser_t * parser,
+					const uint8_t * adu, int length,
+					void * userData );
+
+	modbus_t * m_modbus;
+	modbus_parser_t * m_parser;
+
+	QMutex m_lineMutex;
+	// frame gap of the context outside of the sniffer
+	int m_ownerFrameGap;
+	QAtomicInt m_stop;
+	QAtomicInt m_suspended;
+	QAtomicInt m_dropped;
+	QAtomicInt m_droppedBytes;
+	// bytes dropped by the parser already added to m_droppedBytes
+	quint64 m_parserDropped;
+
+	// bytes received since the last silence, usually one frame, kept to
+	// show them when no valid frame is found in them. The parser is fed
+	// with every read, the frames don't depend on the size of this copy.
+	quint8 m_chunk[4 * MODBUS_RTU_MAX_ADU_LENGTH];
+	int m_chunkLength;
+	bool m_chunkOverflow;
+	int m_chunkFrames;
+	quint64 m_chunkEnd;
+
+	// last request still waiting for its response
+	bool m_pending;
+	quint8 m_pendingSlave;
+	quint8 m_pendingFunc;
+	quint16 m_pendingAddr;
+	quint64 m_pendingEnd;
+
+	// about 4 s of a loaded 115200 bauds line
+	SpscQueue<BusSnifferRecord, 4096> m_records;
+
+} ;
+
+#endif // BUS_SNIFFER_H
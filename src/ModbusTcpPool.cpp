@@ -0,0 +1,341 @@
+/*
+ * ModbusTcpPool.cpp - implementation of ModbusTcpPool class
+ *
+ * Copyright (c) 2009-2014 Tobias Doerffel / Electronic Design Chemnitz
+ *
+ * This file is part of QModBus - http://qmodbus.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QWaitCondition>
+
+#ifdef Q_OS_WIN
+#include <winsock2.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <poll.h>
+#endif
+
+#include "ModbusTcpPool.h"
+
+
+// period of the check of the idle sockets, also the delay between two
+// attempts to reconnect an endpoint
+const int HealthCheckMsec = 2000;
+
+
+// Connects the contexts on its own thread so an unreachable gateway doesn't
+// freeze the GUI for the connect timeout
+class ModbusTcpPoolConnector : public QThread
+{
+public:
+	struct Job
+	{
+		QString host;
+		int port;
+		// connected context once done, NULL if the connection failed
+		modbus_t * modbus;
+	} ;
+
+	ModbusTcpPoolConnector( QObject * pool ) :
+		QThread(),
+		m_pool( pool ),
+		m_stop( false )
+	{
+	}
+
+	~ModbusTcpPoolConnector()
+	{
+		stop();
+		wait();
+
+		Job job;
+		while( take( job ) )
+		{
+			modbus_close( job.modbus );
+			modbus_free( job.modbus );
+		}
+	}
+
+	void stop()
+	{
+		QMutexLocker lock( &m_mutex );
+		m_stop = true;
+		m_wakeUp.wakeOne();
+	}
+
+	void request( const QString & host, int port )
+	{
+		Job job;
+		job.host = host;
+		job.port = port;
+		job.modbus = NULL;
+
+		QMutexLocker lock( &m_mutex );
+		m_pending << job;
+		m_wakeUp.wakeOne();
+	}
+
+	// returns false once no connection is left to take
+	bool take( Job & job )
+	{
+		QMutexLocker lock( &m_mutex );
+		if( m_done.isEmpty() )
+		{
+			return false;
+		}
+		job = m_done.takeFirst();
+		return true;
+	}
+
+protected:
+	virtual void run()
+	{
+		QMutexLocker lock( &m_mutex );
+
+		while( !m_stop )
+		{
+			if( m_pending.isEmpty() )
+			{
+				m_wakeUp.wait( &m_mutex );
+				continue;
+			}
+
+			Job job = m_pending.takeFirst();
+			lock.unlock();
+
+			job.modbus = modbus_new_tcp(
+					job.host.toLatin1().constData(), job.port );
+			if( job.modbus != NULL && modbus_connect( job.modbus ) == -1 )
+			{
+				modbus_free( job.modbus );
+				job.modbus = NULL;
+			}
+
+			lock.relock();
+			m_done << job;
+			QMetaObject::invokeMethod( m_pool, "takeConnections",
+							Qt::QueuedConnection );
+		}
+	}
+
+private:
+	QObject * m_pool;
+	QMutex m_mutex;
+	QWaitCondition m_wakeUp;
+	QList<Job> m_pending;
+	QList<Job> m_done;
+	bool m_stop;
+
+} ;
+
+
+ModbusTcpPool::ModbusTcpPool( QObject * parent ) :
+	QObject( parent ),
+	m_endpoints(),
+	m_healthTimer(),
+	m_connector( new ModbusTcpPoolConnector( this ) )
+{
+	connect( &m_healthTimer, SIGNAL( timeout() ),
+					this, SLOT( checkHealth() ) );
+	m_healthTimer.start( HealthCheckMsec );
+	m_connector->start();
+}
+
+
+ModbusTcpPool::~ModbusTcpPool()
+{
+	delete m_connector;
+
+	foreach( const Endpoint & endpoint, m_endpoints )
+	{
+		modbus_close( endpoint.modbus );
+		modbus_free( endpoint.modbus );
+	}
+}
+
+
+modbus_t * ModbusTcpPool::acquire( const QString & host, int port,
+								int unitId )
+{
+	QHash<QString, Endpoint>::iterator it =
+					m_endpoints.find( key( host, port ) );
+
+	if( it == m_endpoints.end() )
+	{
+		Endpoint endpoint;
+		endpoint.host = host;
+		endpoint.port = port;
+		endpoint.modbus = modbus_new_tcp( host.toLatin1().constData(),
+									port );
+		endpoint.reconnecting = false;
+		endpoint.handedOut = false;
+		if( endpoint.modbus == NULL )
+		{
+			return NULL;
+		}
+		it = m_endpoints.insert( key( host, port ), endpoint );
+
+		// the caller waits for the first connection as it did without
+		// the pool, only the reconnections are done in the background
+		if( modbus_connect( it->modbus ) == -1 )
+		{
+			reconnect( *it );
+			return NULL;
+		}
+	}
+	else if( it->reconnecting )
+	{
+		return NULL;
+	}
+	else if( !isHealthy( it->modbus ) )
+	{
+		reconnect( *it );
+		return NULL;
+	}
+
+	it->handedOut = true;
+	modbus_set_slave( it->modbus, unitId );
+
+	return it->modbus;
+}
+
+
+void ModbusTcpPool::checkHealth()
+{
+	QHash<QString, Endpoint>::iterator it;
+
+	for( it = m_endpoints.begin(); it != m_endpoints.end(); ++it )
+	{
+		if( !it->reconnecting && !isHealthy( it->modbus ) )
+		{
+			reconnect( *it );
+		}
+	}
+}
+
+
+void ModbusTcpPool::takeConnections()
+{
+	ModbusTcpPoolConnector::Job job;
+
+	while( m_connector->take( job ) )
+	{
+		QHash<QString, Endpoint>::iterator it =
+				m_endpoints.find( key( job.host, job.port ) );
+		if( it == m_endpoints.end() )
+		{
+			modbus_close( job.modbus );
+			modbus_free( job.modbus );
+			continue;
+		}
+
+		it->reconnecting = false;
+		if( job.modbus == NULL )
+		{
+			// nobody holds the context of an endpoint which never
+			// answered, don't retry a mistyped address forever
+			if( !it->handedOut )
+			{
+				modbus_free( it->modbus );
+				m_endpoints.erase( it );
+			}
+			// else retried by the next health check
+			continue;
+		}
+
+		// the context handed out keeps its settings and gets the socket
+		modbus_close( it->modbus );
+		modbus_set_socket( it->modbus, modbus_get_socket( job.modbus ) );
+		modbus_free( job.modbus );
+
+		emit endpointConnected( job.host, job.port );
+	}
+}
+
+
+// static
+QString ModbusTcpPool::key( const QString & host, int port )
+{
+	return host + ':' + QString::number( port );
+}
+
+
+// static
+// a socket closed by the peer is readable and reads nothing, without
+// blocking nor consuming the bytes of a late response
+bool ModbusTcpPool::isHealthy( modbus_t * modbus )
+{
+	const int s = modbus_get_socket( modbus );
+	struct pollfd pfd;
+	char c;
+
+	if( s == -1 )
+	{
+		return false;
+	}
+
+	pfd.fd = s;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	// not limited to the descriptors below FD_SETSIZE as select() is
+#ifdef Q_OS_WIN
+	const int rc = WSAPoll( &pfd, 1, 0 );
+#else
+	const int rc = poll( &pfd, 1, 0 );
+#endif
+	if( rc == 0 )
+	{
+		return true;
+	}
+	if( rc < 0 || ( pfd.revents & ( POLLERR | POLLNVAL ) ) )
+	{
+		return false;
+	}
+
+	if( recv( s, &c, 1, MSG_PEEK ) <= 0 )
+	{
+		return false;
+	}
+
+	// a response arrived after its timeout, it would be taken for the
+	// response to the next request
+	modbus_flush( modbus );
+
+	return true;
+}
+
+
+void ModbusTcpPool::reconnect( Endpoint & endpoint )
+{
+	if( modbus_get_socket( endpoint.modbus ) != -1 )
+	{
+		// requests fail at once until the socket is back
+		modbus_close( endpoint.modbus );
+		emit endpointLost( endpoint.host, endpoint.port );
+	}
+
+	endpoint.reconnecting = true;
+	m_connector->request( endpoint.host, endpoint.port );
+}
@@ -0,0 +1,89 @@
+/*
+ * ModbusTcpPool.h - header file for ModbusTcpPool class
+ *
+ * Copyright (c) 2009-2014 Tobias Doerffel / Electronic Design Chemnitz
+ *
+ * This file is part of QModBus - http://qmodbus.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef MODBUS_TCP_POOL_H
+#define MODBUS_TCP_POOL_H
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+#include <QTimer>
+
+#include "modbus.h"
+
+
+class ModbusTcpPoolConnector;
+
+
+// Keeps one connected context per gateway (host:port), so switching between
+// the unit IDs behind a gateway, or back to a gateway used before, doesn't
+// cost a TCP handshake. The idle sockets are checked periodically and the
+// lost ones are reconnected on a thread of their own. A context handed out
+// stays valid until the pool is destroyed: a reconnection gives it the new
+// socket.
+class ModbusTcpPool : public QObject
+{
+	Q_OBJECT
+public:
+	ModbusTcpPool( QObject * parent = 0 );
+	~ModbusTcpPool();
+
+	// returns the context of the endpoint with the unit ID set, connected
+	// first if the endpoint is new. Returns NULL if the endpoint can't be
+	// reached, it is then reconnected in the background and
+	// endpointConnected() is emitted once it is back.
+	modbus_t * acquire( const QString & host, int port,
+					int unitId = MODBUS_TCP_SLAVE );
+
+signals:
+	void endpointConnected( const QString & host, int port );
+	void endpointLost( const QString & host, int port );
+
+private slots:
+	void checkHealth();
+	void takeConnections();
+
+private:
+	struct Endpoint
+	{
+		QString host;
+		int port;
+		modbus_t * modbus;
+		// a reconnection is running on the connector thread
+		bool reconnecting;
+		// the context has been returned by acquire() once
+		bool handedOut;
+	} ;
+
+	static QString key( const QString & host, int port );
+	static bool isHealthy( modbus_t * modbus );
+	void reconnect( Endpoint & endpoint );
+
+	QHash<QString, Endpoint> m_endpoints;
+	QTimer m_healthTimer;
+	ModbusTcpPoolConnector * m_connector;
+
+} ;
+
+#endif // MODBUS_TCP_POOL_H
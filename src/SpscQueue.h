@@ -0,0 +1,82 @@
+/*
+ * SpscQueue.h - lock-free queue between one producer and one consumer thread
+ *
+ * Copyright (c) 2009-2014 Tobias Doerffel / Electronic Design Chemnitz
+ *
+ * This file is part of QModBus - http://qmodbus.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <QAtomicInt>
+
+
+// Ring of Size slots, one of them always left free to tell a full ring from
+// an empty one. Only push() may be called from the producer thread and only
+// pop() from the consumer thread.
+template<typename T, int Size>
+class SpscQueue
+{
+public:
+	SpscQueue() :
+		m_head( 0 ),
+		m_tail( 0 )
+	{
+	}
+
+	// returns false if the queue is full
+	bool push( const T & item )
+	{
+		const int tail = m_tail.fetchAndAddRelaxed( 0 );
+		const int next = ( tail + 1 ) % Size;
+
+		if( next == m_head.fetchAndAddAcquire( 0 ) )
+		{
+			return false;
+		}
+		m_items[tail] = item;
+		m_tail.fetchAndStoreRelease( next );
+		return true;
+	}
+
+	// returns false if the queue is empty
+	bool pop( T & item )
+	{
+		const int head = m_head.fetchAndAddRelaxed( 0 );
+
+		if( head == m_tail.fetchAndAddAcquire( 0 ) )
+		{
+			return false;
+		}
+		item = m_items[head];
+		m_head.fetchAndStoreRelease( ( head + 1 ) % Size );
+		return true;
+	}
+
+private:
+	// next slot to read, written by the consumer only
+	QAtomicInt m_head;
+	// next slot to write, written by the producer only
+	QAtomicInt m_tail;
+	T m_items[Size];
+
+} ;
+
+#endif // SPSC_QUEUE_H
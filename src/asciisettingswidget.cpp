@@ -0,0 +1,34 @@
+#include "serialsettingswidget.h"
+#include "asciisettingswidget.h"
+#include "ui_serialsettingswidget.h"
+#include "modbus.h"
+
+#include <QMessageBox>
+
+
+AsciiSettingsWidget::AsciiSettingsWidget(QWidget *parent) :
+    SerialSettingsWidget(parent)
+{
+}
+
+AsciiSettingsWidget::~AsciiSettingsWidget()
+{
+}
+
+void AsciiSettingsWidget::changeModbusInterface(const QString& port, char parity)
+{
+    releaseSerialModbus();
+
+    m_serialModbus = modbus_new_ascii( port.toLatin1().constData(),
+            ui->baud->currentText().toInt(),
+            parity,
+            ui->dataBits->currentText().toInt(),
+            ui->stopBits->currentText().toInt() );
+
+    if( modbus_connect( m_serialModbus ) == -1 )
+    {
+        QMessageBox::critical( this, tr( "Connection failed" ),
+            tr( "Could not connect serial port!" ) );
+	releaseSerialModbus();
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef ASCIISETTINGSWIDGET_H
+#define ASCIISETTINGSWIDGET_H
+
+#include <QWidget>
+#include "imodbus.h"
+#include "modbus.h"
+#include "serialsettingswidget.h"
+
+class AsciiSettingsWidget : public SerialSettingsWidget
+{
+//	Q_OBJECT
+
+public:
+	AsciiSettingsWidget(QWidget *parent = 0);
+	virtual ~AsciiSettingsWidget();
+
+protected:
+	virtual void changeModbusInterface(const QString &port, char parity);
+};
+
+#endif // ASCIISETTINGSWIDGET_H
@@ -32,6 +32,7 @@
 
 #include "mainwindow.h"
 #include "BatchProcessor.h"
+#include "BusSniffer.h"
 #include "modbus.h"
 #include "modbus-private.h"
 
@@ -48,11 +49,15 @@ extern MainWindow * globalMainWin;
 MainWindow::MainWindow( QWidget * _parent ) :
 	QMainWindow( _parent ),
 	ui( new Ui::MainWindowClass ),
-	m_modbus( NULL )
+	m_modbus( NULL ),
+	m_busSniffer( NULL ),
+	m_droppedRecords( 0 ),
+	m_droppedBytes( 0 )
 {
 	ui->setupUi(this);
 
 	connect( ui->rtuSettingsWidget, SIGNAL(serialPortActive(bool)), this , SLOT(onRtuPortActive(bool)));
+	connect( ui->asciiSettingsWidget, SIGNAL(serialPortActive(bool)), this , SLOT(onAsciiPortActive(bool)));
 	connect( ui->tcpSettingsWidget,   SIGNAL(tcpPortActive(bool)), this, SLOT(onTcpPortActive(bool)));
 	connect( ui->slaveID, SIGNAL( valueChanged( int ) ),
 			this, SLOT( updateRequestPreview() ) );
@@ -108,6 +113,7 @@ MainWindow::MainWindow( QWidget * _parent ) :
 
 MainWindow::~MainWindow()
 {
+	stopBusSniffer();
 	delete ui;
 }
 
@@ -367,6 +373,12 @@ void MainWindow::sendModbusRequest( void )
 		return;
 	}
 
+	// the sniffer would take the response
+	if( m_busSniffer )
+	{
+		m_busSniffer->suspend();
+	}
+
 	const int slave = ui->slaveID->value();
 	const int func = stringToHex( embracedString(
 					ui->functionCode->currentText() ) );
@@ -452,6 +464,11 @@ void MainWindow::sendModbusRequest( void )
 			break;
 	}
 
+	if( m_busSniffer )
+	{
+		m_busSniffer->resume();
+	}
+
 	if( ret == num  )
 	{
 		if( writeAccess )
@@ -535,16 +552,75 @@ void MainWindow::resetStatus( void )
 
 void MainWindow::pollForDataOnBus( void )
 {
-	if( m_modbus )
+	if( m_busSniffer )
+	{
+		BusSnifferRecord r;
+		while( m_busSniffer->takeRecord( r ) )
+		{
+			busMonitorAddItem( r.isRequest, r.slave, r.func, r.addr,
+						r.nb, r.expectedCRC, r.actualCRC );
+			if( !r.isRequest && r.turnaround > 0 )
+			{
+				const int row = ui->busMonTable->rowCount()-1;
+				ui->busMonTable->item( row, 0 )->setToolTip(
+					tr( "Response after %1 ms" ).
+						arg( r.turnaround / 1000.0, 0, 'f', 1 ) );
+			}
+			busMonitorRawData( r.data, r.length, true, 1 );
+		}
+
+		const int dropped = m_busSniffer->droppedRecords();
+		if( dropped != m_droppedRecords )
+		{
+			m_droppedRecords = dropped;
+			m_statusText->setText(
+				tr( "Bus monitor too slow, %1 frames lost" ).
+								arg( dropped ) );
+			m_statusInd->setStyleSheet( "background: #c00;" );
+		}
+
+		const int droppedBytes = m_busSniffer->droppedBytes();
+		if( droppedBytes != m_droppedBytes )
+		{
+			m_droppedBytes = droppedBytes;
+			m_statusText->setText(
+				tr( "%1 bytes outside of valid frames" ).
+							arg( droppedBytes ) );
+			m_statusInd->setStyleSheet( "background: #c00;" );
+		}
+	}
+	else if( m_modbus )
 	{
 		modbus_poll( m_modbus );
 	}
 }
 
 
+void MainWindow::stopBusSniffer( void )
+{
+	if( m_busSniffer )
+	{
+		m_busSniffer->stop();
+		m_busSniffer->wait();
+		delete m_busSniffer;
+		m_busSniffer = NULL;
+		m_droppedRecords = 0;
+		m_droppedBytes = 0;
+	}
+}
+
+
 void MainWindow::openBatchProcessor()
 {
+	if( m_busSniffer )
+	{
+		m_busSniffer->suspend();
+	}
 	BatchProcessor( this, m_modbus ).exec();
+	if( m_busSniffer )
+	{
+		m_busSniffer->resume();
+	}
 }
 
 
@@ -555,8 +631,28 @@ void MainWindow::aboutQModBus( void )
 
 void MainWindow::onRtuPortActive(bool active)
 {
+	stopBusSniffer();
 	if (active) {
 		m_modbus = ui->rtuSettingsWidget->modbus();
+		if (m_modbus) {
+			modbus_register_monitor_add_item_fnc(m_modbus, MainWindow::stBusMonitorAddItem);
+			modbus_register_monitor_raw_data_fnc(m_modbus, MainWindow::stBusMonitorRawData);
+			m_busSniffer = new BusSniffer( m_modbus );
+			m_busSniffer->start( QThread::TimeCriticalPriority );
+		}
+	}
+	else {
+		m_modbus = NULL;
+	}
+}
+
+void MainWindow::onAsciiPortActive(bool active)
+{
+	// the sniffer splits RTU frames only, the bus monitor is fed by
+	// modbus_poll() as for TCP
+	stopBusSniffer();
+	if (active) {
+		m_modbus = ui->asciiSettingsWidget->modbus();
 		if (m_modbus) {
 			modbus_register_monitor_add_item_fnc(m_modbus, MainWindow::stBusMonitorAddItem);
 			modbus_register_monitor_raw_data_fnc(m_modbus, MainWindow::stBusMonitorRawData);
@@ -569,6 +665,7 @@ void MainWindow::onRtuPortActive(bool active)
 
 void MainWindow::onTcpPortActive(bool active)
 {
+	stopBusSniffer();
 	if (active) {
 		m_modbus = ui->tcpSettingsWidget->modbus();
 		if (m_modbus) {
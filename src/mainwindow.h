@@ -30,6 +30,8 @@
 #include "modbus.h"
 #include "ui_about.h"
 
+class BusSniffer;
+
 
 class AboutDialog : public QDialog, public Ui::AboutDialog
 {
@@ -86,13 +88,19 @@ private slots:
     void openBatchProcessor();
     void aboutQModBus( void );
     void onRtuPortActive(bool active);
+    void onAsciiPortActive(bool active);
     void onTcpPortActive(bool active);
 
 private:
+    void stopBusSniffer( void );
+
     Ui::MainWindowClass * ui;
     modbus_t * m_modbus;
     QWidget * m_statusInd;
     QLabel * m_statusText;
+    BusSniffer * m_busSniffer;
+    int m_droppedRecords;
+    int m_droppedBytes;
 
 };
 
@@ -11,6 +11,14 @@ SerialSettingsWidget::SerialSettingsWidget(QWidget *parent) :
 {
 	ui->setupUi(this);
 	enableGuiItems(false);
+
+	// the ports plugged in or out later update the combo box, the list
+	// of the enumerator is kept up to date instead of scanned again
+	m_portEnumerator.setUpNotifications();
+	connect( &m_portEnumerator, SIGNAL( deviceDiscovered( const QextPortInfo & ) ),
+			this, SLOT( addSerialPort( const QextPortInfo & ) ) );
+	connect( &m_portEnumerator, SIGNAL( deviceRemoved( const QextPortInfo & ) ),
+			this, SLOT( removeSerialPort( const QextPortInfo & ) ) );
 }
 
 SerialSettingsWidget::~SerialSettingsWidget()
@@ -18,6 +26,16 @@ SerialSettingsWidget::~SerialSettingsWidget()
 	delete ui;
 }
 
+static inline QString portLabel( const QextPortInfo & port )
+{
+#ifdef Q_OS_WIN
+	return port.friendName;
+#else
+	return port.physName;
+#endif
+}
+
+
 int SerialSettingsWidget::setupModbusPort()
 {
 	QSettings s;
@@ -26,13 +44,10 @@ int SerialSettingsWidget::setupModbusPort()
 	int i = 0;
     ui->serialPort->disconnect();
     ui->serialPort->clear();
-	foreach( QextPortInfo port, QextSerialEnumerator::getPorts() )
+	m_ports = QextSerialEnumerator::getPorts();
+	foreach( QextPortInfo port, m_ports )
 	{
-#ifdef Q_OS_WIN
-        ui->serialPort->addItem( port.friendName );
-#else
-        ui->serialPort->addItem( port.physName );
-#endif
+        ui->serialPort->addItem( portLabel( port ) );
 		if( port.friendName == s.value( "serialinterface" ) )
 		{
 			portIndex = i;
@@ -81,17 +96,16 @@ void SerialSettingsWidget::changeSerialPort( int )
 {
 	const int iface = ui->serialPort->currentIndex();
 
-	QList<QextPortInfo> ports = QextSerialEnumerator::getPorts();
-	if( !ports.isEmpty() )
+	if( iface >= 0 && iface < m_ports.size() )
 	{
 		QSettings settings;
-		settings.setValue( "serialinterface", ports[iface].friendName );
+		settings.setValue( "serialinterface", m_ports[iface].friendName );
 		settings.setValue( "serialbaudrate", ui->baud->currentText() );
 		settings.setValue( "serialparity", ui->parity->currentText() );
 		settings.setValue( "serialdatabits", ui->dataBits->currentText() );
 		settings.setValue( "serialstopbits", ui->stopBits->currentText() );
 #ifdef Q_OS_WIN32
-		QString port = ports[iface].portName;
+		QString port = m_ports[iface].portName;
 
 		// is it a serial port in the range COM1 .. COM9?
 		if ( port.startsWith( "COM" ) )
@@ -100,7 +114,7 @@ void SerialSettingsWidget::changeSerialPort( int )
 			port = "\\\\.\\" + port;
 		}
 #else
-		const QString port = ports[iface].physName;
+		const QString port = m_ports[iface].physName;
 #endif
 
 		char parity;
@@ -112,7 +126,15 @@ void SerialSettingsWidget::changeSerialPort( int )
 			case 0: parity = 'N'; break;
 		}
 
+		if( m_serialModbus )
+		{
+			emit serialPortActive( false );
+		}
 		changeModbusInterface(port, parity);
+		if( m_serialModbus )
+		{
+			emit serialPortActive( true );
+		}
 	}
 	else
 	{
@@ -138,8 +160,78 @@ void SerialSettingsWidget::on_checkBox_clicked(bool checked)
 		setupModbusPort();
 	}
 	else {
+		// let the users of the context go before it is freed
+		emit serialPortActive(false);
 		releaseSerialModbus();
 	}
 	enableGuiItems(checked);
-	emit serialPortActive(checked);
+	if (checked) {
+		emit serialPortActive(true);
+	}
+}
+
+
+void SerialSettingsWidget::addSerialPort( const QextPortInfo & info )
+{
+	for( int i = 0; i < m_ports.size(); ++i )
+	{
+		if( m_ports[i].physName == info.physName )
+		{
+			return;
+		}
+	}
+
+	// a port plugged in while none could be opened is opened at once,
+	// otherwise the current port is kept
+	const bool openIt = ui->checkBox->isChecked() && m_ports.isEmpty();
+	const bool blocked = ui->serialPort->blockSignals( !openIt );
+	m_ports.append( info );
+	ui->serialPort->addItem( portLabel( info ) );
+	ui->serialPort->blockSignals( blocked );
+}
+
+
+void SerialSettingsWidget::removeSerialPort( const QextPortInfo & info )
+{
+	int index = -1;
+	for( int i = 0; i < m_ports.size(); ++i )
+	{
+		if( m_ports[i].physName == info.physName )
+		{
+			index = i;
+			break;
+		}
+	}
+	if( index == -1 )
+	{
+		return;
+	}
+
+	const bool current = index == ui->serialPort->currentIndex();
+	if( current && m_serialModbus )
+	{
+		// let the users of the context go before it is freed
+		emit serialPortActive( false );
+		releaseSerialModbus();
+	}
+
+	const bool blocked = ui->serialPort->blockSignals( true );
+	m_ports.removeAt( index );
+	ui->serialPort->removeItem( index );
+	ui->serialPort->blockSignals( blocked );
+
+	if( current && ui->checkBox->isChecked() )
+	{
+		if( m_ports.isEmpty() )
+		{
+			QMessageBox::warning( this, tr( "Serial port removed" ),
+				tr( "The serial port %1 has been removed!" ).
+							arg( portLabel( info ) ) );
+		}
+		else
+		{
+			// the combo box shows the next port, use it
+			changeSerialPort( ui->serialPort->currentIndex() );
+		}
+	}
 }
@@ -4,6 +4,7 @@
 #include <QWidget>
 #include "imodbus.h"
 #include "modbus.h"
+#include "qextserialenumerator.h"
 
 namespace Ui {
 class SerialSettingsWidget;
@@ -29,6 +30,9 @@ protected:
 
     Ui::SerialSettingsWidget *ui;
     modbus_t *                m_serialModbus;
+    // ports of the combo box, in the same order
+    QList<QextPortInfo>       m_ports;
+    QextSerialEnumerator      m_portEnumerator;
 
 signals:
 	void serialPortActive(bool active);
@@ -38,6 +42,8 @@ public slots:
 
 private slots:
 	void on_checkBox_clicked(bool checked);
+	void addSerialPort(const QextPortInfo & info);
+	void removeSerialPort(const QextPortInfo & info);
 
 private:
 
@@ -1,6 +1,7 @@
 #include "tcpipsettingswidget.h"
 #include "ui_tcpipsettingswidget.h"
 #include "modbus-tcp.h"
+#include "ModbusTcpPool.h"
 #include <QIntValidator>
 #include <QMessageBox>
 #include <QDebug>
@@ -9,8 +10,10 @@ TcpIpSettingsWidget::TcpIpSettingsWidget(QWidget *parent) :
     QWidget(parent),
     ui(new Ui::TcpIpSettingsWidget)
 ,   m_tcpModbus(0)
+,   m_tcpPool(new ModbusTcpPool(this))
 {
     ui->setupUi(this);
+    connect(m_tcpPool, SIGNAL(endpointConnected(QString,int)), this, SLOT(onEndpointConnected(QString,int)));
     connect(ui->edNetworkAddress, SIGNAL(textChanged(QString)), this, SLOT(onEdNetworkAddressTextChanged(QString)));
     ui->edPort->setValidator(new QIntValidator(this));
     enableGuiItems(false);
@@ -30,24 +33,19 @@ void TcpIpSettingsWidget::changeModbusInterface(const QString &address, int port
 {
     releaseTcpModbus();
 
-    m_tcpModbus = modbus_new_tcp( address.toLatin1().constData(), portNbr );
-    if( modbus_connect( m_tcpModbus ) == -1 )
+    m_tcpModbus = m_tcpPool->acquire( address, portNbr );
+    if( m_tcpModbus == NULL )
     {
         QMessageBox::critical( this, tr( "Connection failed" ),
             tr( "Could not connect tcp/ip port!" ) );
         ui->btnApply->setEnabled(true);
-    	releaseTcpModbus();
     }
 }
 
 void TcpIpSettingsWidget::releaseTcpModbus()
 {
-    if( m_tcpModbus )
-    {
-        modbus_close( m_tcpModbus );
-        modbus_free( m_tcpModbus );
-        m_tcpModbus = NULL;
-    }
+    // the pool keeps the connection for the next time the endpoint is used
+    m_tcpModbus = NULL;
 }
 
 void TcpIpSettingsWidget::enableGuiItems(bool checked)
@@ -79,3 +77,19 @@ void TcpIpSettingsWidget::on_edPort_textChanged(const QString &)
 {
     ui->btnApply->setEnabled(true);
 }
+
+void TcpIpSettingsWidget::onEndpointConnected(const QString &host, int port)
+{
+    // the endpoint applied last is reachable again after a failed connection
+    if( m_tcpModbus == NULL && ui->cbEnabled->isChecked() &&
+        host == ui->edNetworkAddress->text() &&
+        port == ui->edPort->text().toInt() )
+    {
+        m_tcpModbus = m_tcpPool->acquire( host, port );
+        if( m_tcpModbus )
+        {
+            ui->btnApply->setEnabled(false);
+            emit tcpPortActive(true);
+        }
+    }
+}
@@ -4,6 +4,8 @@
 #include <QWidget>
 #include "imodbus.h"
 
+class ModbusTcpPool;
+
 namespace Ui {
 class TcpIpSettingsWidget;
 }
@@ -29,6 +31,7 @@ private slots:
     void on_btnApply_clicked();
     void onEdNetworkAddressTextChanged(const QString &arg1);
     void on_edPort_textChanged(const QString &arg1);
+    void onEndpointConnected(const QString &host, int port);
 
 signals:
     void tcpPortActive(bool val);
@@ -36,6 +39,8 @@ signals:
 private:
     Ui::TcpIpSettingsWidget *ui;
     modbus_t *               m_tcpModbus;
+    // keeps the connections to the endpoints used before
+    ModbusTcpPool *          m_tcpPool;
 };
 
 #endif // TCPIPSETTINGSWIDGET_H